@@ -19,7 +19,10 @@
 #include <cutils/properties.h>
 #include <log/log.h>
 
+#include <cinttypes>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 
 #include "utils.h"
@@ -34,16 +37,77 @@ HwApiBase::HwApiBase() {
     if (mPathPrefix.empty()) {
         ALOGE("Failed get HWAPI path prefix!");
     }
+
+    auto recordsSize = std::getenv("HWAPI_RECORDS_SIZE");
+    mRecordsSize = recordsSize ? std::strtoul(recordsSize, nullptr, 10) : 0;
+    if (mRecordsSize == 0) {
+        mRecordsSize = RECORDS_SIZE;
+    }
+    mRecords = std::make_unique<RecordSlot[]>(mRecordsSize);
+}
+
+void HwApiBase::saveName(const std::string &name, const void *key) {
+    mNames[key] = name;
+    for (uint8_t access = 0; access < ACCESS_COUNT; access++) {
+        mLatency[key][access] = histogram(std::string(ACCESS_NAMES[access]) + " " + name);
+    }
 }
 
-void HwApiBase::saveName(const std::string &name, const std::ios *stream) {
-    mNames[stream] = name;
+Histogram *HwApiBase::histogram(const std::string &name) {
+    return &mHistograms.try_emplace(name).first->second;
+}
+
+void HwApiBase::open(const std::string &name, Attribute *attr) {
+    auto path = mPathPrefix + name;
+
+    saveName(name, attr);
+    mAttributes.push_back(attr);
+    // without O_CREAT, so a missing attribute is never created
+    attr->mFd.reset(::open(path.c_str(), attr->mFlags | O_CLOEXEC));
+    if (!attr->mFd.ok()) {
+        ALOGE("Failed to open %s (%d): %s", path.c_str(), errno, strerror(errno));
+    }
+}
+
+void HwApiBase::invalidate() {
+    for (auto *attr : mAttributes) {
+        std::scoped_lock shadowLock{attr->mShadowMutex};
+        attr->mShadowLen = 0;
+    }
+}
+
+bool HwApiBase::completeSet(UringBatch::Op &op, int32_t result) {
+    auto *self = static_cast<HwApiBase *>(op.owner);
+    auto *attr = static_cast<Attribute *>(op.context);
+    bool ret = result == static_cast<int32_t>(op.len);
+
+    if (auto *histogram = self->latency(attr, ACCESS_SET)) {
+        histogram->record(Histogram::now() - op.queuedNs);
+    }
+    {
+        std::scoped_lock shadowLock{attr->mShadowMutex};
+        if (ret) {
+            memcpy(attr->mShadow, op.buffer, op.len);
+            attr->mShadowLen = op.len;
+        } else {
+            attr->mShadowLen = 0;
+        }
+    }
+    if (!ret) {
+        int err = result < 0 ? -result : EIO;
+        ALOGE("Failed to write %s (%d): %s", self->mNames[attr].c_str(), err, strerror(err));
+    }
+    return ret;
 }
 
 bool HwApiBase::has(const std::ios &stream) {
     return !!stream;
 }
 
+bool HwApiBase::has(const Attribute &attr) {
+    return attr.mFd.ok();
+}
+
 void HwApiBase::debug(int fd) {
     dprintf(fd, "Kernel:\n");
 
@@ -58,15 +122,79 @@ void HwApiBase::debug(int fd) {
         }
     }
 
-    mRecordsMutex.lock();
     dprintf(fd, "  Records:\n");
-    for (auto &r : mRecords) {
-        if (r == nullptr) {
+    uint64_t end = mRecordsCursor.load(std::memory_order_acquire);
+    uint64_t begin = end > mRecordsSize ? end - mRecordsSize : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        auto &slot = mRecords[index % mRecordsSize];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        Record record = slot.load();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // skip records still being written or already overwritten
+        if (sequence != 2 * (index + 1) ||
+            slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        dprintf(fd, "    %s\n", record.toString(mNames).c_str());
+    }
+
+    dprintf(fd, "  Latency (us):\n");
+    for (auto &[name, histogram] : mHistograms) {
+        uint64_t count = histogram.count();
+        if (count == 0) {
             continue;
         }
-        dprintf(fd, "    %s\n", r->toString(mNames).c_str());
+        dprintf(fd, "    %s: n=%" PRIu64 " p50=%.1f p90=%.1f p99=%.1f max=%.1f\n", name.c_str(),
+                count, histogram.percentile(0.50) / 1000.0, histogram.percentile(0.90) / 1000.0,
+                histogram.percentile(0.99) / 1000.0, histogram.max() / 1000.0);
+    }
+}
+
+void HwApiBase::RecordSlot::store(const Record &record) {
+    static_assert(std::is_trivially_copyable_v<Record>);
+    uint64_t buffer[WORDS] = {};
+
+    std::memcpy(buffer, &record, sizeof(record));
+    for (size_t i = 0; i < WORDS; i++) {
+        words[i].store(buffer[i], std::memory_order_relaxed);
     }
-    mRecordsMutex.unlock();
+}
+
+HwApiBase::Record HwApiBase::RecordSlot::load() const {
+    uint64_t buffer[WORDS];
+    Record record;
+
+    for (size_t i = 0; i < WORDS; i++) {
+        buffer[i] = words[i].load(std::memory_order_relaxed);
+    }
+    std::memcpy(&record, buffer, sizeof(record));
+    return record;
+}
+
+std::string HwApiBase::Record::toString(const NamesMap &names) const {
+    std::stringstream ret;
+    auto name = names.find(key);
+
+    ret << "[" << timestampNs / 1000000000 << "." << std::setfill('0') << std::setw(6)
+        << timestampNs / 1000 % 1000000 << "] " << func << " '"
+        << (name != names.end() ? name->second : "?") << "' = '";
+    switch (kind) {
+        case Kind::SIGNED:
+            ret << value.i;
+            break;
+        case Kind::UNSIGNED:
+            ret << value.u;
+            break;
+        case Kind::FLOAT:
+            ret << value.f;
+            break;
+        case Kind::STRING:
+            ret << std::string_view(value.s, length);
+            break;
+    }
+    ret << "'";
+
+    return ret.str();
 }
 
 HwCalBase::HwCalBase() {
@@ -16,15 +16,25 @@
 #pragma once
 
 #include <android-base/unique_fd.h>
+#include <fcntl.h>
 #include <log/log.h>
-#include <sys/epoll.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
-#include <list>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "Histogram.h"
+#include "PollReactor.h"
+#include "UringBatch.h"
 #include "utils.h"
 
 namespace aidl {
@@ -36,52 +46,143 @@ using ::android::base::unique_fd;
 
 class HwApiBase {
   private:
-    using NamesMap = std::map<const std::ios *, std::string>;
+    using NamesMap = std::map<const void *, std::string>;
+    using WatchesMap = std::map<const void *, int32_t>;
 
-    class RecordInterface {
-      public:
-        virtual std::string toString(const NamesMap &names) = 0;
-        virtual ~RecordInterface() {}
+    // Plain copy of one access, stored without allocating and only formatted
+    // when dumped. Strings longer than STRING_SIZE are truncated.
+    struct Record {
+        static constexpr size_t STRING_SIZE = 32;
+        enum class Kind : uint8_t { SIGNED, UNSIGNED, FLOAT, STRING };
+
+        const char *func;
+        const void *key;
+        int64_t timestampNs;
+        Kind kind;
+        uint8_t length;
+        union {
+            int64_t i;
+            uint64_t u;
+            double f;
+            char s[STRING_SIZE];
+        } value;
+
+        template <typename T>
+        void encode(const T &value);
+        std::string toString(const NamesMap &names) const;
     };
-    template <typename T>
-    class Record : public RecordInterface {
-      public:
-        Record(const char *func, const T &value, const std::ios *stream)
-            : mFunc(func), mValue(value), mStream(stream) {}
-        std::string toString(const NamesMap &names) override;
+    // Ring entry guarded by a sequence lock: 'sequence' is odd while the
+    // record is being written and 2 * (index + 1) once record 'index' is
+    // complete, so readers can detect torn or overwritten entries. The record
+    // is stored as relaxed atomic words so that a reader racing a writer only
+    // ever sees a torn copy, which the sequence check then discards.
+    struct RecordSlot {
+        static constexpr size_t WORDS = (sizeof(Record) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
 
-      private:
-        const char *mFunc;
-        const T mValue;
-        const std::ios *mStream;
+        void store(const Record &record);
+        Record load() const;
+
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> words[WORDS]{};
     };
-    using Records = std::list<std::unique_ptr<RecordInterface>>;
 
     static constexpr uint32_t RECORDS_SIZE = 32;
 
+    enum Access : uint8_t { ACCESS_GET, ACCESS_SET, ACCESS_POLL, ACCESS_COUNT };
+    static constexpr const char *ACCESS_NAMES[ACCESS_COUNT] = {"get", "set", "poll"};
+    using LatencyMap = std::map<const void *, std::array<Histogram *, ACCESS_COUNT>>;
+    // Large enough for any value exchanged with a sysfs attribute.
+    static constexpr size_t ATTRIBUTE_BUFFER_SIZE = 128;
+
   public:
     HwApiBase();
     void debug(int fd);
 
   protected:
-    void saveName(const std::string &name, const std::ios *stream);
+    // Sysfs attribute kept open for the lifetime of the HAL and accessed with
+    // pread()/pwrite() on stack buffers. Unlike the stream interface, there is
+    // no shared buffer or stream state, so accesses need no locking.
+    //
+    // Writes go through a shadow of the last value successfully written, and
+    // writes that would not change it are skipped. This assumes only the HAL
+    // changes the attribute; invalidate() forgets the shadows when that no
+    // longer holds, e.g. after the driver state was reset.
+    //
+    // Once setBatch() was called, get() and set() made while the calling
+    // thread has an open batch are queued and only performed on submit(),
+    // which is also when values read by get() become available.
+    class Attribute {
+      public:
+        explicit Attribute(int flags) : mFlags(flags) {}
+
+      private:
+        friend class HwApiBase;
+        const int mFlags;
+        unique_fd mFd;
+        std::mutex mShadowMutex;
+        char mShadow[ATTRIBUTE_BUFFER_SIZE];
+        size_t mShadowLen{0};  // 0 if unknown
+    };
+
+    void saveName(const std::string &name, const void *key);
     template <typename T>
     void open(const std::string &name, T *stream);
+    void open(const std::string &name, Attribute *attr);
     bool has(const std::ios &stream);
+    bool has(const Attribute &attr);
     template <typename T>
     bool get(T *value, std::istream *stream);
     template <typename T>
+    bool get(T *value, Attribute *attr);
+    template <typename T>
     bool set(const T &value, std::ostream *stream);
     template <typename T>
-    bool poll(const T &value, std::istream *stream, const int32_t timeout = -1);
+    bool set(const T &value, Attribute *attr);
+    // Waits for 'source' to read 'value'. On timeout or once 'cancel' returned
+    // true, see PollReactor::wait(), returns false with errno set to
+    // ETIMEDOUT or ECANCELED respectively.
+    template <typename T, typename U>
+    bool poll(const T &value, U *source, const int32_t timeout = -1,
+              const std::function<bool()> &cancel = nullptr);
+    // Has poll() callers check their 'cancel' again.
+    void wakePolls() { PollReactor::Get().wake(); }
     template <typename T>
-    void record(const char *func, const T &value, const std::ios *stream);
+    void record(const char *func, const T &value, const void *key);
+    void invalidate();
+    void setBatch(UringBatch *batch) { mBatch = batch; }
+    // Returns the latency histogram printed as 'name' by debug(), creating it
+    // if needed. Only to be called while constructing.
+    Histogram *histogram(const std::string &name);
 
   private:
+    Histogram *latency(const void *key, Access access) {
+        auto it = mLatency.find(key);
+        return it != mLatency.end() ? it->second[access] : nullptr;
+    }
+    template <typename T>
+    bool getNow(T *value, std::istream *stream) {
+        return get(value, stream);
+    }
+    template <typename T>
+    bool getNow(T *value, Attribute *attr);
+    template <typename T>
+    static bool completeGet(UringBatch::Op &op, int32_t result);
+    static bool completeSet(UringBatch::Op &op, int32_t result);
+
     std::string mPathPrefix;
     NamesMap mNames;
-    Records mRecords{RECORDS_SIZE};
-    std::mutex mRecordsMutex;
+    // PollReactor watch ids, registered on the first poll() of each source.
+    WatchesMap mWatches;
+    std::vector<Attribute *> mAttributes;
+    UringBatch *mBatch{nullptr};
+    // Fixed ring of the last mRecordsSize accesses, sized by
+    // HWAPI_RECORDS_SIZE (default RECORDS_SIZE).
+    uint32_t mRecordsSize;
+    std::unique_ptr<RecordSlot[]> mRecords;
+    std::atomic<uint64_t> mRecordsCursor{0};
+    // Populated while constructing, so lookups need no locking.
+    std::map<std::string, Histogram> mHistograms;
+    LatencyMap mLatency;
     std::mutex mIoMutex;
 };
 
@@ -96,6 +197,7 @@ void HwApiBase::open(const std::string &name, T *stream) {
 template <typename T>
 bool HwApiBase::get(T *value, std::istream *stream) {
     ATRACE_NAME("HwApi::get");
+    Histogram::Timer timer{latency(stream, ACCESS_GET)};
     std::scoped_lock ioLock{mIoMutex};
     bool ret;
     stream->seekg(0);
@@ -111,6 +213,7 @@ bool HwApiBase::get(T *value, std::istream *stream) {
 template <typename T>
 bool HwApiBase::set(const T &value, std::ostream *stream) {
     ATRACE_NAME("HwApi::set");
+    Histogram::Timer timer{latency(stream, ACCESS_SET)};
     using utils::operator<<;
     std::scoped_lock ioLock{mIoMutex};
     bool ret;
@@ -124,32 +227,137 @@ bool HwApiBase::set(const T &value, std::ostream *stream) {
 }
 
 template <typename T>
-bool HwApiBase::poll(const T &value, std::istream *stream, const int32_t timeoutMs) {
+bool HwApiBase::get(T *value, Attribute *attr) {
+    auto *op = mBatch ? mBatch->queue() : nullptr;
+
+    if (op == nullptr) {
+        return getNow(value, attr);
+    }
+    op->fd = attr->mFd;
+    op->write = false;
+    op->offset = 0;
+    op->len = sizeof(op->buffer);
+    op->done = &HwApiBase::completeGet<T>;
+    op->owner = this;
+    op->context = attr;
+    op->output = value;
+    return true;
+}
+
+template <typename T>
+bool HwApiBase::getNow(T *value, Attribute *attr) {
+    ATRACE_NAME("HwApi::get");
+    Histogram::Timer timer{latency(attr, ACCESS_GET)};
+    char buffer[ATTRIBUTE_BUFFER_SIZE];
+    ssize_t len;
+    bool ret;
+
+    len = TEMP_FAILURE_RETRY(pread(attr->mFd, buffer, sizeof(buffer), 0));
+    if (!(ret = len >= 0 && utils::parse(buffer, buffer + len, value))) {
+        ALOGE("Failed to read %s (%d): %s", mNames[attr].c_str(), errno, strerror(errno));
+    }
+    HWAPI_RECORD(*value, attr);
+    return ret;
+}
+
+template <typename T>
+bool HwApiBase::set(const T &value, Attribute *attr) {
+    ATRACE_NAME("HwApi::set");
+    Histogram::Timer timer{latency(attr, ACCESS_SET)};
+    char buffer[ATTRIBUTE_BUFFER_SIZE];
+    // leave room for the trailing newline
+    char *end = utils::format(buffer, buffer + sizeof(buffer) - 1, value);
+    bool ret = false;
+
+    if (end != nullptr) {
+        *end++ = '\n';
+        size_t len = end - buffer;
+
+        std::scoped_lock shadowLock{attr->mShadowMutex};
+        if (len == attr->mShadowLen && !memcmp(buffer, attr->mShadow, len)) {
+            timer.cancel();
+            record("skip", value, attr);
+            return true;
+        }
+        if (auto *op = mBatch ? mBatch->queue() : nullptr) {
+            op->fd = attr->mFd;
+            op->write = true;
+            op->offset = 0;
+            op->len = len;
+            memcpy(op->buffer, buffer, len);
+            op->done = &HwApiBase::completeSet;
+            op->owner = this;
+            op->context = attr;
+            // timed on completion
+            timer.cancel();
+            HWAPI_RECORD(value, attr);
+            return true;
+        }
+        ret = TEMP_FAILURE_RETRY(pwrite(attr->mFd, buffer, len, 0)) == static_cast<ssize_t>(len);
+        if (ret) {
+            memcpy(attr->mShadow, buffer, len);
+            attr->mShadowLen = len;
+        } else {
+            attr->mShadowLen = 0;
+        }
+    } else {
+        errno = EOVERFLOW;
+    }
+    if (!ret) {
+        ALOGE("Failed to write %s (%d): %s", mNames[attr].c_str(), errno, strerror(errno));
+    }
+    HWAPI_RECORD(value, attr);
+    return ret;
+}
+
+template <typename T, typename U>
+bool HwApiBase::poll(const T &value, U *stream, const int32_t timeoutMs,
+                     const std::function<bool()> &cancel) {
     ATRACE_NAME("HwApi::poll");
-    auto path = mPathPrefix + mNames[stream];
-    unique_fd fileFd{::open(path.c_str(), O_RDONLY)};
-    unique_fd epollFd{epoll_create(1)};
-    epoll_event event = {
-            .events = EPOLLPRI | EPOLLET,
-    };
+    Histogram::Timer timer{latency(stream, ACCESS_POLL)};
+    auto &reactor = PollReactor::Get();
+    int32_t watch;
+    uint64_t generation;
     T actual;
     bool ret;
-    int epollRet;
 
     if (timeoutMs < -1) {
         ALOGE("Invalid polling timeout!");
+        errno = EINVAL;
         return false;
     }
 
-    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fileFd, &event)) {
-        ALOGE("Failed to poll %s (%d): %s", mNames[stream].c_str(), errno, strerror(errno));
+    {
+        std::scoped_lock ioLock{mIoMutex};
+        auto it = mWatches.find(stream);
+        if (it != mWatches.end()) {
+            watch = it->second;
+        } else if ((watch = reactor.watch(mPathPrefix + mNames[stream])) >= 0) {
+            mWatches[stream] = watch;
+        }
+    }
+
+    if (watch < 0) {
+        ALOGE("Failed to poll %s", mNames[stream].c_str());
         return false;
     }
 
-    while ((ret = get(&actual, stream)) && (actual != value)) {
-        epollRet = epoll_wait(epollFd, &event, 1, timeoutMs);
-        if (epollRet <= 0) {
-            ALOGE("Polling error or timeout! (%d)", epollRet);
+    // Spurious notifications must not restart the timeout.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while ((generation = reactor.generation(watch), ret = getNow(&actual, stream)) &&
+           (actual != value)) {
+        int32_t remainingMs = -1;
+        if (timeoutMs >= 0) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+            remainingMs = std::max<int64_t>(remaining.count(), 0);
+        }
+        int err = reactor.wait(watch, generation, remainingMs, cancel);
+        if (err) {
+            if (err != -ETIMEDOUT && err != -ECANCELED) {
+                ALOGE("Polling error (%d): %s", -err, strerror(-err));
+            }
+            errno = -err;
             return false;
         }
     }
@@ -159,20 +367,60 @@ bool HwApiBase::poll(const T &value, std::istream *stream, const int32_t timeout
 }
 
 template <typename T>
-void HwApiBase::record(const char *func, const T &value, const std::ios *stream) {
-    std::lock_guard<std::mutex> lock(mRecordsMutex);
-    mRecords.emplace_back(std::make_unique<Record<T>>(func, value, stream));
-    mRecords.pop_front();
+void HwApiBase::record(const char *func, const T &value, const void *key) {
+    uint64_t index = mRecordsCursor.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = mRecords[index % mRecordsSize];
+
+    Record record{};
+
+    record.func = func;
+    record.key = key;
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count();
+    record.encode(value);
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.store(record);
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
 }
 
 template <typename T>
-std::string HwApiBase::Record<T>::toString(const NamesMap &names) {
-    using utils::operator<<;
-    std::stringstream ret;
+bool HwApiBase::completeGet(UringBatch::Op &op, int32_t result) {
+    auto *self = static_cast<HwApiBase *>(op.owner);
+    auto *attr = static_cast<Attribute *>(op.context);
+    auto *value = static_cast<T *>(op.output);
+    bool ret = result >= 0 && utils::parse(op.buffer, op.buffer + result, value);
 
-    ret << mFunc << " '" << names.at(mStream) << "' = '" << mValue << "'";
+    if (auto *histogram = self->latency(attr, ACCESS_GET)) {
+        histogram->record(Histogram::now() - op.queuedNs);
+    }
+    if (!ret) {
+        int err = result < 0 ? -result : EINVAL;
+        ALOGE("Failed to read %s (%d): %s", self->mNames[attr].c_str(), err, strerror(err));
+    }
+    self->record("get", *value, attr);
+    return ret;
+}
 
-    return ret.str();
+template <typename T>
+void HwApiBase::Record::encode(const T &value) {
+    if constexpr (std::is_floating_point_v<T>) {
+        kind = Kind::FLOAT;
+        this->value.f = value;
+    } else if constexpr (std::is_signed_v<T>) {
+        kind = Kind::SIGNED;
+        this->value.i = value;
+    } else if constexpr (std::is_integral_v<T>) {
+        kind = Kind::UNSIGNED;
+        this->value.u = value;
+    } else {
+        std::string_view str{value};
+        kind = Kind::STRING;
+        length = std::min(str.size(), STRING_SIZE);
+        std::copy_n(str.begin(), length, this->value.s);
+    }
 }
 
 class HwCalBase {
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Histogram.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+int64_t Histogram::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+uint32_t Histogram::index(uint64_t ns) {
+    if (ns < SUB_COUNT) {
+        return ns;
+    }
+    ns = std::min(ns, (UINT64_C(1) << MAX_BITS) - 1);
+
+    uint32_t msb = 63 - __builtin_clzll(ns);
+    uint32_t sub = (ns >> (msb - SUB_BITS)) - SUB_COUNT;
+    return (msb - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+uint64_t Histogram::upperBound(uint32_t index) {
+    if (index < SUB_COUNT) {
+        return index;
+    }
+
+    uint32_t msb = index / SUB_COUNT + SUB_BITS - 1;
+    uint32_t sub = index % SUB_COUNT;
+    return ((uint64_t{SUB_COUNT} + sub + 1) << (msb - SUB_BITS)) - 1;
+}
+
+void Histogram::record(int64_t ns) {
+    uint64_t value = std::max<int64_t>(ns, 0);
+    uint64_t max = mMax.load(std::memory_order_relaxed);
+
+    mBuckets[index(value)].fetch_add(1, std::memory_order_relaxed);
+    while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::count() const {
+    uint64_t count = 0;
+    for (auto &bucket : mBuckets) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    uint64_t target = std::ceil(p * count());
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += mBuckets[i].load(std::memory_order_relaxed);
+        if (seen >= target && seen > 0) {
+            return std::min(upperBound(i), max());
+        }
+    }
+    return max();
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Log-linear latency histogram in nanoseconds. Each power of two is split in
+// SUB_COUNT linear buckets, bounding the error of reported values to 1/8th.
+// Recording is lock-free and safe from any thread.
+class Histogram {
+  public:
+    static constexpr uint32_t SUB_BITS = 3;
+    static constexpr uint32_t SUB_COUNT = 1 << SUB_BITS;
+    // longer latencies, above 18 minutes, are counted in the last bucket
+    static constexpr uint32_t MAX_BITS = 40;
+    static constexpr uint32_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    // Records the time from construction to destruction, unless cancelled.
+    class Timer {
+      public:
+        explicit Timer(Histogram *histogram) : mHistogram(histogram), mStartNs(now()) {}
+        ~Timer() {
+            if (mHistogram) {
+                mHistogram->record(now() - mStartNs);
+            }
+        }
+        void cancel() { mHistogram = nullptr; }
+
+      private:
+        Histogram *mHistogram;
+        const int64_t mStartNs;
+    };
+
+    // Monotonic clock in nanoseconds.
+    static int64_t now();
+
+    void record(int64_t ns);
+    uint64_t count() const;
+    uint64_t max() const { return mMax.load(std::memory_order_relaxed); }
+    // Returns an upper bound of the latency under which a fraction 'p' of
+    // the samples lie.
+    uint64_t percentile(double p) const;
+
+  private:
+    static uint32_t index(uint64_t ns);
+    static uint64_t upperBound(uint32_t index);
+
+    std::atomic<uint32_t> mBuckets[BUCKETS] = {};
+    std::atomic<uint64_t> mMax{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
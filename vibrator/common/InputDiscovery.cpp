@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputDiscovery.h"
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <linux/input.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::android::base::unique_fd;
+
+// Rescan period when the node directory cannot be watched.
+static constexpr std::chrono::milliseconds RESCAN_INTERVAL{100};
+static constexpr size_t INPUT_NAME_SIZE = 64;
+
+static bool allFound(const std::vector<unique_fd> &fds) {
+    return std::all_of(fds.begin(), fds.end(), [](auto &fd) { return fd.ok(); });
+}
+
+bool InputDiscovery::find(const std::vector<std::string> &names, std::vector<unique_fd> *fds,
+                          std::chrono::milliseconds timeout) {
+    ATRACE_NAME("InputDiscovery::find");
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    const std::string dir = mPattern.substr(0, mPattern.rfind('/') + 1);
+
+    fds->clear();
+    fds->resize(names.size());
+
+    // Watch before scanning, so nodes created in between are not missed.
+    unique_fd inotifyFd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+    if (inotifyFd.ok() && inotify_add_watch(inotifyFd, dir.c_str(), IN_CREATE | IN_ATTRIB) < 0) {
+        ALOGW("Failed to watch %s (%d): %s", dir.c_str(), errno, strerror(errno));
+        inotifyFd.reset();
+    }
+
+    scan(names, fds);
+
+    while (!allFound(*fds)) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            break;
+        }
+
+        if (!inotifyFd.ok()) {
+            std::this_thread::sleep_for(std::min(remaining, RESCAN_INTERVAL));
+            scan(names, fds);
+            continue;
+        }
+
+        struct pollfd pfd = {.fd = inotifyFd, .events = POLLIN};
+        int ret = poll(&pfd, 1, remaining.count());
+        if (ret < 0 && errno != EINTR) {
+            ALOGE("Failed to poll %s (%d): %s", dir.c_str(), errno, strerror(errno));
+            break;
+        }
+        if (ret <= 0) {
+            continue;
+        }
+
+        alignas(struct inotify_event) char buffer[4096];
+        ssize_t len;
+        while ((len = TEMP_FAILURE_RETRY(read(inotifyFd, buffer, sizeof(buffer)))) > 0) {
+            for (char *p = buffer; p < buffer + len;) {
+                auto *event = reinterpret_cast<struct inotify_event *>(p);
+                p += sizeof(*event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+                std::string path = dir + event->name;
+                if (fnmatch(mPattern.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+                    probe(path.c_str(), names, fds);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (!(*fds)[i].ok()) {
+            ALOGE("Failed to get an input event with name %s", names[i].c_str());
+        }
+    }
+    return allFound(*fds);
+}
+
+void InputDiscovery::scan(const std::vector<std::string> &names, std::vector<unique_fd> *fds) {
+    glob_t paths;
+
+    if (glob(mPattern.c_str(), 0, nullptr, &paths)) {
+        return;
+    }
+    for (size_t i = 0; i < paths.gl_pathc && !allFound(*fds); i++) {
+        probe(paths.gl_pathv[i], names, fds);
+    }
+    globfree(&paths);
+}
+
+void InputDiscovery::probe(const char *path, const std::vector<std::string> &names,
+                           std::vector<unique_fd> *fds) {
+    unique_fd fd{TEMP_FAILURE_RETRY(open(path, O_RDWR | O_CLOEXEC))};
+    uint32_t val = 0;
+    char str[INPUT_NAME_SIZE] = {0x00};
+
+    if (!fd.ok() || ioctl(fd, EVIOCGBIT(0, sizeof(val)), &val) <= 0 || !(val & (1 << EV_FF)) ||
+        ioctl(fd, EVIOCGNAME(sizeof(str) - 1), &str) <= 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (!(*fds)[i].ok() && strstr(str, names[i].c_str()) != nullptr) {
+            ALOGI("Control %s through %s", names[i].c_str(), path);
+            (*fds)[i] = std::move(fd);
+            return;
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Locates force feedback input devices by name.
+//
+// Nodes already present are probed once. Nodes created, or made accessible,
+// later are probed as inotify reports them, so a driver that registers late
+// is picked up as soon as its node appears instead of on the next retry.
+class InputDiscovery {
+  public:
+    // 'pattern' is matched against node paths as by glob(), e.g.
+    // "/dev/input/event*".
+    explicit InputDiscovery(std::string pattern) : mPattern(std::move(pattern)) {}
+
+    // Opens the device whose name contains names[i] into (*fds)[i], for all
+    // names in a single pass. Returns false if some were not found before
+    // 'timeout' expired; their fds are left invalid.
+    bool find(const std::vector<std::string> &names,
+              std::vector<::android::base::unique_fd> *fds, std::chrono::milliseconds timeout);
+
+  private:
+    void scan(const std::vector<std::string> &names, std::vector<::android::base::unique_fd> *fds);
+    void probe(const char *path, const std::vector<std::string> &names,
+               std::vector<::android::base::unique_fd> *fds);
+
+    const std::string mPattern;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
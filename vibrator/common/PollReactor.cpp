@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PollReactor.h"
+
+#include <fcntl.h>
+#include <log/log.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cerrno>
+#include <chrono>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr uint32_t FALLBACK_INDEX = UINT32_MAX;
+static constexpr int EPOLL_MAX_EVENTS = 8;
+
+PollReactor &PollReactor::Get() {
+    // Never destroyed; the reactor thread lives as long as the process.
+    static PollReactor *reactor = new PollReactor();
+    return *reactor;
+}
+
+PollReactor::PollReactor() {
+    mEpollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!mEpollFd.ok()) {
+        ALOGE("Failed to create reactor epoll (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    mThread = std::thread(&PollReactor::run, this);
+    mThread.detach();
+}
+
+void PollReactor::setFallback(std::unique_ptr<Fallback> fallback) {
+    std::scoped_lock lock{mMutex};
+    epoll_event event = {
+            .events = EPOLLIN,
+            .data.u32 = FALLBACK_INDEX,
+    };
+
+    if (mFallback || !mEpollFd.ok()) {
+        return;
+    }
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fallback->fd(), &event)) {
+        ALOGE("Failed to watch reactor fallback (%d): %s", errno, strerror(errno));
+        return;
+    }
+    mFallback = std::move(fallback);
+}
+
+int32_t PollReactor::watch(const std::string &path) {
+    ATRACE_NAME("PollReactor::watch");
+    std::scoped_lock lock{mMutex};
+
+    auto it = mPaths.find(path);
+    if (it != mPaths.end()) {
+        return it->second;
+    }
+
+    if (!mEpollFd.ok() || mFailed) {
+        return -1;
+    }
+
+    auto watch = std::make_unique<Watch>();
+    uint32_t index = mWatches.size();
+    epoll_event event = {
+            .events = EPOLLPRI | EPOLLET,
+            .data.u32 = index,
+    };
+
+    watch->path = path;
+    watch->fd.reset(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!watch->fd.ok()) {
+        ALOGE("Failed to open %s (%d): %s", path.c_str(), errno, strerror(errno));
+        return -1;
+    }
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, watch->fd, &event)) {
+        if (errno != EPERM || !mFallback) {
+            ALOGE("Failed to poll %s (%d): %s", path.c_str(), errno, strerror(errno));
+            return -1;
+        }
+        watch->handle = mFallback->add(path);
+        if (watch->handle < 0) {
+            ALOGE("Failed to watch %s (%d): %s", path.c_str(), errno, strerror(errno));
+            return -1;
+        }
+    }
+
+    mWatches.push_back(std::move(watch));
+    mPaths[path] = index;
+    return index;
+}
+
+uint64_t PollReactor::generation(int32_t id) {
+    std::scoped_lock lock{mMutex};
+    if (id < 0 || static_cast<size_t>(id) >= mWatches.size()) {
+        return 0;
+    }
+    return mWatches[id]->generation;
+}
+
+int PollReactor::wait(int32_t id, uint64_t seen, int32_t timeoutMs,
+                      const std::function<bool()> &cancel) {
+    ATRACE_NAME("PollReactor::wait");
+    std::unique_lock lock{mMutex};
+
+    if (id < 0 || static_cast<size_t>(id) >= mWatches.size()) {
+        return -EINVAL;
+    }
+
+    bool cancelled = false;
+    auto changed = [&] {
+        cancelled = cancel && cancel();
+        return mFailed || cancelled || mWatches[id]->generation != seen;
+    };
+
+    if (timeoutMs < 0) {
+        mCondition.wait(lock, changed);
+    } else if (!mCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), changed)) {
+        return -ETIMEDOUT;
+    }
+    if (mFailed) {
+        return -EIO;
+    }
+    return cancelled ? -ECANCELED : 0;
+}
+
+void PollReactor::wake() {
+    {
+        // Taken so that no waiter is between checking 'cancel' and blocking.
+        std::scoped_lock lock{mMutex};
+    }
+    mCondition.notify_all();
+}
+
+void PollReactor::notify(uint32_t index) {
+    std::scoped_lock lock{mMutex};
+    if (index < mWatches.size()) {
+        mWatches[index]->generation++;
+    }
+}
+
+void PollReactor::drainFallback() {
+    std::scoped_lock lock{mMutex};
+    mFallback->drain([this](int handle) {
+        for (auto &watch : mWatches) {
+            if (watch->handle == handle) {
+                watch->generation++;
+            }
+        }
+    });
+}
+
+void PollReactor::run() {
+    epoll_event events[EPOLL_MAX_EVENTS];
+
+    while (true) {
+        int count = epoll_wait(mEpollFd, events, EPOLL_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Anything else means the epoll set itself is unusable, and
+            // retrying would only spin. Fail current and future waiters.
+            ALOGE("Reactor polling error (%d): %s", errno, strerror(errno));
+            {
+                std::scoped_lock lock{mMutex};
+                mFailed = true;
+            }
+            mCondition.notify_all();
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u32 == FALLBACK_INDEX) {
+                drainFallback();
+            } else {
+                notify(events[i].data.u32);
+            }
+        }
+        mCondition.notify_all();
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
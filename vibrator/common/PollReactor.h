@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Process-wide epoll set watching sysfs attributes for sysfs_notify() events.
+//
+// Attributes are opened and registered once, then a single thread waits on
+// all of them and bumps a per-attribute generation counter on every
+// notification. Waiters sample the generation, read the attribute and block
+// until the generation moves on, so no notification can be missed between the
+// read and the wait.
+class PollReactor {
+  public:
+    // Source of change notifications for files that cannot be polled, such
+    // as the regular files standing in for sysfs in tests. The reactor only
+    // ever polls sysfs otherwise.
+    class Fallback {
+      public:
+        virtual ~Fallback() = default;
+        // Descriptor readable while changes are pending.
+        virtual int fd() const = 0;
+        // Starts watching 'path'. Returns a non-negative handle, or -1.
+        virtual int add(const std::string &path) = 0;
+        // Consumes the pending changes, passing the handle of each file
+        // changed to 'changed'.
+        virtual void drain(const std::function<void(int)> &changed) = 0;
+    };
+
+    static PollReactor &Get();
+
+    // Makes 'fallback' watch the attributes registered from now on that
+    // cannot be polled. For tests; the first one installed stays.
+    void setFallback(std::unique_ptr<Fallback> fallback);
+    // Registers the attribute at 'path' and returns its watch id, or -1 on
+    // failure. Registering the same path again returns the existing id.
+    int32_t watch(const std::string &path);
+    // Returns the number of notifications seen so far for 'id'.
+    uint64_t generation(int32_t id);
+    // Blocks until the generation of 'id' differs from 'seen', or 'cancel',
+    // if given, returns true. 'cancel' is checked on every notification and
+    // wake(). A negative timeout waits forever. Returns 0 once the generation
+    // moved on, -ETIMEDOUT on timeout, -ECANCELED once cancelled, and -EINVAL
+    // or -EIO for an invalid id or once the reactor thread has failed.
+    int wait(int32_t id, uint64_t seen, int32_t timeoutMs,
+             const std::function<bool()> &cancel = nullptr);
+    // Has the waiters check their 'cancel' again, e.g. once what they wait
+    // for no longer matters.
+    void wake();
+
+  private:
+    struct Watch {
+        std::string path;
+        ::android::base::unique_fd fd;
+        int handle{-1};
+        uint64_t generation{0};
+    };
+
+    PollReactor();
+    void run();
+    void notify(uint32_t index);
+    void drainFallback();
+
+    ::android::base::unique_fd mEpollFd;
+    std::thread mThread;
+    std::mutex mMutex;  // protects everything below
+    std::condition_variable mCondition;
+    std::unique_ptr<Fallback> mFallback;
+    std::vector<std::unique_ptr<Watch>> mWatches;
+    std::map<std::string, int32_t> mPaths;
+    // Set when the reactor thread exits on an unrecoverable epoll error.
+    bool mFailed{false};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
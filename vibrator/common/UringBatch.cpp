@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UringBatch.h"
+
+#include <liburing.h>
+#include <log/log.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cstring>
+
+#include "Histogram.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+UringBatch *UringBatch::Get() {
+    // Never destroyed; shared by every HwApi for the life of the process.
+    static UringBatch *batch = [] {
+        auto *batch = new UringBatch();
+        if (!batch->init()) {
+            delete batch;
+            return static_cast<UringBatch *>(nullptr);
+        }
+        return batch;
+    }();
+    return batch;
+}
+
+bool UringBatch::init() {
+    mRing = std::make_unique<struct io_uring>();
+    int ret = io_uring_queue_init(DEPTH, mRing.get(), 0);
+    if (ret < 0) {
+        ALOGE("Failed to create io_uring (%d): %s", -ret, strerror(-ret));
+        return false;
+    }
+    return true;
+}
+
+void UringBatch::begin() {
+    if (!active()) {
+        mBatchMutex.lock();
+        mOwner = std::this_thread::get_id();
+        mCount = 0;
+    }
+    mNesting++;
+}
+
+UringBatch::Op *UringBatch::queue() {
+    if (!active() || mBroken || mCount == mOps.size()) {
+        return nullptr;
+    }
+    auto *op = &mOps[mCount++];
+    op->queuedNs = Histogram::now();
+    return op;
+}
+
+bool UringBatch::submit() {
+    ATRACE_NAME("UringBatch::submit");
+    std::array<bool, DEPTH> completed{};
+    bool ret = true;
+    bool stale = false;
+    uint32_t submitted = 0;
+    int32_t lost = 0;
+
+    if (!active() || --mNesting > 0) {
+        return true;
+    }
+
+    for (uint32_t i = 0; i < mCount; i++) {
+        auto &op = mOps[i];
+        auto *sqe = io_uring_get_sqe(mRing.get());
+        if (op.write) {
+            io_uring_prep_write(sqe, op.fd, op.buffer, op.len, op.offset);
+        } else {
+            io_uring_prep_read(sqe, op.fd, op.buffer, op.len, op.offset);
+        }
+        io_uring_sqe_set_data(sqe, &op);
+    }
+
+    if (mCount > 0) {
+        int count = io_uring_submit_and_wait(mRing.get(), mCount);
+        if (count < 0) {
+            ALOGE("Failed to submit batch (%d): %s", -count, strerror(-count));
+        } else {
+            submitted = count;
+        }
+        // entries the kernel did not consume would go out with the next batch
+        stale = submitted < mCount;
+    }
+
+    for (uint32_t pending = submitted; pending > 0;) {
+        struct io_uring_cqe *cqe;
+        int err = io_uring_wait_cqe(mRing.get(), &cqe);
+        if (err < 0) {
+            if (err == -EINTR) {
+                continue;
+            }
+            ALOGE("Failed to complete batch (%d): %s", -err, strerror(-err));
+            // completions left in the ring would be reaped by the next batch
+            stale = true;
+            lost = err;
+            break;
+        }
+        auto *op = static_cast<Op *>(io_uring_cqe_get_data(cqe));
+        ret &= op->done(*op, cqe->res);
+        completed[op - mOps.data()] = true;
+        io_uring_cqe_seen(mRing.get(), cqe);
+        pending--;
+    }
+
+    // Submitted entries form a prefix of the batch. Those past it never reached
+    // the kernel and are performed here instead, while the outcome of those
+    // whose completion was lost is unknown.
+    for (uint32_t i = 0; i < mCount; i++) {
+        if (!completed[i]) {
+            ret &= mOps[i].done(mOps[i], i < submitted ? lost : perform(mOps[i]));
+        }
+    }
+
+    if (stale) {
+        reset();
+    }
+
+    mCount = 0;
+    mOwner = std::thread::id();
+    mBatchMutex.unlock();
+    return ret;
+}
+
+int32_t UringBatch::perform(Op &op) {
+    ssize_t ret;
+
+    if (op.offset == static_cast<uint64_t>(-1)) {
+        ret = op.write ? TEMP_FAILURE_RETRY(write(op.fd, op.buffer, op.len))
+                       : TEMP_FAILURE_RETRY(read(op.fd, op.buffer, op.len));
+    } else {
+        ret = op.write ? TEMP_FAILURE_RETRY(pwrite(op.fd, op.buffer, op.len, op.offset))
+                       : TEMP_FAILURE_RETRY(pread(op.fd, op.buffer, op.len, op.offset));
+    }
+    return ret < 0 ? -errno : ret;
+}
+
+void UringBatch::reset() {
+    io_uring_queue_exit(mRing.get());
+    int ret = io_uring_queue_init(DEPTH, mRing.get(), 0);
+    if (ret < 0) {
+        ALOGE("Failed to reset io_uring (%d): %s", -ret, strerror(-ret));
+        // leave every access to the synchronous path from now on
+        mBroken = true;
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
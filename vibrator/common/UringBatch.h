@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct io_uring;
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Process-wide io_uring through which HwApi instances submit independent
+// sysfs reads/writes and evdev writes, e.g. for both actuators, with a single
+// system call.
+//
+// begin() opens a batch for the calling thread; until the matching submit(),
+// the accesses it queues are deferred and other threads wait in begin().
+// Batches nest: only the outermost submit() sends the whole batch, waits for
+// every access and runs their completions on the calling thread, so failures
+// are only reported there.
+class UringBatch {
+  public:
+    static constexpr uint32_t DEPTH = 16;
+    static constexpr size_t BUFFER_SIZE = 128;
+
+    struct Op;
+    // Handles the result of an access, as returned by read()/write(). Returns
+    // false if the access failed.
+    using Completion = bool (*)(Op &op, int32_t result);
+
+    struct Op {
+        int fd;
+        bool write;
+        // -1 to use the file position, as needed for character devices
+        uint64_t offset;
+        // bytes to write from, or space to read into, 'buffer'
+        uint32_t len;
+        char buffer[BUFFER_SIZE];
+        Completion done;
+        // Histogram::now() when queued
+        int64_t queuedNs;
+        // caller defined
+        void *owner;
+        void *context;
+        void *output;
+    };
+
+    // Returns nullptr if io_uring is not available.
+    static UringBatch *Get();
+
+    void begin();
+    // Returns the next free entry of the calling thread's batch, to be filled
+    // in by the caller, or nullptr if the thread has no open batch or the
+    // batch is full and the access must be performed synchronously.
+    Op *queue();
+    // Returns false if any queued access failed. Inner and unmatched calls
+    // have nothing to submit and return true.
+    bool submit();
+
+  private:
+    UringBatch() = default;
+    bool init();
+    bool active() const { return mOwner.load() == std::this_thread::get_id(); }
+    // Performs 'op' on the calling thread, returning what its completion
+    // would have reported.
+    static int32_t perform(Op &op);
+    // Recreates the ring, dropping any entries and completions left in it.
+    void reset();
+
+    std::unique_ptr<struct io_uring> mRing;
+    std::mutex mBatchMutex;  // held from begin() to submit()
+    std::atomic<std::thread::id> mOwner;
+    // only accessed by mOwner
+    std::array<Op, DEPTH> mOps;
+    uint32_t mCount{0};
+    uint32_t mNesting{0};
+    // Set if the ring could not be recreated; accesses are then synchronous.
+    bool mBroken{false};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
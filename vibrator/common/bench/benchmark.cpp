@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "HardwareBase.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Fake sysfs tree, placed on tmpfs when available so the numbers reflect the
+// I/O path rather than the backing filesystem.
+class FakeSysfs {
+  public:
+    static constexpr const char *GET_NAME = "default/num_waves";
+    static constexpr const char *SET_NAME = "default/f0_offset";
+
+    FakeSysfs() {
+        std::string base = std::getenv("HWAPI_BENCH_DIR") ?: "/dev/shm";
+        std::error_code ec;
+
+        if (!std::filesystem::is_directory(base, ec)) {
+            base = std::filesystem::temp_directory_path(ec);
+        }
+        mRoot = base + "/vibrator-bench-XXXXXX";
+        if (mkdtemp(mRoot.data()) == nullptr) {
+            ALOGE("Failed to create %s (%d): %s", mRoot.c_str(), errno, strerror(errno));
+            return;
+        }
+
+        for (auto name : {GET_NAME, SET_NAME}) {
+            auto path = std::filesystem::path(mRoot) / name;
+            std::filesystem::create_directories(path.parent_path(), ec);
+            std::ofstream{path} << 0 << std::endl;
+        }
+        std::ofstream{std::filesystem::path(mRoot) / GET_NAME} << 96 << std::endl;
+
+        setenv("HWAPI_PATH_PREFIX", (mRoot + "/").c_str(), true);
+    }
+
+    ~FakeSysfs() {
+        std::error_code ec;
+        std::filesystem::remove_all(mRoot, ec);
+    }
+
+  private:
+    std::string mRoot;
+};
+
+// Same two attributes accessed through the stream and raw-fd interfaces.
+class StreamApi : private HwApiBase {
+  public:
+    StreamApi() {
+        open(FakeSysfs::GET_NAME, &mGet);
+        open(FakeSysfs::SET_NAME, &mSet);
+    }
+    bool get(uint32_t *value) { return HwApiBase::get(value, &mGet); }
+    bool set(uint32_t value) { return HwApiBase::set(value, &mSet); }
+
+  private:
+    std::ifstream mGet;
+    std::ofstream mSet;
+};
+
+class FdApi : private HwApiBase {
+  public:
+    FdApi() {
+        open(FakeSysfs::GET_NAME, &mGet);
+        open(FakeSysfs::SET_NAME, &mSet);
+    }
+    bool get(uint32_t *value) { return HwApiBase::get(value, &mGet); }
+    bool set(uint32_t value) { return HwApiBase::set(value, &mSet); }
+
+  private:
+    Attribute mGet{O_RDONLY};
+    Attribute mSet{O_WRONLY};
+};
+
+template <typename Api>
+static void BM_Get(benchmark::State &state) {
+    FakeSysfs sysfs;
+    Api api;
+    uint32_t value;
+
+    for (auto _ : state) {
+        if (!api.get(&value)) {
+            state.SkipWithError("get failed");
+            break;
+        }
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+template <typename Api>
+static void BM_Set(benchmark::State &state) {
+    FakeSysfs sysfs;
+    Api api;
+    uint32_t value = 0;
+
+    for (auto _ : state) {
+        if (!api.set(value++ & 0xFFFFFF)) {
+            state.SkipWithError("set failed");
+            break;
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Get, StreamApi);
+BENCHMARK_TEMPLATE(BM_Get, FdApi);
+BENCHMARK_TEMPLATE(BM_Set, StreamApi);
+BENCHMARK_TEMPLATE(BM_Set, FdApi);
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
@@ -20,9 +20,14 @@
 #include <android-base/properties.h>
 #include <log/log.h>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <sstream>
+#include <string_view>
 
 namespace aidl {
 namespace android {
@@ -84,6 +89,82 @@ inline void unpack<std::string>(std::istream &stream, std::string *value) {
     stream.setstate(std::istream::eofbit);
 }
 
+// Allocation-free counterpart of operator<<, formatting 'value' into
+// [first, last). Returns one past the last character written, or nullptr if
+// the value does not fit.
+template <typename T>
+inline std::enable_if_t<std::is_integral_v<T>, char *> format(char *first, char *last,
+                                                              const T value) {
+    // promote bool and 8-bit types so they print as numbers
+    auto [ptr, ec] = std::to_chars(first, last, +value);
+    return ec == std::errc() ? ptr : nullptr;
+}
+
+inline char *format(char *first, char *last, std::string_view value) {
+    if (value.size() > static_cast<size_t>(last - first)) {
+        return nullptr;
+    }
+    return std::copy(value.begin(), value.end(), first);
+}
+
+// Allocation-free counterpart of unpack(), parsing the first whitespace
+// delimited token of [first, last) into 'value'.
+template <typename T>
+inline std::enable_if_t<std::is_integral_v<T>, bool> parse(const char *first, const char *last,
+                                                           T *value) {
+    while (first != last && std::isspace(*first)) {
+        first++;
+    }
+    if (first != last && *first == '+') {
+        first++;
+    }
+    if constexpr (std::is_same_v<T, bool>) {
+        uint8_t number;
+        if (!parse(first, last, &number) || number > 1) {
+            return false;
+        }
+        *value = number;
+        return true;
+    } else {
+        auto [ptr, ec] = std::from_chars(first, last, *value);
+        return ec == std::errc() && (ptr == last || std::isspace(*ptr));
+    }
+}
+
+// Sets 'value' to the first whitespace delimited token of [first, last),
+// without copying it. The view is only valid as long as the source range.
+inline bool parse(const char *first, const char *last, std::string_view *value) {
+    first = std::find_if_not(first, last, [](char c) { return std::isspace(c); });
+    auto end = std::find_if(first, last, [](char c) { return std::isspace(c); });
+    *value = std::string_view(first, end - first);
+    return !value->empty();
+}
+
+// Fixed-capacity string, for reading text attributes into storage owned by
+// the caller rather than a heap allocated std::string.
+template <size_t N>
+class FixedString {
+  public:
+    operator std::string_view() const { return {mData, mSize}; }
+    bool assign(std::string_view value) {
+        if (value.size() > N) {
+            return false;
+        }
+        mSize = std::copy(value.begin(), value.end(), mData) - mData;
+        return true;
+    }
+
+  private:
+    char mData[N];
+    size_t mSize{0};
+};
+
+template <size_t N>
+inline bool parse(const char *first, const char *last, FixedString<N> *value) {
+    std::string_view token;
+    return parse(first, last, &token) && value->assign(token);
+}
+
 template <typename T>
 inline Enable_If_Signed<T, T> getProperty(const std::string &key, const T def) {
     if (std::is_floating_point_v<T>) {
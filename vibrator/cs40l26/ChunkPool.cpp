@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChunkPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// keeps every buffer aligned for the int16_t view of ff_effect custom_data
+static constexpr size_t BUFFER_ALIGNMENT = alignof(std::max_align_t);
+// fits a DspMemChunk along with the control block of its shared_ptr
+static constexpr size_t BLOCK_SIZE = 128;
+
+void ChunkPool::Release::operator()(uint8_t *buffer) const {
+    if (mPool) {
+        mPool->release(buffer);
+    } else {
+        delete[] buffer;
+    }
+}
+
+ChunkPool::ChunkPool(size_t count, size_t bufferSize)
+    : mCount(count),
+      mBufferSize((bufferSize + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1)),
+      mStorage(new uint8_t[mCount * mBufferSize]),
+      mBlockStorage(new uint8_t[mCount * BLOCK_SIZE]) {
+    mFree.reserve(mCount);
+    mFreeBlocks.reserve(mCount);
+    for (size_t i = 0; i < mCount; i++) {
+        mFree.push_back(mStorage.get() + i * mBufferSize);
+        mFreeBlocks.push_back(mBlockStorage.get() + i * BLOCK_SIZE);
+    }
+}
+
+ChunkPool::Buffer ChunkPool::acquire(size_t size) {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+
+    if (size > mBufferSize || mFree.empty()) {
+        mAllocations++;
+        return allocate(size);
+    }
+    mReuses++;
+    uint8_t *buffer = mFree.back();
+    mFree.pop_back();
+    return Buffer(buffer, Release(this));
+}
+
+void ChunkPool::release(uint8_t *buffer) {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    mFree.push_back(buffer);
+}
+
+void *ChunkPool::acquireBlock(size_t size) {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+
+    if (size > BLOCK_SIZE || mFreeBlocks.empty()) {
+        mAllocations++;
+        return ::operator new(size);
+    }
+    void *block = mFreeBlocks.back();
+    mFreeBlocks.pop_back();
+    return block;
+}
+
+void ChunkPool::releaseBlock(void *block) {
+    auto address = reinterpret_cast<uintptr_t>(block);
+    auto begin = reinterpret_cast<uintptr_t>(mBlockStorage.get());
+    if (address < begin || address >= begin + mCount * BLOCK_SIZE) {
+        ::operator delete(block);
+        return;
+    }
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    mFreeBlocks.push_back(static_cast<uint8_t *>(block));
+}
+
+size_t ChunkPool::available() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mFree.size();
+}
+
+uint64_t ChunkPool::reuses() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mReuses;
+}
+
+uint64_t ChunkPool::allocations() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mAllocations;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
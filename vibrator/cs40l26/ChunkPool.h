@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Fixed set of equally sized buffers, allocated once, that DspMemChunk encodes
+// waveforms into. A buffer goes back to the pool when its chunk is destroyed,
+// so encoding and caching waveforms does not touch the heap. The pool also
+// holds as many blocks for the shared_ptr sharing a chunk, see makeShared().
+// Should the pool run dry, buffers and blocks are allocated from the heap
+// instead and counted.
+//
+// Buffers must not outlive their pool. Thread-safe.
+class ChunkPool {
+  public:
+    // Deleter handing a buffer back to the pool it came from, or to the heap.
+    class Release {
+      public:
+        Release(ChunkPool *pool = nullptr) : mPool(pool) {}
+        void operator()(uint8_t *buffer) const;
+
+      private:
+        ChunkPool *mPool;
+    };
+    using Buffer = std::unique_ptr<uint8_t[], Release>;
+
+    // Allocator drawing from the pool's blocks, for std::allocate_shared().
+    template <typename T>
+    class Allocator {
+      public:
+        using value_type = T;
+
+        Allocator(ChunkPool *pool) : mPool(pool) {}
+        template <typename U>
+        Allocator(const Allocator<U> &other) : mPool(other.mPool) {}
+
+        T *allocate(size_t n) { return static_cast<T *>(mPool->acquireBlock(n * sizeof(T))); }
+        void deallocate(T *block, size_t /*n*/) { mPool->releaseBlock(block); }
+
+        template <typename U>
+        bool operator==(const Allocator<U> &other) const {
+            return mPool == other.mPool;
+        }
+        template <typename U>
+        bool operator!=(const Allocator<U> &other) const {
+            return mPool != other.mPool;
+        }
+
+      private:
+        template <typename U>
+        friend class Allocator;
+        ChunkPool *mPool;
+    };
+
+    ChunkPool(size_t count, size_t bufferSize);
+
+    // Returns an uninitialized buffer of at least 'size' bytes.
+    Buffer acquire(size_t size);
+    // Returns an uninitialized buffer of 'size' bytes from the heap, bypassing
+    // any pool.
+    static Buffer allocate(size_t size) { return Buffer(new uint8_t[size]); }
+    // Like std::make_shared(), with the object and its control block placed
+    // in one of the pool's blocks.
+    template <typename T, typename... Args>
+    std::shared_ptr<T> makeShared(Args &&...args) {
+        return std::allocate_shared<T>(Allocator<T>(this), std::forward<Args>(args)...);
+    }
+
+    size_t capacity() const { return mCount; }
+    size_t available() const;
+    // Buffers handed out from the pool.
+    uint64_t reuses() const;
+    // Buffers and blocks handed out from the heap, because the pool was empty
+    // or they were too large.
+    uint64_t allocations() const;
+
+  private:
+    void release(uint8_t *buffer);
+    void *acquireBlock(size_t size);
+    void releaseBlock(void *block);
+
+    const size_t mCount;
+    const size_t mBufferSize;
+    std::unique_ptr<uint8_t[]> mStorage;
+    std::unique_ptr<uint8_t[]> mBlockStorage;
+    mutable std::mutex mMutex;  // protects everything below
+    std::vector<uint8_t *> mFree;
+    std::vector<uint8_t *> mFreeBlocks;
+    uint64_t mReuses{0};
+    uint64_t mAllocations{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
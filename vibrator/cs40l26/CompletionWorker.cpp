@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompletionWorker.h"
+
+#include <utils/Trace.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+CompletionWorker::CompletionWorker() : mThread(&CompletionWorker::run, this) {}
+
+CompletionWorker::~CompletionWorker() {
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void CompletionWorker::post(Command &&command) {
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mCommands.push_back(std::move(command));
+    }
+    mCondition.notify_all();
+}
+
+size_t CompletionWorker::pending() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mCommands.size() + mRunning;
+}
+
+void CompletionWorker::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for (;;) {
+        mCondition.wait(lock, [this] { return mStopping || !mCommands.empty(); });
+        if (mCommands.empty()) {
+            return;
+        }
+        Command command = std::move(mCommands.front());
+        mCommands.pop_front();
+        mRunning = true;
+        lock.unlock();
+        {
+            ATRACE_NAME("CompletionWorker::run");
+            command();
+        }
+        // Drop whatever the command captured before taking the next one.
+        command = nullptr;
+        lock.lock();
+        mRunning = false;
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
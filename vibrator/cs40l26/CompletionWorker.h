@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Long-lived thread running the commands posted to it one at a time, in the
+// order they were posted, so that following an effect through to completion
+// does not cost a thread per effect.
+//
+// Commands still queued when the worker is destroyed run before it returns.
+// Thread-safe.
+class CompletionWorker {
+  public:
+    using Command = std::function<void()>;
+
+    CompletionWorker();
+    ~CompletionWorker();
+
+    void post(Command &&command);
+    // Commands posted but not yet finished, including the one running.
+    size_t pending() const;
+
+  private:
+    void run();
+
+    mutable std::mutex mMutex;  // protects everything below but mThread
+    std::condition_variable mCondition;
+    std::deque<Command> mCommands;
+    bool mRunning{false};
+    bool mStopping{false};
+    // Declared last, so it starts once everything it uses is constructed.
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
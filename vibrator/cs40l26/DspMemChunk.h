@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/Braking.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "ChunkPool.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+/* nsections is 8 bits. Need to preserve 1 section for the first delay before the first effect. */
+static constexpr int32_t COMPOSE_SIZE_MAX = 254;
+static constexpr int32_t COMPOSE_PWLE_SIZE_MAX_DEFAULT = 127;
+
+static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_COMP = 2044;  // (COMPOSE_SIZE_MAX + 1) * 8 + 4
+static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_PWLE = 2302;
+
+static constexpr int32_t COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS = 16383;
+
+static constexpr uint32_t WT_LEN_CALCD = 0x00800000;
+static constexpr uint8_t PWLE_CHIRP_BIT = 0x8;  // Dynamic/static frequency and voltage
+static constexpr uint8_t PWLE_BRAKE_BIT = 0x4;
+static constexpr uint8_t PWLE_AMP_REG_BIT = 0x2;
+
+static constexpr float CS40L26_PWLE_LEVEL_MIN = -1.0;
+static constexpr float CS40L26_PWLE_LEVEL_MAX = 0.9995118;
+static constexpr float PWLE_FREQUENCY_RESOLUTION_HZ = 1.00;
+static constexpr float PWLE_FREQUENCY_MIN_HZ = 1.00;
+static constexpr float PWLE_FREQUENCY_MAX_HZ = 1000.00;
+
+enum WaveformIndex : uint16_t {
+    /* Physical waveform */
+    WAVEFORM_LONG_VIBRATION_EFFECT_INDEX = 0,
+    WAVEFORM_RESERVED_INDEX_1 = 1,
+    WAVEFORM_CLICK_INDEX = 2,
+    WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX = 3,
+    WAVEFORM_THUD_INDEX = 4,
+    WAVEFORM_SPIN_INDEX = 5,
+    WAVEFORM_QUICK_RISE_INDEX = 6,
+    WAVEFORM_SLOW_RISE_INDEX = 7,
+    WAVEFORM_QUICK_FALL_INDEX = 8,
+    WAVEFORM_LIGHT_TICK_INDEX = 9,
+    WAVEFORM_LOW_TICK_INDEX = 10,
+    WAVEFORM_RESERVED_MFG_1,
+    WAVEFORM_RESERVED_MFG_2,
+    WAVEFORM_RESERVED_MFG_3,
+    WAVEFORM_MAX_PHYSICAL_INDEX,
+    /* OWT waveform */
+    WAVEFORM_COMPOSE = WAVEFORM_MAX_PHYSICAL_INDEX,
+    WAVEFORM_PWLE,
+    /*
+     * Refer to <linux/input.h>, the WAVEFORM_MAX_INDEX must not exceed 96.
+     * #define FF_GAIN		0x60  // 96 in decimal
+     * #define FF_MAX_EFFECTS	FF_GAIN
+     */
+    WAVEFORM_MAX_INDEX,
+};
+
+// Packs bit fields, most significant bit first, into the DSP's 24-bit words,
+// each stored as a big-endian 32-bit word with a zero top byte.
+//
+// Fields are shifted into a 64-bit accumulator and whole words are stored as
+// soon as 24 bits are pending. As with the original encoder, bits of a value
+// above 'nbits' are ORed into the fields before it. Usable in constant
+// expressions.
+class BitPacker {
+  public:
+    static constexpr uint32_t WORD_BITS = 24;
+    static constexpr size_t WORD_BYTES = 4;
+
+    constexpr BitPacker(uint8_t *first, const uint8_t *last) : BitPacker(first, first, last) {}
+    // Continues after the whole words already stored in [first, current).
+    constexpr BitPacker(uint8_t *first, uint8_t *current, const uint8_t *last)
+        : mFirst(first), mCurrent(current), mLast(last) {}
+
+    // Appends the low 'nbits' bits of 'value', up to 32. Returns -ENOSPC
+    // once a word does not fit; everything written afterwards is dropped.
+    constexpr int write(uint32_t nbits, uint32_t value) {
+        if (mFull) {
+            return -ENOSPC;
+        }
+        mAccumulator = (mAccumulator << nbits) | value;
+        mPending += nbits;
+
+        while (mPending >= WORD_BITS) {
+            if (mLast - mCurrent < static_cast<ptrdiff_t>(WORD_BYTES)) {
+                mFull = true;
+                return -ENOSPC;
+            }
+            mPending -= WORD_BITS;
+            uint32_t word = (mAccumulator >> mPending) & 0xFFFFFF;
+            mCurrent[0] = 0x00;
+            mCurrent[1] = (word >> 16) & 0xFF;
+            mCurrent[2] = (word >> 8) & 0xFF;
+            mCurrent[3] = word & 0xFF;
+            mCurrent += WORD_BYTES;
+        }
+        return 0;
+    }
+
+    // Pads the pending bits, if any, with zeroes to a whole word.
+    constexpr int flush() {
+        if (mFull) {
+            return -ENOSPC;
+        }
+        return mPending ? write(WORD_BITS - mPending, 0) : 0;
+    }
+
+    // Bytes stored so far.
+    constexpr size_t size() const { return mCurrent - mFirst; }
+
+  private:
+    uint8_t *mFirst;
+    uint8_t *mCurrent;
+    const uint8_t *mLast;
+    uint64_t mAccumulator{0};
+    uint32_t mPending{0};
+    bool mFull{false};
+};
+
+// Compose waveform layout, shared by DspMemChunk and ComposeImage.
+inline constexpr void writeComposeHeader(BitPacker *packer, uint8_t nsections) {
+    packer->write(8, 0);         /* Padding */
+    packer->write(8, nsections); /* nsections */
+    packer->write(8, 0);         /* repeat */
+}
+
+inline constexpr void writeComposeSection(BitPacker *packer, uint32_t effectVolLevel,
+                                          uint32_t effectIndex, uint8_t repeat, uint8_t flags,
+                                          uint16_t nextEffectDelay) {
+    packer->write(8, effectVolLevel);   /* amplitude */
+    packer->write(8, effectIndex);      /* index */
+    packer->write(8, repeat);           /* repeat */
+    packer->write(8, flags);            /* flags */
+    packer->write(16, nextEffectDelay); /* delay */
+}
+
+// A composition of N physical effects whose indexes and delays are known at
+// compile time, encoded with every volume level left at zero. Only the volume
+// levels depend on calibration; DspMemChunk fills them in when copying the
+// image, so playing it involves no encoding.
+template <size_t N>
+class ComposeImage {
+  public:
+    struct Section {
+        uint32_t effectIndex;
+        uint16_t nextEffectDelay;
+    };
+
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t SECTION_SIZE = 8;
+    static constexpr size_t SIZE = HEADER_SIZE + N * SECTION_SIZE;
+    static constexpr size_t NSECTIONS_OFFSET = 2;
+
+    static_assert(N > 0 && N <= COMPOSE_SIZE_MAX + 1);
+
+    // Byte holding the volume level of section 'i'.
+    static constexpr size_t volLevelOffset(size_t i) { return HEADER_SIZE + i * SECTION_SIZE + 1; }
+
+    constexpr explicit ComposeImage(const Section (&sections)[N]) {
+        BitPacker packer(mBytes, mBytes + SIZE);
+
+        writeComposeHeader(&packer, N);
+        for (size_t i = 0; i < N; i++) {
+            writeComposeSection(&packer, 0, sections[i].effectIndex, 0 /*repeat*/, 0 /*flags*/,
+                                sections[i].nextEffectDelay);
+        }
+        packer.flush();
+    }
+
+    constexpr const uint8_t *data() const { return mBytes; }
+    constexpr uint8_t operator[](size_t i) const { return mBytes[i]; }
+
+  private:
+    uint8_t mBytes[SIZE]{};
+};
+
+// One compose section as the DSP stores it: play 'effectIndex' at
+// 'effectVolLevel', then wait 'nextEffectDelay' ms, and do so 'repeat' more
+// times.
+struct ComposeSection {
+    uint8_t effectVolLevel;
+    uint8_t effectIndex;
+    uint8_t repeat;
+    uint16_t nextEffectDelay;
+};
+
+inline bool operator==(const ComposeSection &a, const ComposeSection &b) {
+    return a.effectVolLevel == b.effectVolLevel && a.effectIndex == b.effectIndex &&
+           a.repeat == b.repeat && a.nextEffectDelay == b.nextEffectDelay;
+}
+
+// Whether v[from, end) repeats every 'period' sections, the last repetition
+// possibly cut short.
+template <typename T, typename Equal>
+inline bool hasPeriod(const std::vector<T> &v, size_t from, size_t period, Equal equal) {
+    for (size_t i = from + period; i < v.size(); i++) {
+        if (!equal(v[i], v[i - period])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Folds runs of identical sections into one section repeating, e.g. a train
+// of ticks. Should the result be a pattern repeating, and one period fit in
+// 'maxSections', it is left with that period and the number of times the
+// whole composition is to be repeated is returned.
+inline uint8_t foldComposeRepeats(std::vector<ComposeSection> *sections, size_t maxSections) {
+    auto &v = *sections;
+    size_t n = 0;
+
+    for (size_t i = 0; i < v.size(); i++) {
+        if (n > 0) {
+            ComposeSection &prev = v[n - 1];
+            if (prev.effectVolLevel == v[i].effectVolLevel &&
+                prev.effectIndex == v[i].effectIndex &&
+                prev.nextEffectDelay == v[i].nextEffectDelay &&
+                prev.repeat + v[i].repeat + 1 <= UINT8_MAX) {
+                prev.repeat += v[i].repeat + 1;
+                continue;
+            }
+        }
+        v[n++] = v[i];
+    }
+    v.resize(n);
+
+    for (size_t period = 1; period <= v.size() / 2 && period <= maxSections; period++) {
+        if (v.size() % period == 0 && v.size() / period - 1 <= UINT8_MAX &&
+            hasPeriod(v, 0, period, std::equal_to<ComposeSection>())) {
+            uint8_t repeat = v.size() / period - 1;
+            v.resize(period);
+            return repeat;
+        }
+    }
+    return 0;
+}
+
+inline int fToU16(float input, uint16_t *output, float scale, float min, float max) {
+    if (input < min || input > max)
+        return -ERANGE;
+
+    *output = roundf(input * scale);
+    return 0;
+}
+
+// One PWLE section as the DSP stores it: ramp over 'delay' (0.25 ms) to
+// 'amplitude' (1/2048 of full scale) and 'frequency' (0.25 Hz).
+struct PwleSection {
+    uint16_t delay;
+    uint16_t amplitude;
+    uint16_t frequency;
+    uint8_t flags;
+};
+
+inline int makeActiveSection(int duration, float amplitude, float frequency, bool chirp,
+                             PwleSection *out) {
+    *out = {};
+    if ((fToU16(duration, &out->delay, 4, 0.0f, COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) < 0) ||
+        (fToU16(amplitude, &out->amplitude, 2048, CS40L26_PWLE_LEVEL_MIN,
+                CS40L26_PWLE_LEVEL_MAX) < 0) ||
+        (fToU16(frequency, &out->frequency, 4, PWLE_FREQUENCY_MIN_HZ, PWLE_FREQUENCY_MAX_HZ) < 0)) {
+        ALOGE("%s: Invalid argument: %d, %f, %f", __func__, duration, amplitude, frequency);
+        return -ERANGE;
+    }
+    if (chirp) {
+        out->flags |= PWLE_CHIRP_BIT;
+    }
+    return 0;
+}
+
+inline int makeBrakingSection(int duration, Braking brakingType, PwleSection *out) {
+    *out = {};
+    if (fToU16(duration, &out->delay, 4, 0.0f, COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) < 0) {
+        ALOGE("%s: Invalid argument: %d", __func__, duration);
+        return -ERANGE;
+    }
+    fToU16(PWLE_FREQUENCY_MIN_HZ, &out->frequency, 4, PWLE_FREQUENCY_MIN_HZ,
+           PWLE_FREQUENCY_MAX_HZ);
+    if (static_cast<std::underlying_type<Braking>::type>(brakingType)) {
+        out->flags |= PWLE_BRAKE_BIT;
+    }
+    return 0;
+}
+
+// Whether section 'b' starts at the point section 'a' ends at, i.e. playing
+// 'b' after 'a' changes nothing.
+inline bool isPwleRestatement(const PwleSection &a, const PwleSection &b) {
+    return b.delay == 0 && a.amplitude == b.amplitude && a.frequency == b.frequency &&
+           (a.flags | PWLE_CHIRP_BIT) == (b.flags | PWLE_CHIRP_BIT) &&
+           !(b.flags & PWLE_AMP_REG_BIT);
+}
+
+// Whether 'b' continues the ramp from 'origin' to 'a' at the same slope, so
+// that one section from 'origin' to 'b' plays the same. Frequency ramps only
+// with PWLE_CHIRP_BIT; without, it holds the section's frequency.
+inline bool isPwleContinuation(const PwleSection &origin, const PwleSection &a,
+                               const PwleSection &b) {
+    if (a.delay == 0 || b.delay == 0 || a.flags != b.flags || (a.flags & PWLE_AMP_REG_BIT) ||
+        a.delay + b.delay > COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS * 4) {
+        return false;
+    }
+    auto sameSlope = [&](int32_t v0, int32_t v1, int32_t v2) {
+        return int64_t{v1 - v0} * b.delay == int64_t{v2 - v1} * a.delay;
+    };
+    if (a.flags & PWLE_CHIRP_BIT) {
+        if (!sameSlope(origin.frequency, a.frequency, b.frequency)) {
+            return false;
+        }
+    } else if (a.frequency != b.frequency) {
+        return false;
+    }
+    return sameSlope(origin.amplitude, a.amplitude, b.amplitude);
+}
+
+// Rewrites 'sections' into as few as play the same waveform: drops
+// zero-length sections that stay at the previous point, e.g. the start of a
+// primitive continuing from the previous one, and merges ramps continuing at
+// the same slope, e.g. consecutive braking. The first section is kept as is,
+// since what precedes it is unknown.
+inline void optimizePwle(std::vector<PwleSection> *sections) {
+    auto &v = *sections;
+    size_t n = 0;
+
+    for (size_t i = 0; i < v.size(); i++) {
+        const PwleSection s = v[i];
+        if (n > 0) {
+            PwleSection &prev = v[n - 1];
+            if (isPwleRestatement(prev, s)) {
+                continue;
+            }
+            if (n > 1 && isPwleContinuation(v[n - 2], prev, s)) {
+                prev.delay += s.delay;
+                prev.amplitude = s.amplitude;
+                prev.frequency = s.frequency;
+                continue;
+            }
+        }
+        v[n++] = s;
+    }
+    v.resize(n);
+}
+
+class DspMemChunk {
+  private:
+    ChunkPool::Buffer head;
+    uint8_t waveformType;
+    BitPacker packer;
+
+    int write(int nbits, uint32_t val) { return packer.write(nbits, val); }
+
+    void constructPwleSegment(uint16_t delay, uint16_t amplitude, uint16_t frequency, uint8_t flags,
+                              uint32_t vbemfTarget = 0) {
+        write(16, delay);
+        write(12, amplitude);
+        write(12, frequency);
+        /* feature flags to control the chirp, CLAB braking, back EMF amplitude regulation */
+        write(8, (flags | 1) << 4);
+        if (flags & PWLE_AMP_REG_BIT) {
+            write(24, vbemfTarget); /* target back EMF voltage */
+        }
+    }
+
+  public:
+    uint8_t *front() const { return head.get(); }
+    uint8_t type() const { return waveformType; }
+    size_t size() const { return packer.size(); }
+
+    // Encodes into a buffer of 'size' bytes taken from 'pool', if given, or
+    // the heap.
+    DspMemChunk(uint8_t type, size_t size, ChunkPool *pool = nullptr)
+        : head(pool ? pool->acquire(size) : ChunkPool::allocate(size)),
+          packer(head.get(), head.get() + size) {
+        waveformType = type;
+
+        if (waveformType == WAVEFORM_COMPOSE) {
+            writeComposeHeader(&packer, 0 /* nsections placeholder */);
+        } else if (waveformType == WAVEFORM_PWLE) {
+            write(24, 0); /* Waveform length placeholder */
+            write(8, 0);  /* Repeat */
+            write(12, 0); /* Wait time between repeats */
+            write(8, 0);  /* nsections placeholder */
+        } else {
+            ALOGE("%s: Invalid type: %u", __func__, waveformType);
+        }
+    }
+
+    // Copies the 'size' encoded bytes at 'data'. The chunk holds exactly those
+    // and cannot be appended to.
+    DspMemChunk(uint8_t type, const uint8_t *data, size_t size)
+        : head(ChunkPool::allocate(size)),
+          waveformType(type),
+          packer(head.get(), head.get() + size, head.get() + size) {
+        std::copy(data, data + size, head.get());
+    }
+
+    // Copies 'image', playing section i at volLevels[i]. The chunk holds
+    // exactly the image and cannot be appended to.
+    template <size_t N>
+    DspMemChunk(const ComposeImage<N> &image, const uint32_t (&volLevels)[N])
+        : head(ChunkPool::allocate(ComposeImage<N>::SIZE)),
+          waveformType(WAVEFORM_COMPOSE),
+          packer(head.get(), head.get() + image.SIZE, head.get() + image.SIZE) {
+        std::copy(image.data(), image.data() + image.SIZE, head.get());
+        for (size_t i = 0; i < N; i++) {
+            head[image.volLevelOffset(i)] = volLevels[i];
+        }
+    }
+
+    int flush() { return packer.flush(); }
+
+    int constructComposeSegment(uint32_t effectVolLevel, uint32_t effectIndex, uint8_t repeat,
+                                uint8_t flags, uint16_t nextEffectDelay) {
+        if (waveformType != WAVEFORM_COMPOSE) {
+            ALOGE("%s: Invalid type: %d", __func__, waveformType);
+            return -EDOM;
+        }
+        if (effectVolLevel > 100 || effectIndex > WAVEFORM_MAX_PHYSICAL_INDEX) {
+            ALOGE("%s: Invalid argument: %u, %u", __func__, effectVolLevel, effectIndex);
+            return -EINVAL;
+        }
+        writeComposeSection(&packer, effectVolLevel, effectIndex, repeat, flags, nextEffectDelay);
+        return 0;
+    }
+
+    int constructComposeSection(const ComposeSection &section) {
+        return constructComposeSegment(section.effectVolLevel, section.effectIndex, section.repeat,
+                                       0 /*flags*/, section.nextEffectDelay);
+    }
+
+    int constructActiveSegment(int duration, float amplitude, float frequency, bool chirp) {
+        PwleSection section;
+        int ret = makeActiveSection(duration, amplitude, frequency, chirp, &section);
+        return ret < 0 ? ret : constructPwleSection(section);
+    }
+
+    int constructBrakingSegment(int duration, Braking brakingType) {
+        PwleSection section;
+        int ret = makeBrakingSection(duration, brakingType, &section);
+        return ret < 0 ? ret : constructPwleSection(section);
+    }
+
+    int constructPwleSection(const PwleSection &section) {
+        if (waveformType != WAVEFORM_PWLE) {
+            ALOGE("%s: Invalid type: %d", __func__, waveformType);
+            return -EDOM;
+        }
+        constructPwleSegment(section.delay, section.amplitude, section.frequency, section.flags,
+                             0 /*ignored*/);
+        return 0;
+    }
+
+    int updateWLength(uint32_t totalDuration) {
+        uint8_t *f = front();
+        if (f == nullptr) {
+            ALOGE("%s: head does not exist!", __func__);
+            return -ENOMEM;
+        }
+        if (waveformType != WAVEFORM_PWLE) {
+            ALOGE("%s: Invalid type: %d", __func__, waveformType);
+            return -EDOM;
+        }
+        if (totalDuration > 0x7FFFF) {
+            ALOGE("%s: Invalid argument: %u", __func__, totalDuration);
+            return -EINVAL;
+        }
+        totalDuration *= 8; /* Unit: 0.125 ms (since wlength played @ 8kHz). */
+        totalDuration |=
+                WT_LEN_CALCD; /* Bit 23 is for WT_LEN_CALCD; Bit 22 is for WT_INDEFINITE. */
+        *(f + 0) = (totalDuration >> 24) & 0xFF;
+        *(f + 1) = (totalDuration >> 16) & 0xFF;
+        *(f + 2) = (totalDuration >> 8) & 0xFF;
+        *(f + 3) = totalDuration & 0xFF;
+        return 0;
+    }
+
+    // Has the whole waveform played 'repeat' more times, 'wait' (PWLE only,
+    // 0.25 ms) apart.
+    int updateRepeat(uint8_t repeat, uint16_t wait = 0) {
+        uint8_t *f = front();
+        if (f == nullptr) {
+            ALOGE("%s: head does not exist!", __func__);
+            return -ENOMEM;
+        }
+
+        if (waveformType == WAVEFORM_COMPOSE) {
+            if (wait) {
+                ALOGE("%s: Invalid argument: %u", __func__, wait);
+                return -EINVAL;
+            }
+            *(f + 3) = repeat;
+        } else if (waveformType == WAVEFORM_PWLE) {
+            if (wait > 0xFFF) {
+                ALOGE("%s: Invalid argument: %u", __func__, wait);
+                return -EINVAL;
+            }
+            *(f + 5) = repeat;
+            *(f + 6) = wait >> 4;
+            *(f + 7) = (*(f + 7) & 0x0F) | ((wait & 0x0F) << 4);
+        } else {
+            ALOGE("%s: Invalid type: %d", __func__, waveformType);
+            return -EDOM;
+        }
+
+        return 0;
+    }
+
+    int updateNSection(int segmentIdx) {
+        uint8_t *f = front();
+        if (f == nullptr) {
+            ALOGE("%s: head does not exist!", __func__);
+            return -ENOMEM;
+        }
+
+        if (waveformType == WAVEFORM_COMPOSE) {
+            if (segmentIdx > COMPOSE_SIZE_MAX + 1 /*1st effect may have a delay*/) {
+                ALOGE("%s: Invalid argument: %d", __func__, segmentIdx);
+                return -EINVAL;
+            }
+            *(f + 2) = (0xFF & segmentIdx);
+        } else if (waveformType == WAVEFORM_PWLE) {
+            if (segmentIdx > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
+                ALOGE("%s: Invalid argument: %d", __func__, segmentIdx);
+                return -EINVAL;
+            }
+            *(f + 7) |= (0xF0 & segmentIdx) >> 4; /* Bit 4 to 7 */
+            *(f + 9) |= (0x0F & segmentIdx) << 4; /* Bit 3 to 0 */
+        } else {
+            ALOGE("%s: Invalid type: %d", __func__, waveformType);
+            return -EDOM;
+        }
+
+        return 0;
+    }
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
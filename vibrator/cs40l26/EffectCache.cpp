@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EffectCache.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+std::optional<EffectCache::Entry> EffectCache::find(const Key &key) {
+    std::scoped_lock lock{mMutex};
+    auto it = mIndex.find(key.mBytes);
+
+    if (it == mIndex.end()) {
+        mMisses++;
+        return std::nullopt;
+    }
+    mHits++;
+    mLru.splice(mLru.begin(), mLru, it->second);
+    return it->second->second;
+}
+
+void EffectCache::insert(Key key, Entry entry) {
+    std::scoped_lock lock{mMutex};
+
+    if (mCapacity == 0 || mIndex.count(key.mBytes)) {
+        return;
+    }
+    if (mLru.size() == mCapacity) {
+        mIndex.erase(mLru.back().first);
+        mLru.pop_back();
+    }
+    mLru.emplace_front(std::move(key.mBytes), std::move(entry));
+    // keys are viewed in place; list nodes never move
+    mIndex.emplace(mLru.front().first, mLru.begin());
+}
+
+size_t EffectCache::size() {
+    std::scoped_lock lock{mMutex};
+    return mLru.size();
+}
+
+uint64_t EffectCache::hits() {
+    std::scoped_lock lock{mMutex};
+    return mHits;
+}
+
+uint64_t EffectCache::misses() {
+    std::scoped_lock lock{mMutex};
+    return mMisses;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+class DspMemChunk;
+
+// Least recently used set of encoded OWT waveforms, so that compositions apps
+// replay, e.g. notification or keyboard patterns, are uploaded without being
+// validated and encoded again.
+//
+// Entries are addressed by the content of the request that produced them,
+// normalized into a Key. Hashing selects the entry and a full comparison
+// confirms it, so colliding requests never share a waveform. Safe from any
+// thread.
+class EffectCache {
+  public:
+    // Normalized request: the fields that determine the encoding, in order.
+    class Key {
+      public:
+        template <typename T>
+        Key &operator<<(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            mBytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+            return *this;
+        }
+
+      private:
+        friend class EffectCache;
+        std::string mBytes;
+    };
+
+    struct Entry {
+        std::shared_ptr<const DspMemChunk> ch;
+        uint32_t totalDurationMs;
+    };
+
+    explicit EffectCache(size_t capacity) : mCapacity(capacity) {}
+
+    // Returns the entry for 'key', now the most recently used, and counts a
+    // hit; or counts a miss.
+    std::optional<Entry> find(const Key &key);
+    // Adds an entry, evicting the least recently used one when full.
+    void insert(Key key, Entry entry);
+
+    size_t size();
+    size_t capacity() const { return mCapacity; }
+    uint64_t hits();
+    uint64_t misses();
+
+  private:
+    using Lru = std::list<std::pair<std::string, Entry>>;
+
+    const size_t mCapacity;
+    std::mutex mMutex;  // protects everything below
+    Lru mLru;           // most recently used first
+    std::unordered_map<std::string_view, Lru::iterator> mIndex;
+    uint64_t mHits{0};
+    uint64_t mMisses{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EffectPlan.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// The waveform length field counts 0.125 ms in 23 bits.
+static constexpr uint32_t PWLE_WLENGTH_MAX_MS = 0x7FFFF;
+
+void EffectPlan::reset() {
+    mKind = Kind::NONE;
+    mEffectIndex = 0;
+    mVolLevel = 0;
+    mChunk = nullptr;
+    mCompose.clear();
+    mPwle.clear();
+    mRepeat = 0;
+    mWaveforms.clear();
+    mDurationMs = 0;
+}
+
+void EffectPlan::setEffect(uint32_t effectIndex, uint32_t volLevel, uint32_t effectDurationMs) {
+    reset();
+    mKind = Kind::EFFECT;
+    mEffectIndex = effectIndex;
+    mVolLevel = volLevel;
+    mDurationMs = effectDurationMs + MAX_COLD_START_LATENCY_MS;
+}
+
+void EffectPlan::setChunk(const DspMemChunk *ch, uint32_t durationMs) {
+    reset();
+    mKind = Kind::CHUNK;
+    mChunk = ch;
+    mDurationMs = durationMs;
+}
+
+int EffectPlan::setCompose(std::vector<ComposeSection> &&sections,
+                           const std::vector<uint32_t> &effectDurationsMs) {
+    reset();
+    mCompose = std::move(sections);
+    mRepeat = foldComposeRepeats(&mCompose, COMPOSE_SIZE_MAX + 1);
+
+    for (size_t begin = 0; begin < mCompose.size(); begin += COMPOSE_SIZE_MAX + 1) {
+        size_t end = std::min<size_t>(begin + COMPOSE_SIZE_MAX + 1, mCompose.size());
+        uint32_t durationMs = 0;
+
+        for (size_t i = begin; i < end; i++) {
+            const ComposeSection &section = mCompose[i];
+            uint32_t sectionMs = 0;
+            // Index 0 with no volume is a pause on its own.
+            if (section.effectVolLevel || section.effectIndex) {
+                if (section.effectIndex >= effectDurationsMs.size()) {
+                    ALOGE("%s: Invalid effect index: %u", __func__, section.effectIndex);
+                    reset();
+                    return -EINVAL;
+                }
+                sectionMs += effectDurationsMs[section.effectIndex];
+            }
+            if (section.nextEffectDelay) {
+                sectionMs += section.nextEffectDelay + MAX_PAUSE_TIMING_ERROR_MS;
+            }
+            durationMs += sectionMs * (section.repeat + 1);
+        }
+        mWaveforms.push_back({begin, end, durationMs * (mRepeat + 1)});
+    }
+
+    mKind = Kind::COMPOSE;
+    return finish();
+}
+
+int EffectPlan::setPwle(std::vector<PwleSection> &&sections) {
+    reset();
+    mPwle = std::move(sections);
+    optimizePwle(&mPwle);
+
+    // Waveforms after the first start from where the previous one ended,
+    // taking up one section.
+    for (size_t begin = 0; begin < mPwle.size();) {
+        size_t end = std::min<size_t>(begin + COMPOSE_PWLE_SIZE_MAX_DEFAULT - (begin > 0),
+                                      mPwle.size());
+        uint64_t delay = 0;  // 0.25 ms
+
+        for (size_t i = begin; i < end; i++) {
+            delay += mPwle[i].delay;
+        }
+        uint64_t durationMs = (delay + 3) / 4;
+        if (durationMs + MAX_COLD_START_LATENCY_MS > PWLE_WLENGTH_MAX_MS) {
+            ALOGE("%s: Total duration is too long (%" PRIu64 ")!", __func__, durationMs);
+            reset();
+            return -EINVAL;
+        }
+        mWaveforms.push_back({begin, end, static_cast<uint32_t>(durationMs)});
+        begin = end;
+    }
+
+    mKind = Kind::PWLE;
+    return finish();
+}
+
+int EffectPlan::finish() {
+    const uint32_t offTimeMs = (mOffTimeUs + 999) / 1000;
+
+    if (mWaveforms.empty() || mWaveforms.size() > mMaxWaveforms) {
+        ALOGE("%s: Invalid waveform count: %zu", __func__, mWaveforms.size());
+        reset();
+        return -EINVAL;
+    }
+    mDurationMs = 0;
+    for (auto &waveform : mWaveforms) {
+        if (mDurationMs) {
+            mDurationMs += offTimeMs;
+        }
+        mDurationMs += waveform.durationMs + MAX_COLD_START_LATENCY_MS;
+    }
+    return 0;
+}
+
+size_t EffectPlan::sections() const {
+    size_t count = 0;
+    for (auto &waveform : mWaveforms) {
+        count += waveform.end - waveform.begin;
+        if (mKind == Kind::PWLE && waveform.begin > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+DspMemChunk EffectPlan::encode(size_t i, ChunkPool *pool) const {
+    const Waveform &waveform = mWaveforms[i];
+
+    if (mKind == Kind::COMPOSE) {
+        DspMemChunk ch(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP, pool);
+        for (size_t s = waveform.begin; s < waveform.end; s++) {
+            ch.constructComposeSection(mCompose[s]);
+        }
+        ch.flush();
+        ch.updateNSection(waveform.end - waveform.begin);
+        ch.updateRepeat(mRepeat);
+        return ch;
+    }
+
+    DspMemChunk ch(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE, pool);
+    int nsections = waveform.end - waveform.begin;
+    if (waveform.begin > 0) {
+        PwleSection start = mPwle[waveform.begin - 1];
+        start.delay = 0;
+        start.flags &= ~PWLE_CHIRP_BIT;
+        ch.constructPwleSection(start);
+        nsections++;
+    }
+    for (size_t s = waveform.begin; s < waveform.end; s++) {
+        ch.constructPwleSection(mPwle[s]);
+    }
+    ch.flush();
+    ch.updateWLength(waveform.durationMs + MAX_COLD_START_LATENCY_MS);
+    ch.updateNSection(nsections);
+    return ch;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
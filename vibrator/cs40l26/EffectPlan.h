@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ChunkPool.h"
+#include "DspMemChunk.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr int8_t MAX_COLD_START_LATENCY_MS = 6;  // I2C Transaction + DSP Return-From-Standby
+static constexpr int8_t MAX_PAUSE_TIMING_ERROR_MS = 1;  // ALERT Irq Handling
+
+// What an effect plays once its input has been validated: a physical effect,
+// a waveform encoded ahead of time, or the compose or PWLE sections of the
+// OWT waveforms to play back to back, along with how long all of it plays.
+//
+// Setting the sections folds and splits them into waveforms, checking they
+// can be encoded, so encoding a plan cannot fail and nothing is encoded for
+// input that is rejected.
+class EffectPlan {
+  public:
+    enum class Kind : uint8_t {
+        NONE,
+        EFFECT,
+        CHUNK,
+        COMPOSE,
+        PWLE,
+    };
+
+    // Plans split compose and PWLE sections into up to 'maxWaveforms' OWT
+    // waveforms, played back to back 'offTimeUs' apart.
+    explicit EffectPlan(size_t maxWaveforms = 1, uint32_t offTimeUs = 0)
+        : mMaxWaveforms(maxWaveforms), mOffTimeUs(offTimeUs) {}
+
+    // Plays physical effect 'effectIndex', lasting 'effectDurationMs', at
+    // 'volLevel'.
+    void setEffect(uint32_t effectIndex, uint32_t volLevel, uint32_t effectDurationMs);
+    // Plays 'ch', lasting 'durationMs'. 'ch' must outlive the plan.
+    void setChunk(const DspMemChunk *ch, uint32_t durationMs);
+    // Plays compose 'sections', the effect at index i lasting
+    // effectDurationsMs[i]. Returns -EINVAL if they do not fit.
+    int setCompose(std::vector<ComposeSection> &&sections,
+                   const std::vector<uint32_t> &effectDurationsMs);
+    // Plays PWLE 'sections'. Returns -EINVAL if they do not fit or one
+    // waveform would be too long for the DSP.
+    int setPwle(std::vector<PwleSection> &&sections);
+
+    Kind kind() const { return mKind; }
+    uint32_t effectIndex() const { return mEffectIndex; }
+    uint32_t volLevel() const { return mVolLevel; }
+    const DspMemChunk *chunk() const { return mChunk; }
+    // OWT waveforms to encode, for COMPOSE and PWLE.
+    size_t waveforms() const { return mWaveforms.size(); }
+    // Sections in all OWT waveforms.
+    size_t sections() const;
+    // Expected time from triggering the effect until it stops, covering the
+    // DSP waking up, pauses overrunning and the off time between waveforms.
+    uint32_t durationMs() const { return mDurationMs; }
+
+    // Encodes OWT waveform 'i' into a buffer from 'pool'.
+    DspMemChunk encode(size_t i, ChunkPool *pool) const;
+
+  private:
+    // Sections [begin, end) played as one OWT waveform.
+    struct Waveform {
+        size_t begin;
+        size_t end;
+        uint32_t durationMs;  // Of playing the sections, excluding the DSP waking up
+    };
+
+    void reset();
+    int finish();
+
+    const size_t mMaxWaveforms;
+    const uint32_t mOffTimeUs;
+    Kind mKind{Kind::NONE};
+    uint32_t mEffectIndex{0};
+    uint32_t mVolLevel{0};
+    const DspMemChunk *mChunk{nullptr};
+    std::vector<ComposeSection> mCompose;
+    std::vector<PwleSection> mPwle;
+    // Whole compose waveform repeats, valid when there is exactly one.
+    uint8_t mRepeat{0};
+    std::vector<Waveform> mWaveforms;
+    uint32_t mDurationMs{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
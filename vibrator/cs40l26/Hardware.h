@@ -65,7 +65,7 @@ namespace android {
 namespace hardware {
 namespace vibrator {
 
-class HwApi : public Vibrator::HwApi, private HwApiBase {
+class HwApi : public Vibrator::HwApi, protected HwApiBase {
   public:
     static std::unique_ptr<HwApi> Create() {
         auto hwapi = std::unique_ptr<HwApi>(new HwApi());
@@ -82,6 +82,9 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         open("default/f0_comp_enable", &mF0CompEnable);
         open("default/redc_comp_enable", &mRedcCompEnable);
         open("default/delay_before_stop_playback_us", &mMinOnOffInterval);
+        mSetFFEffectLatency = histogram("ioctl setFFEffect");
+        mUploadOwtEffectLatency = histogram("ioctl uploadOwtEffect");
+        mEraseOwtEffectLatency = histogram("ioctl eraseOwtEffect");
     }
 
     bool setF0(std::string value) override { return set(value, &mF0); }
@@ -89,9 +92,11 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
     bool setRedc(std::string value) override { return set(value, &mRedc); }
     bool setQ(std::string value) override { return set(value, &mQ); }
     bool getEffectCount(uint32_t *value) override { return get(value, &mEffectCount); }
-    bool pollVibeState(uint32_t value, int32_t timeoutMs) override {
-        return poll(value, &mVibeState, timeoutMs);
+    bool pollVibeState(uint32_t value, int32_t timeoutMs,
+                       const std::function<bool()> &cancel) override {
+        return poll(value, &mVibeState, timeoutMs, cancel);
     }
+    void wakePolls() override { HwApiBase::wakePolls(); }
     bool hasOwtFreeSpace() override { return has(mOwtFreeSpace); }
     bool getOwtFreeSpace(uint32_t *value) override { return get(value, &mOwtFreeSpace); }
     bool setF0CompEnable(bool value) override { return set(value, &mF0CompEnable); }
@@ -108,16 +113,14 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
             ALOGE("Invalid gain");
             return false;
         }
-        if (write(fd, (const void *)&gain, sizeof(gain)) != sizeof(gain)) {
-            return false;
-        }
-        return true;
+        return writeEvent(fd, gain);
     }
     bool setFFEffect(int fd, struct ff_effect *effect, uint16_t timeoutMs) override {
         if (effect == nullptr) {
             ALOGE("Invalid ff_effect");
             return false;
         }
+        Histogram::Timer timer{mSetFFEffectLatency};
         if (ioctl(fd, EVIOCSFF, effect) < 0) {
             ALOGE("setFFEffect fail");
             return false;
@@ -130,11 +133,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
                 .code = static_cast<uint16_t>(index),
                 .value = value,
         };
-        if (write(fd, (const void *)&play, sizeof(play)) != sizeof(play)) {
-            return false;
-        } else {
-            return true;
-        }
+        return writeEvent(fd, play);
     }
     bool getHapticAlsaDevice(int *card, int *device) override {
         std::string line;
@@ -203,8 +202,11 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
             return false;
         }
 
+        // The kernel copies the waveform in during EVIOCSFF; hand it the
+        // caller's buffer rather than copying it into the template first.
         (*effect).u.periodic.custom_len = numBytes / sizeof(uint16_t);
-        memcpy((*effect).u.periodic.custom_data, owtData, numBytes);
+        (*effect).u.periodic.custom_data =
+                reinterpret_cast<int16_t *>(const_cast<uint8_t *>(owtData));
 
         if ((*effect).id != -1) {
             ALOGE("(*effect).id != -1");
@@ -212,7 +214,10 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
 
         /* Create a new OWT waveform to update the PWLE or composite effect. */
         (*effect).id = -1;
-        if (ioctl(fd, EVIOCSFF, effect) < 0) {
+        Histogram::Timer timer{mUploadOwtEffectLatency};
+        int ret = ioctl(fd, EVIOCSFF, effect);
+        (*effect).u.periodic.custom_data = nullptr;
+        if (ret < 0) {
             ALOGE("Failed to upload effect %d (%d): %s", *outEffectIndex, errno, strerror(errno));
             *status = EX_ILLEGAL_STATE;
             return false;
@@ -228,9 +233,9 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         return true;
     }
     bool eraseOwtEffect(int fd, int8_t effectIndex, std::vector<ff_effect> *effect) override {
-        uint32_t effectCountBefore, effectCountAfter, i, successFlush = 0;
+        uint32_t i;
 
-        if (effectIndex < WAVEFORM_MAX_PHYSICAL_INDEX) {
+        if (effectIndex < WAVEFORM_MAX_PHYSICAL_INDEX || effectIndex >= FF_MAX_EFFECTS) {
             ALOGE("Invalid waveform index for OWT erase: %d", effectIndex);
             return false;
         }
@@ -241,34 +246,50 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         // Turn off the waiting time for SVC init phase to complete since chip
         // should already under STOP state
         setMinOnOffInterval(0);
-        // Do erase flow
-        if (effectIndex < WAVEFORM_MAX_INDEX) {
-            /* Normal situation. Only erase the effect which we just played. */
+        {
+            /* Only erase the effect given; others may still be resident. */
+            Histogram::Timer timer{mEraseOwtEffectLatency};
             if (ioctl(fd, EVIOCRMFF, effectIndex) < 0) {
                 ALOGE("Failed to erase effect %d (%d): %s", effectIndex, errno, strerror(errno));
             }
-            for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < WAVEFORM_MAX_INDEX; i++) {
-                if ((*effect)[i].id == effectIndex) {
-                    (*effect)[i].id = -1;
-                    break;
-                }
-            }
-        } else {
-            /* Flush all non-prestored effects of ff-core and driver. */
-            getEffectCount(&effectCountBefore);
-            for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < FF_MAX_EFFECTS; i++) {
-                if (ioctl(fd, EVIOCRMFF, i) >= 0) {
-                    successFlush++;
-                }
-            }
-            getEffectCount(&effectCountAfter);
-            ALOGW("Flushed effects: ff: %d; driver: %d -> %d; success: %d", effectIndex,
-                  effectCountBefore, effectCountAfter, successFlush);
-            /* Reset all OWT effect index of HAL. */
-            for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < WAVEFORM_MAX_INDEX; i++) {
+        }
+        for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < WAVEFORM_MAX_INDEX; i++) {
+            if ((*effect)[i].id == effectIndex) {
                 (*effect)[i].id = -1;
+                break;
+            }
+        }
+        // Turn on the waiting time for SVC init phase to complete
+        setMinOnOffInterval(Vibrator::MIN_ON_OFF_INTERVAL_US);
+        return true;
+    }
+    bool flushOwtEffects(int fd, std::vector<ff_effect> *effect) override {
+        uint32_t effectCountBefore, effectCountAfter, i, successFlush = 0;
+
+        if (effect == nullptr || (*effect).empty()) {
+            ALOGE("Invalid argument effect");
+            return false;
+        }
+        // Turn off the waiting time for SVC init phase to complete since chip
+        // should already under STOP state
+        setMinOnOffInterval(0);
+        /* Flush all non-prestored effects of ff-core and driver. */
+        getEffectCount(&effectCountBefore);
+        for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < FF_MAX_EFFECTS; i++) {
+            Histogram::Timer timer{mEraseOwtEffectLatency};
+            if (ioctl(fd, EVIOCRMFF, i) >= 0) {
+                successFlush++;
             }
         }
+        getEffectCount(&effectCountAfter);
+        ALOGW("Flushed effects: driver: %d -> %d; success: %d", effectCountBefore,
+              effectCountAfter, successFlush);
+        /* Reset all OWT effect index of HAL. */
+        for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < WAVEFORM_MAX_INDEX; i++) {
+            (*effect)[i].id = -1;
+        }
+        /* The driver state can no longer be trusted to match our writes. */
+        invalidate();
         // Turn on the waiting time for SVC init phase to complete
         setMinOnOffInterval(Vibrator::MIN_ON_OFF_INTERVAL_US);
         return true;
@@ -276,17 +297,70 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
 
     void debug(int fd) override { HwApiBase::debug(fd); }
 
+  protected:
+    virtual bool writeEvent(int fd, const struct input_event &event) {
+        return write(fd, (const void *)&event, sizeof(event)) == sizeof(event);
+    }
+
   private:
-    std::ofstream mF0;
-    std::ofstream mF0Offset;
-    std::ofstream mRedc;
-    std::ofstream mQ;
-    std::ifstream mEffectCount;
-    std::ifstream mVibeState;
-    std::ifstream mOwtFreeSpace;
-    std::ofstream mF0CompEnable;
-    std::ofstream mRedcCompEnable;
-    std::ofstream mMinOnOffInterval;
+    Attribute mF0{O_WRONLY};
+    Attribute mF0Offset{O_WRONLY};
+    Attribute mRedc{O_WRONLY};
+    Attribute mQ{O_WRONLY};
+    Attribute mEffectCount{O_RDONLY};
+    Attribute mVibeState{O_RDONLY};
+    Attribute mOwtFreeSpace{O_RDONLY};
+    Attribute mF0CompEnable{O_WRONLY};
+    Attribute mRedcCompEnable{O_WRONLY};
+    Attribute mMinOnOffInterval{O_WRONLY};
+    Histogram *mSetFFEffectLatency;
+    Histogram *mUploadOwtEffectLatency;
+    Histogram *mEraseOwtEffectLatency;
+};
+
+// HwApi sending the accesses of a batch through the io_uring shared by all
+// actuators, so the kernel can carry them out concurrently.
+class HwApiUring : public HwApi {
+  public:
+    static std::unique_ptr<HwApiUring> Create() {
+        auto *uring = UringBatch::Get();
+        if (uring == nullptr) {
+            return nullptr;
+        }
+        return std::unique_ptr<HwApiUring>(new HwApiUring(uring));
+    }
+
+    void beginBatch() override { mUring->begin(); }
+    bool submitBatch() override { return mUring->submit(); }
+
+  protected:
+    bool writeEvent(int fd, const struct input_event &event) override {
+        auto *op = mUring->queue();
+        if (op == nullptr) {
+            return HwApi::writeEvent(fd, event);
+        }
+        op->fd = fd;
+        op->write = true;
+        op->offset = -1;
+        op->len = sizeof(event);
+        memcpy(op->buffer, &event, sizeof(event));
+        op->done = &HwApiUring::completeEvent;
+        return true;
+    }
+
+  private:
+    explicit HwApiUring(UringBatch *uring) : mUring(uring) { setBatch(uring); }
+
+    static bool completeEvent(UringBatch::Op &op, int32_t result) {
+        if (result != static_cast<int32_t>(op.len)) {
+            int err = result < 0 ? -result : EIO;
+            ALOGE("Failed to write event to %d (%d): %s", op.fd, err, strerror(err));
+            return false;
+        }
+        return true;
+    }
+
+    UringBatch *mUring;
 };
 
 class HwCal : public Vibrator::HwCal, private HwCalBase {
@@ -387,6 +461,11 @@ class HwCal : public Vibrator::HwCal, private HwCalBase {
         getProperty("redc.comp.enabled", &value, false);
         return value;
     }
+    bool isPreemptionEnabled() override {
+        bool value;
+        getProperty("preemption.enabled", &value, false);
+        return value;
+    }
     void debug(int fd) override { HwCalBase::debug(fd); }
 };
 
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LraModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+bool LraModel::isValid() const {
+    return std::isfinite(mF0Hz) && std::isfinite(mQ) && mF0Hz > 0 && mQ > 0;
+}
+
+float LraModel::acceleration(float frequencyHz) const {
+    // |H(f)| = r^2 / sqrt((1 - r^2)^2 + (r / Q)^2), r = f / f0
+    const double r = frequencyHz / mF0Hz;
+    const double r2 = r * r;
+    const double spring = 1 - r2;
+    const double damping = r / mQ;
+
+    return r2 / std::sqrt(spring * spring + damping * damping);
+}
+
+std::vector<float> LraModel::bandwidthAmplitudeMap(float minimumHz, float resolutionHz,
+                                                   size_t size) const {
+    std::vector<float> map(size);
+    float peak = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        map[i] = acceleration(minimumHz + i * resolutionHz);
+        peak = std::max(peak, map[i]);
+    }
+    if (peak > 0) {
+        for (auto &amplitude : map) {
+            amplitude = std::clamp(amplitude / peak, 0.0f, 1.0f);
+        }
+    }
+    return map;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Second order model of an LRA, a mass on a spring driven by the coil, from
+// its calibrated resonant frequency and Q factor.
+class LraModel {
+  public:
+    LraModel(float f0Hz, float q) : mF0Hz(f0Hz), mQ(q) {}
+
+    // Whether the calibration describes an actuator the model can stand for.
+    bool isValid() const;
+    // Acceleration at 'frequencyHz' for the force that accelerates the mass
+    // by 1 well above f0.
+    float acceleration(float frequencyHz) const;
+    // Acceleration at 'size' frequencies, 'resolutionHz' apart from
+    // 'minimumHz', relative to the highest of them.
+    std::vector<float> bandwidthAmplitudeMap(float minimumHz, float resolutionHz,
+                                             size_t size) const;
+
+  private:
+    const float mF0Hz;
+    const float mQ;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "OwtSlots.h"
+
+#include <algorithm>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// FNV-1a
+static constexpr uint64_t HASH_OFFSET = 0xcbf29ce484222325;
+static constexpr uint64_t HASH_PRIME = 0x100000001b3;
+
+OwtSlots::OwtSlots(size_t maxSlots, size_t maxBytes)
+    : mMaxSlots(maxSlots), mMaxBytes(maxBytes), mStorage(new char[maxSlots * maxBytes]) {
+    mFree.reserve(mMaxSlots);
+    for (size_t i = mMaxSlots; i > 0; i--) {
+        mFree.push_back(mStorage.get() + (i - 1) * mMaxBytes);
+    }
+    mSlots.reserve(mMaxSlots);
+}
+
+uint64_t OwtSlots::hash(std::string_view waveform) {
+    uint64_t hash = HASH_OFFSET;
+
+    for (uint8_t byte : waveform) {
+        hash = (hash ^ byte) * HASH_PRIME;
+    }
+    return hash;
+}
+
+std::vector<OwtSlots::Slot>::iterator OwtSlots::lookup(std::string_view waveform) {
+    const uint64_t key = hash(waveform);
+
+    for (auto slot = mSlots.begin(); slot != mSlots.end(); slot++) {
+        if (slot->hash == key && slot->waveform() == waveform) {
+            return slot;
+        }
+    }
+    return mSlots.end();
+}
+
+int16_t OwtSlots::find(std::string_view waveform) {
+    auto slot = lookup(waveform);
+
+    if (slot == mSlots.end()) {
+        mMisses++;
+        return -1;
+    }
+    mHits++;
+    slot->lastUse = ++mUses;
+    return slot->id;
+}
+
+void OwtSlots::insert(std::string_view waveform, int16_t id) {
+    if (lookup(waveform) != mSlots.end() || full() || waveform.size() > mMaxBytes) {
+        return;
+    }
+    char *buffer = mFree.back();
+    mFree.pop_back();
+    std::copy(waveform.begin(), waveform.end(), buffer);
+    const uint64_t use = ++mUses;
+    mSlots.push_back({hash(waveform), buffer, waveform.size(), id, use, use, 0});
+    mBytes += waveform.size();
+}
+
+int16_t OwtSlots::evict(int16_t keep) {
+    auto victim = mSlots.end();
+
+    for (auto slot = mSlots.begin(); slot != mSlots.end(); slot++) {
+        if (slot->id != keep && !slot->pins &&
+            (victim == mSlots.end() || slot->lastUse < victim->lastUse)) {
+            victim = slot;
+        }
+    }
+    if (victim == mSlots.end()) {
+        return -1;
+    }
+    int16_t id = victim->id;
+    remove(victim);
+    mEvictions++;
+    return id;
+}
+
+uint64_t OwtSlots::pin(std::string_view waveform) {
+    auto slot = lookup(waveform);
+
+    if (slot == mSlots.end()) {
+        return 0;
+    }
+    slot->pins++;
+    return slot->serial;
+}
+
+void OwtSlots::unpin(uint64_t pin) {
+    for (auto &slot : mSlots) {
+        if (slot.serial == pin) {
+            if (slot.pins) {
+                slot.pins--;
+            }
+            return;
+        }
+    }
+}
+
+void OwtSlots::erase(int16_t id) {
+    for (auto slot = mSlots.begin(); slot != mSlots.end(); slot++) {
+        if (slot->id == id) {
+            remove(slot);
+            return;
+        }
+    }
+}
+
+void OwtSlots::clear() {
+    while (!mSlots.empty()) {
+        remove(mSlots.begin());
+    }
+}
+
+std::string_view OwtSlots::waveform(int16_t id) const {
+    for (auto &slot : mSlots) {
+        if (slot.id == id) {
+            return slot.waveform();
+        }
+    }
+    return {};
+}
+
+void OwtSlots::remove(std::vector<Slot>::iterator slot) {
+    mBytes -= slot->bytes;
+    mFree.push_back(slot->buffer);
+    *slot = mSlots.back();
+    mSlots.pop_back();
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
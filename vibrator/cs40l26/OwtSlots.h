@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Bookkeeping of the OWT waveforms left on the chip after playback, so that a
+// waveform played again is triggered by its effect id instead of being
+// uploaded and erased every time.
+//
+// Waveforms are identified by their encoded bytes, kept in one buffer of
+// 'maxBytes' per slot allocated up front; a hash of them only narrows down
+// the slots to compare. Waveforms longer than 'maxBytes' are not kept. At most
+// 'maxSlots' are resident; the caller also evicts, least recently used first,
+// while a new waveform does not fit in the chip's free OWT space. The slots
+// are scanned, there being no more than a few dozen. Not thread-safe.
+class OwtSlots {
+  public:
+    OwtSlots(size_t maxSlots, size_t maxBytes);
+
+    // Returns the effect id holding 'waveform', now the most recently used, or
+    // -1 if it is not resident.
+    int16_t find(std::string_view waveform);
+    // Records that effect 'id' now holds 'waveform'.
+    void insert(std::string_view waveform, int16_t id);
+    // Forgets the least recently used waveform other than effect 'keep', or
+    // one pinned, and returns its effect id, for the caller to erase; -1 if
+    // there is none.
+    int16_t evict(int16_t keep = -1);
+    // Keeps 'waveform' from being evicted until unpin() is given the pin
+    // returned, 0 if it is not resident. Pins nest. erase() and clear() still
+    // forget a pinned waveform, leaving its pins to do nothing.
+    uint64_t pin(std::string_view waveform);
+    void unpin(uint64_t pin);
+    // Forgets the waveform held by effect 'id', for the caller to erase. Does
+    // not count as an eviction.
+    void erase(int16_t id);
+    // Forgets every waveform, e.g. once the driver no longer holds them.
+    void clear();
+    // Returns the waveform held by effect 'id', empty if none. Does not
+    // count as a use.
+    std::string_view waveform(int16_t id) const;
+
+    // Whether a waveform must be evicted before another can be inserted.
+    bool full() const { return mSlots.size() >= mMaxSlots; }
+    size_t size() const { return mSlots.size(); }
+    size_t bytes() const { return mBytes; }
+    uint64_t hits() const { return mHits; }
+    uint64_t misses() const { return mMisses; }
+    uint64_t evictions() const { return mEvictions; }
+
+  private:
+    struct Slot {
+        uint64_t hash;
+        char *buffer;
+        size_t bytes;
+        int16_t id;
+        uint64_t lastUse;
+        uint64_t serial;  // Of its insertion, telling its pins apart from earlier ones
+        uint32_t pins;
+
+        std::string_view waveform() const { return {buffer, bytes}; }
+    };
+
+    static uint64_t hash(std::string_view waveform);
+    std::vector<Slot>::iterator lookup(std::string_view waveform);
+    void remove(std::vector<Slot>::iterator slot);
+
+    const size_t mMaxSlots;
+    const size_t mMaxBytes;
+    std::unique_ptr<char[]> mStorage;
+    std::vector<char *> mFree;  // buffers not holding a waveform
+    std::vector<Slot> mSlots;   // in no particular order
+    uint64_t mUses{0};
+    size_t mBytes{0};
+    uint64_t mHits{0};
+    uint64_t mMisses{0};
+    uint64_t mEvictions{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PlaybackState.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+PlaybackState::PlaybackState()
+    : mState(pack({Phase::IDLE, -1, 0})), mSinceNs(Histogram::now()) {}
+
+const char *PlaybackState::name(Phase phase) {
+    switch (phase) {
+        case Phase::IDLE:
+            return "idle";
+        case Phase::UPLOADING:
+            return "uploading";
+        case Phase::ARMED:
+            return "armed";
+        case Phase::PLAYING:
+            return "playing";
+        case Phase::STOPPING:
+            return "stopping";
+        case Phase::CLEANUP:
+            return "cleanup";
+        default:
+            return "unknown";
+    }
+}
+
+bool PlaybackState::transition(State *state, Phase phase) {
+    return transition(state, phase, state->effectIndex, state->playback);
+}
+
+bool PlaybackState::transition(State *state, Phase phase, int16_t effectIndex,
+                               uint32_t playback) {
+    uint64_t expected = pack(*state);
+    const State next{phase, effectIndex, playback};
+
+    if (!mState.compare_exchange_strong(expected, pack(next))) {
+        *state = unpack(expected);
+        return false;
+    }
+    const int64_t nowNs = Histogram::now();
+    mDuration[static_cast<size_t>(state->phase)].record(nowNs - mSinceNs.exchange(nowNs));
+    *state = next;
+
+    // Taking the lock orders this against waiters between checking the
+    // state and going to sleep.
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+    }
+    mCondition.notify_all();
+    return true;
+}
+
+bool PlaybackState::waitFor(const std::function<bool(const State &)> &pred,
+                            std::chrono::milliseconds timeout, State *state) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mCondition.wait_for(lock, timeout, [&] {
+        *state = load();
+        return pred(*state);
+    });
+}
+
+uint64_t PlaybackState::pack(const State &state) {
+    return uint64_t{state.playback} << 32 |
+           uint64_t{static_cast<uint16_t>(state.effectIndex)} << 8 |
+           static_cast<uint8_t>(state.phase);
+}
+
+PlaybackState::State PlaybackState::unpack(uint64_t word) {
+    return {static_cast<Phase>(word & 0xFF), static_cast<int16_t>(word >> 8 & 0xFFFF),
+            static_cast<uint32_t>(word >> 32)};
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "Histogram.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Where the actuators are in playing an effect. The phase, the effect and
+// the playback it belongs to share one atomic word, moved along by
+// compare-and-swap, so that it can be read, and acted on, without waiting
+// for the ioctls of whoever moved it last. Whoever moves it into a phase
+// owns that phase until moving it out; others may only cancel, moving it to
+// IDLE, which the owner finds when its next transition fails.
+//
+// The time spent in each phase is recorded, from right after the transition
+// into it to right after the one out of it. Thread-safe.
+class PlaybackState {
+  public:
+    enum class Phase : uint8_t {
+        IDLE,       // nothing is playing
+        UPLOADING,  // on() claimed the actuators and is uploading the effect
+        ARMED,      // the effect is being triggered
+        PLAYING,    // the effect was triggered and is followed to completion
+        STOPPING,   // off(), or the next effect, is stopping it
+        CLEANUP,    // its completion is cleaning up after it
+        COUNT,
+    };
+
+    struct State {
+        Phase phase;
+        int16_t effectIndex;  // -1 until ARMED
+        uint32_t playback;    // bumped by each new effect claiming the actuators
+    };
+
+    PlaybackState();
+
+    static const char *name(Phase phase);
+
+    State load() const { return unpack(mState.load()); }
+    // When the current phase was entered, on the Histogram::now() clock.
+    int64_t sinceNs() const { return mSinceNs.load(); }
+    // Moves from '*state' to 'phase', keeping the effect and playback, unless
+    // it moved since '*state' was read. Either way, '*state' is updated to
+    // the current state.
+    bool transition(State *state, Phase phase);
+    bool transition(State *state, Phase phase, int16_t effectIndex, uint32_t playback);
+    // Waits up to 'timeout' for the state to satisfy 'pred', storing the last
+    // state read in '*state'. Returns whether it did.
+    bool waitFor(const std::function<bool(const State &)> &pred,
+                 std::chrono::milliseconds timeout, State *state);
+    // Time spent in 'phase'.
+    const Histogram &duration(Phase phase) const {
+        return mDuration[static_cast<size_t>(phase)];
+    }
+
+  private:
+    static uint64_t pack(const State &state);
+    static State unpack(uint64_t word);
+
+    std::atomic<uint64_t> mState;
+    std::atomic<int64_t> mSinceNs;
+    std::array<Histogram, static_cast<size_t>(Phase::COUNT)> mDuration;
+    // Only held to wait for, and to announce, transitions.
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TimelineScheduler.h"
+
+#include <log/log.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr int64_t NS_PER_S = 1000000000;
+
+TimelineScheduler::TimelineScheduler()
+    : mTimerFd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)),
+      mThread(&TimelineScheduler::run, this) {
+    if (mTimerFd < 0) {
+        ALOGE("Failed to create timeline timer (%d): %s", errno, strerror(errno));
+    }
+}
+
+TimelineScheduler::~TimelineScheduler() {
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mStopping = true;
+        // wake the thread up now
+        arm(1);
+    }
+    mThread.join();
+}
+
+int TimelineScheduler::schedule(std::vector<Entry> &&entries) {
+    // Destroyed once unlocked, as whatever the dropped entries captured may
+    // take a while to let go.
+    std::deque<Entry> dropped(std::make_move_iterator(entries.begin()),
+                              std::make_move_iterator(entries.end()));
+    const std::scoped_lock<std::mutex> lock(mMutex);
+
+    // Arm first, so that entries the timer cannot be armed for never queue up
+    // to fire on a later arm.
+    int ret = arm(dropped.empty() ? 0 : std::max<int64_t>(dropped.front().startNs, 1));
+    if (ret == 0) {
+        mEntries.swap(dropped);
+    }
+    return ret;
+}
+
+size_t TimelineScheduler::pending() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+int TimelineScheduler::arm(int64_t startNs) {
+    const itimerspec spec{
+            .it_value = {.tv_sec = startNs / NS_PER_S, .tv_nsec = startNs % NS_PER_S}};
+
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        ALOGE("Failed to arm timeline timer (%d): %s", errno, strerror(errno));
+        return -errno;
+    }
+    return 0;
+}
+
+void TimelineScheduler::run() {
+    if (mTimerFd < 0) {
+        return;
+    }
+    for (;;) {
+        uint64_t expirations;
+        if (TEMP_FAILURE_RETRY(read(mTimerFd, &expirations, sizeof(expirations))) < 0) {
+            ALOGE("Failed to wait for timeline timer (%d): %s", errno, strerror(errno));
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mStopping) {
+            return;
+        }
+        // schedule() may have replaced the entries since the timer fired.
+        int64_t nowNs = Histogram::now();
+        while (!mStopping && !mEntries.empty() && mEntries.front().startNs <= nowNs) {
+            {
+                Entry entry = std::move(mEntries.front());
+                mEntries.pop_front();
+                mError.record(nowNs - entry.startNs);
+                lock.unlock();
+                ATRACE_NAME("TimelineScheduler::fire");
+                entry.fire();
+            }
+            lock.lock();
+            nowNs = Histogram::now();
+        }
+        if (!mStopping && !mEntries.empty()) {
+            arm(mEntries.front().startNs);
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
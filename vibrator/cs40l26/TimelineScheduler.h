@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Histogram.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Thread firing entries at their CLOCK_MONOTONIC start time, woken by a
+// timerfd armed for the earliest one. Entries already due fire right away.
+//
+// How late each entry fires is recorded in error(). Thread-safe.
+class TimelineScheduler {
+  public:
+    struct Entry {
+        int64_t startNs;
+        std::function<void()> fire;
+    };
+
+    TimelineScheduler();
+    ~TimelineScheduler();
+
+    // Replaces the entries still queued with 'entries', which must be sorted
+    // by start time. Returns -errno if the timer cannot be armed, leaving the
+    // queued entries as they were and dropping 'entries'.
+    int schedule(std::vector<Entry> &&entries);
+    // Drops the entries still queued.
+    int cancel() { return schedule({}); }
+    size_t pending() const;
+    // Time from the start of each entry fired to firing it.
+    const Histogram &error() const { return mError; }
+
+  private:
+    void run();
+    // Arms the timer to fire at 'startNs', right away if that is past, or
+    // disarms it if 0. Must hold mMutex.
+    int arm(int64_t startNs);
+
+    const ::android::base::unique_fd mTimerFd;
+    mutable std::mutex mMutex;  // protects mEntries and mStopping
+    std::deque<Entry> mEntries;
+    bool mStopping{false};
+    Histogram mError;
+    // Declared last, so it starts once everything it uses is constructed.
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
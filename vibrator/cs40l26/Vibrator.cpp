@@ -16,7 +16,6 @@
 
 #include "Vibrator.h"
 
-#include <glob.h>
 #include <hardware/hardware.h>
 #include <hardware/vibrator.h>
 #include <log/log.h>
@@ -26,11 +25,17 @@
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
-#include <optional>
 #include <sstream>
 
+#include "DspMemChunk.h"
+#include "EffectPlan.h"
+#include "Histogram.h"
+#include "InputDiscovery.h"
+#include "LraModel.h"
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(x) (sizeof((x)) / sizeof((x)[0]))
 #endif
@@ -44,26 +49,64 @@ namespace aidl {
 namespace android {
 namespace hardware {
 namespace vibrator {
-static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_COMP = 2044;  // (COMPOSE_SIZE_MAX + 1) * 8 + 4
-static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_PWLE = 2302;
 
 static constexpr uint32_t WAVEFORM_DOUBLE_CLICK_SILENCE_MS = 100;
 
+// Effect::DOUBLE_CLICK: a click, then a heavy click of the same waveform.
+static constexpr ComposeImage<2> DOUBLE_CLICK_IMAGE({
+        {WAVEFORM_CLICK_INDEX, static_cast<uint16_t>(WAVEFORM_DOUBLE_CLICK_SILENCE_MS)},
+        {WAVEFORM_CLICK_INDEX, 0},
+});
+static_assert(DOUBLE_CLICK_IMAGE.SIZE == 20);
+static_assert(DOUBLE_CLICK_IMAGE[DOUBLE_CLICK_IMAGE.NSECTIONS_OFFSET] == 2);
+static_assert(DOUBLE_CLICK_IMAGE[DOUBLE_CLICK_IMAGE.volLevelOffset(0) + 1] ==
+                      WAVEFORM_CLICK_INDEX &&
+              DOUBLE_CLICK_IMAGE[DOUBLE_CLICK_IMAGE.volLevelOffset(1) + 1] ==
+                      WAVEFORM_CLICK_INDEX);
+static_assert(DOUBLE_CLICK_IMAGE[10] == (WAVEFORM_DOUBLE_CLICK_SILENCE_MS >> 8) &&
+              DOUBLE_CLICK_IMAGE[11] == (WAVEFORM_DOUBLE_CLICK_SILENCE_MS & 0xFF));
+
 static constexpr uint32_t WAVEFORM_LONG_VIBRATION_THRESHOLD_MS = 50;
 
 static constexpr uint8_t VOLTAGE_SCALE_MAX = 100;
 
-static constexpr int8_t MAX_COLD_START_LATENCY_MS = 6;  // I2C Transaction + DSP Return-From-Standby
-static constexpr int8_t MAX_PAUSE_TIMING_ERROR_MS = 1;  // ALERT Irq Handling
 static constexpr uint32_t MAX_TIME_MS = UINT16_MAX;
 
 static constexpr auto ASYNC_COMPLETION_TIMEOUT = std::chrono::milliseconds(100);
 static constexpr auto POLLING_TIMEOUT = 20;
+// Failed reads of the state tolerated while waiting for an effect to stop.
+static constexpr int POLLING_RETRIES_MAX = 3;
+// Upper bound on waiting for an effect stopped, or preempted, to wind down
+// before erasing another, and so on what evicting adds to preempting.
+static constexpr int32_t STOP_TIMEOUT_MS = 20;
+// Upper bound on waiting for the drivers to register their input devices.
+static constexpr auto INPUT_DISCOVERY_TIMEOUT = std::chrono::seconds(10);
+// Upper bound on binder calls waiting for init(), covering input discovery.
+static constexpr auto READY_TIMEOUT = std::chrono::milliseconds(15000);
 static constexpr int32_t COMPOSE_DELAY_MAX_MS = 10000;
 
-/* nsections is 8 bits. Need to preserve 1 section for the first delay before the first effect. */
-static constexpr int32_t COMPOSE_SIZE_MAX = 254;
-static constexpr int32_t COMPOSE_PWLE_SIZE_MAX_DEFAULT = 127;
+// Compositions longer than one OWT waveform holds are split into up to this
+// many, played back to back.
+static constexpr size_t OWT_STREAM_SEGMENTS_MAX = 8;
+static constexpr int32_t COMPOSE_STREAM_SIZE_MAX = COMPOSE_SIZE_MAX * OWT_STREAM_SEGMENTS_MAX;
+// Every PWLE primitive takes one or two sections, so each waveform holds at
+// least COMPOSE_PWLE_SIZE_MAX_DEFAULT - 1 sections of them.
+static constexpr int32_t COMPOSE_PWLE_STREAM_SIZE_MAX =
+        (COMPOSE_PWLE_SIZE_MAX_DEFAULT - 1) * OWT_STREAM_SEGMENTS_MAX / 2;
+
+// Encoded compositions kept for replay, each taking up to
+// FF_CUSTOM_DATA_LEN_MAX_PWLE bytes.
+static constexpr size_t EFFECT_CACHE_SIZE = 16;
+
+// Effects scheduled at once on the timeline.
+static constexpr size_t TIMELINE_SIZE_MAX = 256;
+
+// Encoding buffers: one per cached waveform, plus those of a streamed
+// composition.
+static constexpr size_t CHUNK_POOL_SIZE = EFFECT_CACHE_SIZE + OWT_STREAM_SEGMENTS_MAX;
+
+// Force feedback slots left for OWT waveforms by the physical ones.
+static constexpr size_t OWT_SLOTS_MAX = FF_MAX_EFFECTS - WAVEFORM_MAX_PHYSICAL_INDEX;
 
 // Measured resonant frequency, f0_measured, is represented by Q10.14 fixed
 // point format on cs40l26 devices. The expression to calculate f0 is:
@@ -77,20 +120,8 @@ static constexpr int32_t Q14_BIT_SHIFT = 14;
 // See the LRA Calibration Support documentation for more details.
 static constexpr int32_t Q16_BIT_SHIFT = 16;
 
-static constexpr int32_t COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS = 16383;
-
-static constexpr uint32_t WT_LEN_CALCD = 0x00800000;
-static constexpr uint8_t PWLE_CHIRP_BIT = 0x8;  // Dynamic/static frequency and voltage
-static constexpr uint8_t PWLE_BRAKE_BIT = 0x4;
-static constexpr uint8_t PWLE_AMP_REG_BIT = 0x2;
-
 static constexpr float PWLE_LEVEL_MIN = 0.0;
 static constexpr float PWLE_LEVEL_MAX = 1.0;
-static constexpr float CS40L26_PWLE_LEVEL_MIN = -1.0;
-static constexpr float CS40L26_PWLE_LEVEL_MAX = 0.9995118;
-static constexpr float PWLE_FREQUENCY_RESOLUTION_HZ = 1.00;
-static constexpr float PWLE_FREQUENCY_MIN_HZ = 1.00;
-static constexpr float PWLE_FREQUENCY_MAX_HZ = 1000.00;
 static constexpr float PWLE_BW_MAP_SIZE =
         1 + ((PWLE_FREQUENCY_MAX_HZ - PWLE_FREQUENCY_MIN_HZ) / PWLE_FREQUENCY_RESOLUTION_HZ);
 
@@ -115,39 +146,42 @@ static uint16_t amplitudeToScale(float amplitude, float maximum) {
     return std::round(ratio);
 }
 
+// Collects the accesses made on both actuators within its scope into one
+// batch, sent by submit() or at the end of the scope.
+class HwApiBatch {
+  public:
+    HwApiBatch(Vibrator::HwApi *def, Vibrator::HwApi *dual) : mDef(def), mDual(dual) {
+        mDef->beginBatch();
+        if (mDual) {
+            mDual->beginBatch();
+        }
+    }
+    ~HwApiBatch() { submit(); }
+
+    bool submit() {
+        if (mPending) {
+            mPending = false;
+            mResult = mDef->submitBatch();
+            if (mDual && !mDual->submitBatch()) {
+                mResult = false;
+            }
+        }
+        return mResult;
+    }
+
+  private:
+    Vibrator::HwApi *mDef;
+    Vibrator::HwApi *mDual;
+    bool mPending{true};
+    bool mResult{true};
+};
+
 enum WaveformBankID : uint8_t {
     RAM_WVFRM_BANK,
     ROM_WVFRM_BANK,
     OWT_WVFRM_BANK,
 };
 
-enum WaveformIndex : uint16_t {
-    /* Physical waveform */
-    WAVEFORM_LONG_VIBRATION_EFFECT_INDEX = 0,
-    WAVEFORM_RESERVED_INDEX_1 = 1,
-    WAVEFORM_CLICK_INDEX = 2,
-    WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX = 3,
-    WAVEFORM_THUD_INDEX = 4,
-    WAVEFORM_SPIN_INDEX = 5,
-    WAVEFORM_QUICK_RISE_INDEX = 6,
-    WAVEFORM_SLOW_RISE_INDEX = 7,
-    WAVEFORM_QUICK_FALL_INDEX = 8,
-    WAVEFORM_LIGHT_TICK_INDEX = 9,
-    WAVEFORM_LOW_TICK_INDEX = 10,
-    WAVEFORM_RESERVED_MFG_1,
-    WAVEFORM_RESERVED_MFG_2,
-    WAVEFORM_RESERVED_MFG_3,
-    WAVEFORM_MAX_PHYSICAL_INDEX,
-    /* OWT waveform */
-    WAVEFORM_COMPOSE = WAVEFORM_MAX_PHYSICAL_INDEX,
-    WAVEFORM_PWLE,
-    /*
-     * Refer to <linux/input.h>, the WAVEFORM_MAX_INDEX must not exceed 96.
-     * #define FF_GAIN		0x60  // 96 in decimal
-     * #define FF_MAX_EFFECTS	FF_GAIN
-     */
-    WAVEFORM_MAX_INDEX,
-};
 
 std::vector<CompositePrimitive> defaultSupportedPrimitives = {
         ndk::enum_range<CompositePrimitive>().begin(), ndk::enum_range<CompositePrimitive>().end()};
@@ -158,211 +192,32 @@ enum vibe_state {
     VIBE_STATE_ASP,
 };
 
-class DspMemChunk {
-  private:
-    std::unique_ptr<uint8_t[]> head;
-    size_t bytes = 0;
-    uint8_t waveformType;
-    uint8_t *_current;
-    const uint8_t *_max;
-    uint32_t _cache = 0;
-    int _cachebits = 0;
-
-    bool isEnd() const { return _current == _max; }
-    int min(int x, int y) { return x < y ? x : y; }
-
-    int write(int nbits, uint32_t val) {
-        int nwrite, i;
-
-        nwrite = min(24 - _cachebits, nbits);
-        _cache <<= nwrite;
-        _cache |= val >> (nbits - nwrite);
-        _cachebits += nwrite;
-        nbits -= nwrite;
-
-        if (_cachebits == 24) {
-            if (isEnd())
-                return -ENOSPC;
-
-            _cache &= 0xFFFFFF;
-            for (i = 0; i < sizeof(_cache); i++, _cache <<= 8)
-                *_current++ = (_cache & 0xFF000000) >> 24;
-
-            bytes += sizeof(_cache);
-            _cachebits = 0;
-        }
-
-        if (nbits)
-            return write(nbits, val);
-
-        return 0;
-    }
-
-   int fToU16(float input, uint16_t *output, float scale, float min, float max) {
-        if (input < min || input > max)
-            return -ERANGE;
-
-        *output = roundf(input * scale);
-        return 0;
-    }
-
-    void constructPwleSegment(uint16_t delay, uint16_t amplitude, uint16_t frequency, uint8_t flags,
-                              uint32_t vbemfTarget = 0) {
-        write(16, delay);
-        write(12, amplitude);
-        write(12, frequency);
-        /* feature flags to control the chirp, CLAB braking, back EMF amplitude regulation */
-        write(8, (flags | 1) << 4);
-        if (flags & PWLE_AMP_REG_BIT) {
-            write(24, vbemfTarget); /* target back EMF voltage */
-        }
+static void dispatchComplete(const std::shared_ptr<IVibratorCallback> &callback) {
+    auto ret = callback->onComplete();
+    if (!ret.isOk()) {
+        ALOGE("Failed completion callback: %d", ret.getExceptionCode());
     }
+}
 
+// Completes the callback of scheduled effects if the last one is dropped
+// before it plays.
+class ScheduledCompletion {
   public:
-    uint8_t *front() const { return head.get(); }
-    uint8_t type() const { return waveformType; }
-    size_t size() const { return bytes; }
-
-    DspMemChunk(uint8_t type, size_t size) : head(new uint8_t[size]{0x00}) {
-        waveformType = type;
-        _current = head.get();
-        _max = _current + size;
-
-        if (waveformType == WAVEFORM_COMPOSE) {
-            write(8, 0); /* Padding */
-            write(8, 0); /* nsections placeholder */
-            write(8, 0); /* repeat */
-        } else if (waveformType == WAVEFORM_PWLE) {
-            write(24, 0); /* Waveform length placeholder */
-            write(8, 0);  /* Repeat */
-            write(12, 0); /* Wait time between repeats */
-            write(8, 0);  /* nsections placeholder */
-        } else {
-            ALOGE("%s: Invalid type: %u", __func__, waveformType);
+    explicit ScheduledCompletion(const std::shared_ptr<IVibratorCallback> &callback)
+        : mCallback(callback) {}
+    ~ScheduledCompletion() {
+        if (mCallback) {
+            dispatchComplete(mCallback);
         }
     }
+    // Hands the callback over to the effect playing.
+    std::shared_ptr<IVibratorCallback> take() { return std::move(mCallback); }
 
-    int flush() {
-        if (!_cachebits)
-            return 0;
-
-        return write(24 - _cachebits, 0);
-    }
-
-    int constructComposeSegment(uint32_t effectVolLevel, uint32_t effectIndex, uint8_t repeat,
-                                uint8_t flags, uint16_t nextEffectDelay) {
-        if (waveformType != WAVEFORM_COMPOSE) {
-            ALOGE("%s: Invalid type: %d", __func__, waveformType);
-            return -EDOM;
-        }
-        if (effectVolLevel > 100 || effectIndex > WAVEFORM_MAX_PHYSICAL_INDEX) {
-            ALOGE("%s: Invalid argument: %u, %u", __func__, effectVolLevel, effectIndex);
-            return -EINVAL;
-        }
-        write(8, effectVolLevel);   /* amplitude */
-        write(8, effectIndex);      /* index */
-        write(8, repeat);           /* repeat */
-        write(8, flags);            /* flags */
-        write(16, nextEffectDelay); /* delay */
-        return 0;
-    }
-
-    int constructActiveSegment(int duration, float amplitude, float frequency, bool chirp) {
-        uint16_t delay = 0;
-        uint16_t amp = 0;
-        uint16_t freq = 0;
-        uint8_t flags = 0x0;
-        if (waveformType != WAVEFORM_PWLE) {
-            ALOGE("%s: Invalid type: %d", __func__, waveformType);
-            return -EDOM;
-        }
-        if ((fToU16(duration, &delay, 4, 0.0f, COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) < 0) ||
-            (fToU16(amplitude, &amp, 2048, CS40L26_PWLE_LEVEL_MIN, CS40L26_PWLE_LEVEL_MAX) < 0) ||
-            (fToU16(frequency, &freq, 4, PWLE_FREQUENCY_MIN_HZ, PWLE_FREQUENCY_MAX_HZ) < 0)) {
-            ALOGE("%s: Invalid argument: %d, %f, %f", __func__, duration, amplitude, frequency);
-            return -ERANGE;
-        }
-        if (chirp) {
-            flags |= PWLE_CHIRP_BIT;
-        }
-        constructPwleSegment(delay, amp, freq, flags, 0 /*ignored*/);
-        return 0;
-    }
-
-    int constructBrakingSegment(int duration, Braking brakingType) {
-        uint16_t delay = 0;
-        uint16_t freq = 0;
-        uint8_t flags = 0x00;
-        if (waveformType != WAVEFORM_PWLE) {
-            ALOGE("%s: Invalid type: %d", __func__, waveformType);
-            return -EDOM;
-        }
-        if (fToU16(duration, &delay, 4, 0.0f, COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) < 0) {
-            ALOGE("%s: Invalid argument: %d", __func__, duration);
-            return -ERANGE;
-        }
-        fToU16(PWLE_FREQUENCY_MIN_HZ, &freq, 4, PWLE_FREQUENCY_MIN_HZ, PWLE_FREQUENCY_MAX_HZ);
-        if (static_cast<std::underlying_type<Braking>::type>(brakingType)) {
-            flags |= PWLE_BRAKE_BIT;
-        }
-
-        constructPwleSegment(delay, 0 /*ignored*/, freq, flags, 0 /*ignored*/);
-        return 0;
-    }
-
-    int updateWLength(uint32_t totalDuration) {
-        uint8_t *f = front();
-        if (f == nullptr) {
-            ALOGE("%s: head does not exist!", __func__);
-            return -ENOMEM;
-        }
-        if (waveformType != WAVEFORM_PWLE) {
-            ALOGE("%s: Invalid type: %d", __func__, waveformType);
-            return -EDOM;
-        }
-        if (totalDuration > 0x7FFFF) {
-            ALOGE("%s: Invalid argument: %u", __func__, totalDuration);
-            return -EINVAL;
-        }
-        totalDuration *= 8; /* Unit: 0.125 ms (since wlength played @ 8kHz). */
-        totalDuration |=
-                WT_LEN_CALCD; /* Bit 23 is for WT_LEN_CALCD; Bit 22 is for WT_INDEFINITE. */
-        *(f + 0) = (totalDuration >> 24) & 0xFF;
-        *(f + 1) = (totalDuration >> 16) & 0xFF;
-        *(f + 2) = (totalDuration >> 8) & 0xFF;
-        *(f + 3) = totalDuration & 0xFF;
-        return 0;
-    }
-
-    int updateNSection(int segmentIdx) {
-        uint8_t *f = front();
-        if (f == nullptr) {
-            ALOGE("%s: head does not exist!", __func__);
-            return -ENOMEM;
-        }
-
-        if (waveformType == WAVEFORM_COMPOSE) {
-            if (segmentIdx > COMPOSE_SIZE_MAX + 1 /*1st effect may have a delay*/) {
-                ALOGE("%s: Invalid argument: %d", __func__, segmentIdx);
-                return -EINVAL;
-            }
-            *(f + 2) = (0xFF & segmentIdx);
-        } else if (waveformType == WAVEFORM_PWLE) {
-            if (segmentIdx > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
-                ALOGE("%s: Invalid argument: %d", __func__, segmentIdx);
-                return -EINVAL;
-            }
-            *(f + 7) |= (0xF0 & segmentIdx) >> 4; /* Bit 4 to 7 */
-            *(f + 9) |= (0x0F & segmentIdx) << 4; /* Bit 3 to 0 */
-        } else {
-            ALOGE("%s: Invalid type: %d", __func__, waveformType);
-            return -EDOM;
-        }
-
-        return 0;
-    }
+  private:
+    std::shared_ptr<IVibratorCallback> mCallback;
 };
 
+
 Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> hwCalDefault,
                    std::unique_ptr<HwApi> hwApiDual, std::unique_ptr<HwCal> hwCalDual,
                    std::unique_ptr<HwGPIO> hwgpio)
@@ -371,126 +226,115 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
       mHwApiDual(std::move(hwApiDual)),
       mHwCalDual(std::move(hwCalDual)),
       mHwGPIO(std::move(hwgpio)),
-      mAsyncHandle(std::async([] {})) {
-    int32_t longFrequencyShift;
-    std::string caldata{8, '0'};
-    uint32_t calVer;
-
+      mChunkPool(CHUNK_POOL_SIZE, FF_CUSTOM_DATA_LEN_MAX_PWLE),
+      mEffectCache(EFFECT_CACHE_SIZE),
+      mOwtSlots(OWT_SLOTS_MAX, FF_CUSTOM_DATA_LEN_MAX_PWLE),
+      mCreatedNs(Histogram::now()) {
     // ==================Single actuators and dual actuators checking =============================
     if ((mHwApiDual != nullptr) && (mHwCalDual != nullptr))
         mIsDual = true;
+}
+
+Vibrator::~Vibrator() {
+    if (mInitThread.joinable()) {
+        mInitThread.join();
+    }
+}
+
+void Vibrator::initAsync() {
+    mInitThread = std::thread(&Vibrator::init, this);
+}
+
+void Vibrator::init() {
+    ATRACE_NAME("Vibrator::init");
+    int64_t phaseNs = mCreatedNs;
+
+    recordPhase("registration", &phaseNs);
 
-    // ==================INPUT Devices== Base =================
+    // ==================INPUT Devices== Base and Flip =========
     const char *inputEventName = std::getenv("INPUT_EVENT_NAME");
     const char *inputEventPathName = std::getenv("INPUT_EVENT_PATH");
+    std::vector<std::string> inputNames;
+    std::vector<::android::base::unique_fd *> inputTargets;
     if ((strstr(inputEventName, "cs40l26") != nullptr) ||
         (strstr(inputEventName, "cs40l26_dual_input") != nullptr)) {
-        glob_t inputEventPaths;
-        int fd = -1;
-        int ret;
-        uint32_t val = 0;
-        char str[20] = {0x00};
-        for (uint8_t retry = 0; retry < 10; retry++) {
-            ret = glob(inputEventPathName, 0, nullptr, &inputEventPaths);
-            if (ret) {
-                ALOGE("Failed to get input event paths (%d): %s", errno, strerror(errno));
-            } else {
-                for (int i = 0; i < inputEventPaths.gl_pathc; i++) {
-                    fd = TEMP_FAILURE_RETRY(open(inputEventPaths.gl_pathv[i], O_RDWR));
-                    if (fd > 0) {
-                        if (ioctl(fd, EVIOCGBIT(0, sizeof(val)), &val) > 0 &&
-                            (val & (1 << EV_FF)) && ioctl(fd, EVIOCGNAME(sizeof(str)), &str) > 0 &&
-                            strstr(str, inputEventName) != nullptr) {
-                            mInputFd.reset(fd);
-                            ALOGI("Control %s through %s", inputEventName,
-                                  inputEventPaths.gl_pathv[i]);
-                            break;
-                        }
-                        close(fd);
-                    }
-                }
-            }
-
-            if (ret == 0) {
-                globfree(&inputEventPaths);
-            }
-            if (mInputFd.ok()) {
-                break;
-            }
-
-            sleep(1);
-            ALOGW("Retry #%d to search in %zu input devices.", retry, inputEventPaths.gl_pathc);
-        }
-
-        if (!mInputFd.ok()) {
-            ALOGE("Failed to get an input event with name %s", inputEventName);
-        }
+        inputNames.push_back(inputEventName);
+        inputTargets.push_back(&mInputFd);
     } else {
         ALOGE("The input name %s is not cs40l26_input or cs40l26_dual_input", inputEventName);
     }
-
-    // ==================INPUT Devices== Flip =================
     if (mIsDual) {
         const char *inputEventNameDual = std::getenv("INPUT_EVENT_NAME_DUAL");
         if ((strstr(inputEventNameDual, "cs40l26_dual_input") != nullptr)) {
-            glob_t inputEventPaths;
-            int fd = -1;
-            int ret;
-            uint32_t val = 0;
-            char str[20] = {0x00};
-            for (uint8_t retry = 0; retry < 10; retry++) {
-                ret = glob(inputEventPathName, 0, nullptr, &inputEventPaths);
-                if (ret) {
-                    ALOGE("Failed to get flip's input event paths (%d): %s", errno,
-                          strerror(errno));
-                } else {
-                    for (int i = 0; i < inputEventPaths.gl_pathc; i++) {
-                        fd = TEMP_FAILURE_RETRY(open(inputEventPaths.gl_pathv[i], O_RDWR));
-                        if (fd > 0) {
-                            if (ioctl(fd, EVIOCGBIT(0, sizeof(val)), &val) > 0 &&
-                                (val & (1 << EV_FF)) &&
-                                ioctl(fd, EVIOCGNAME(sizeof(str)), &str) > 0 &&
-                                strstr(str, inputEventNameDual) != nullptr) {
-                                mInputFdDual.reset(fd);
-                                ALOGI("Control %s through %s", inputEventNameDual,
-                                      inputEventPaths.gl_pathv[i]);
-                                break;
-                            }
-                            close(fd);
-                        }
-                    }
-                }
-
-                if (ret == 0) {
-                    globfree(&inputEventPaths);
-                }
-                if (mInputFdDual.ok()) {
-                    break;
-                }
-
-                sleep(1);
-                ALOGW("Retry #%d to search in %zu input devices.", retry, inputEventPaths.gl_pathc);
-            }
-
-            if (!mInputFdDual.ok()) {
-                ALOGE("Failed to get an input event with name %s", inputEventNameDual);
-            }
-            ALOGE("HWAPI: %s", std::getenv("HWAPI_PATH_PREFIX"));
+            inputNames.push_back(inputEventNameDual);
+            inputTargets.push_back(&mInputFdDual);
         } else {
             ALOGE("The input name %s is not cs40l26_dual_input", inputEventNameDual);
         }
     }
-    // ====================HAL internal effect table== Base ==================================
+    if (!inputNames.empty()) {
+        std::vector<::android::base::unique_fd> inputFds;
+        InputDiscovery(inputEventPathName).find(inputNames, &inputFds, INPUT_DISCOVERY_TIMEOUT);
+        for (size_t i = 0; i < inputTargets.size(); i++) {
+            *inputTargets[i] = std::move(inputFds[i]);
+        }
+    }
+
+    recordPhase("input discovery", &phaseNs);
 
-    mFfEffects.resize(WAVEFORM_MAX_INDEX);
     mEffectDurations.resize(WAVEFORM_MAX_INDEX);
     mEffectDurations = {
             1000, 100, 12, 1000, 300, 130, 150, 500, 100, 5, 12, 1000, 1000, 1000,
     }; /* 11+3 waveforms. The duration must < UINT16_MAX */
+
+    // Bypass the waveform update due to different input name
+    const bool uploadEffects = (strstr(inputEventName, "cs40l26") != nullptr) ||
+                               (strstr(inputEventName, "cs40l26_dual_input") != nullptr);
+
+    // The actuators are separate devices, so bring up the flip alongside the
+    // base.
+    std::future<void> flip;
+    if (mIsDual) {
+        flip = std::async(std::launch::async, &Vibrator::initFlip, this, uploadEffects);
+    }
+    initBase(uploadEffects);
+    if (flip.valid()) {
+        flip.get();
+    }
+    recordPhase("actuators", &phaseNs);
+
+    // ====== Get GPIO status and init it ================
+    mGPIOStatus = mHwGPIO->getGPIO();
+    if (!mGPIOStatus || !mHwGPIO->initGPIO()) {
+        ALOGE("Vibrator: GPIO initialization process error");
+    }
+    recordPhase("gpio", &phaseNs);
+
+    {
+        const std::scoped_lock<std::mutex> lock(mReadyMutex);
+        mStartup.push_back({"total", phaseNs - mCreatedNs});
+        mReady = true;
+    }
+    mReadyCondition.notify_all();
+    ALOGI("Vibrator: Ready in %.1f ms", (phaseNs - mCreatedNs) / 1e6);
+}
+
+void Vibrator::initBase(bool uploadEffects) {
+    ATRACE_NAME("Vibrator::initBase");
+    int64_t startNs = Histogram::now();
+    int32_t longFrequencyShift;
+    std::string caldata{8, '0'};
+    uint32_t calVer;
+    float f0Hz = 0;
+    float q = 0;
+    bool hasRedc = false;
+
+    // ====================HAL internal effect table== Base ==================================
+
+    mFfEffects.resize(WAVEFORM_MAX_INDEX);
     mEffectCustomData.reserve(WAVEFORM_MAX_INDEX);
 
     uint8_t effectIndex;
-    uint16_t numBytes = 0;
     for (effectIndex = 0; effectIndex < WAVEFORM_MAX_INDEX; effectIndex++) {
         if (effectIndex < WAVEFORM_MAX_PHYSICAL_INDEX) {
             /* Initialize physical waveforms. */
@@ -505,9 +349,7 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
                     .u.periodic.custom_len =
                             static_cast<uint32_t>(mEffectCustomData[effectIndex].size()),
             };
-            // Bypass the waveform update due to different input name
-            if ((strstr(inputEventName, "cs40l26") != nullptr) ||
-                (strstr(inputEventName, "cs40l26_dual_input") != nullptr)) {
+            if (uploadEffects) {
                 // Let the firmware control the playback duration to avoid
                 // cutting any effect that is played short
                 if (!mHwApiDef->setFFEffect(
@@ -520,85 +362,36 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
                 ALOGW("Unexpected effect index: %d -> %d", effectIndex, mFfEffects[effectIndex].id);
             }
         } else {
-            /* Initiate placeholders for OWT effects. */
-            numBytes = effectIndex == WAVEFORM_COMPOSE ? FF_CUSTOM_DATA_LEN_MAX_COMP
-                                                       : FF_CUSTOM_DATA_LEN_MAX_PWLE;
-            std::vector<int16_t> tempVec(numBytes, 0);
-            mEffectCustomData.push_back(std::move(tempVec));
+            /* Initiate placeholders for OWT effects. The waveform is passed
+             * in at upload, straight from the encoded DspMemChunk. */
+            mEffectCustomData.emplace_back();
             mFfEffects[effectIndex] = {
                     .type = FF_PERIODIC,
                     .id = -1,
                     .replay.length = 0,
                     .u.periodic.waveform = FF_CUSTOM,
-                    .u.periodic.custom_data = mEffectCustomData[effectIndex].data(),
+                    .u.periodic.custom_data = nullptr,
                     .u.periodic.custom_len = 0,
             };
         }
     }
 
-    // ====================HAL internal effect table== Flip ==================================
-    if (mIsDual) {
-        mFfEffectsDual.resize(WAVEFORM_MAX_INDEX);
-        mEffectCustomDataDual.reserve(WAVEFORM_MAX_INDEX);
-
-        for (effectIndex = 0; effectIndex < WAVEFORM_MAX_INDEX; effectIndex++) {
-            if (effectIndex < WAVEFORM_MAX_PHYSICAL_INDEX) {
-                /* Initialize physical waveforms. */
-                mEffectCustomDataDual.push_back({RAM_WVFRM_BANK, effectIndex});
-                mFfEffectsDual[effectIndex] = {
-                        .type = FF_PERIODIC,
-                        .id = -1,
-                        // Length == 0 to allow firmware control of the duration
-                        .replay.length = 0,
-                        .u.periodic.waveform = FF_CUSTOM,
-                        .u.periodic.custom_data = mEffectCustomDataDual[effectIndex].data(),
-                        .u.periodic.custom_len =
-                                static_cast<uint32_t>(mEffectCustomDataDual[effectIndex].size()),
-                };
-                // Bypass the waveform update due to different input name
-                if ((strstr(inputEventName, "cs40l26") != nullptr) ||
-                    (strstr(inputEventName, "cs40l26_dual_input") != nullptr)) {
-                    // Let the firmware control the playback duration to avoid
-                    // cutting any effect that is played short
-                    if (!mHwApiDual->setFFEffect(
-                                mInputFdDual, &mFfEffectsDual[effectIndex],
-                                mEffectDurations[effectIndex])) {
-                        ALOGE("Failed upload flip's effect %d (%d): %s", effectIndex, errno,
-                              strerror(errno));
-                    }
-                }
-                if (mFfEffectsDual[effectIndex].id != effectIndex) {
-                    ALOGW("Unexpected effect index: %d -> %d", effectIndex,
-                          mFfEffectsDual[effectIndex].id);
-                }
-            } else {
-                /* Initiate placeholders for OWT effects. */
-                numBytes = effectIndex == WAVEFORM_COMPOSE ? FF_CUSTOM_DATA_LEN_MAX_COMP
-                                                       : FF_CUSTOM_DATA_LEN_MAX_PWLE;
-                std::vector<int16_t> tempVec(numBytes, 0);
-                mEffectCustomDataDual.push_back(std::move(tempVec));
-                mFfEffectsDual[effectIndex] = {
-                        .type = FF_PERIODIC,
-                        .id = -1,
-                        .replay.length = 0,
-                        .u.periodic.waveform = FF_CUSTOM,
-                        .u.periodic.custom_data = mEffectCustomDataDual[effectIndex].data(),
-                        .u.periodic.custom_len = 0,
-                };
-            }
-        }
-    }
     // ==============Calibration data checking======================================
 
     if (mHwCalDef->getF0(&caldata)) {
         mHwApiDef->setF0(caldata);
+        f0Hz = static_cast<float>(std::strtoul(caldata.c_str(), nullptr, 16)) /
+               (1 << Q14_BIT_SHIFT);
     }
     if (mHwCalDef->getRedc(&caldata)) {
         mHwApiDef->setRedc(caldata);
+        hasRedc = true;
     }
     if (mHwCalDef->getQ(&caldata)) {
         mHwApiDef->setQ(caldata);
+        q = static_cast<float>(std::strtoul(caldata.c_str(), nullptr, 16)) / (1 << Q16_BIT_SHIFT);
     }
+    updateBandwidthAmplitudeMap(LraModel(f0Hz, q), hasRedc);
 
     if (mHwCalDef->getF0SyncOffset(&mF0Offset)) {
         ALOGD("Vibrator::Vibrator: F0 offset calculated from both base and flip calibration data: "
@@ -616,25 +409,6 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
         ALOGD("Vibrator::Vibrator: F0 offset calculated from long shift frequency: %u", mF0Offset);
     }
 
-    if (mIsDual) {
-        if (mHwCalDual->getF0(&caldata)) {
-            mHwApiDual->setF0(caldata);
-        }
-        if (mHwCalDual->getRedc(&caldata)) {
-            mHwApiDual->setRedc(caldata);
-        }
-        if (mHwCalDual->getQ(&caldata)) {
-            mHwApiDual->setQ(caldata);
-        }
-
-        if (mHwCalDual->getF0SyncOffset(&mF0OffsetDual)) {
-            ALOGD("Vibrator::Vibrator: Dual: F0 offset calculated from both base and flip "
-                  "calibration data: "
-                  "%u",
-                  mF0OffsetDual);
-        }
-    }
-
     mHwCalDef->getVersion(&calVer);
     if (calVer == 2) {
         mHwCalDef->getTickVolLevels(&(mTickEffectVol));
@@ -652,11 +426,7 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
     mHwApiDef->setF0CompEnable(mHwCalDef->isF0CompEnabled());
     mHwApiDef->setRedcCompEnable(mHwCalDef->isRedcCompEnabled());
     mHwApiDef->setMinOnOffInterval(MIN_ON_OFF_INTERVAL_US);
-    if (mIsDual) {
-        mHwApiDual->setF0CompEnable(mHwCalDual->isF0CompEnabled());
-        mHwApiDual->setRedcCompEnable(mHwCalDual->isRedcCompEnabled());
-        mHwApiDual->setMinOnOffInterval(MIN_ON_OFF_INTERVAL_US);
-    }
+    mIsPreemptionEnabled = mHwCalDef->isPreemptionEnabled();
     // ===============Audio coupled haptics bool init ========
     mIsUnderExternalControl = false;
 
@@ -680,15 +450,132 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> h
     mPrimitiveMaxScale = {1.0f, 0.95f, 0.75f, 0.9f, 1.0f, 1.0f, 1.0f, 0.75f, 0.75f};
     mPrimitiveMinScale = {0.0f, 0.01f, 0.11f, 0.23f, 0.0f, 0.25f, 0.02f, 0.03f, 0.16f};
 
-    // ====== Get GPIO status and init it ================
-    mGPIOStatus = mHwGPIO->getGPIO();
-    if (!mGPIOStatus || !mHwGPIO->initGPIO()) {
-        ALOGE("Vibrator: GPIO initialization process error");
+    prepareCompoundEffects();
+    mCalibrationGeneration++;
+
+    recordPhase("base", &startNs);
+}
+
+void Vibrator::updateBandwidthAmplitudeMap(const LraModel &lra, bool hasRedc) {
+    // f0, redc and Q are measured together, so a missing one means the LRA
+    // was never calibrated and the model would be a guess.
+    if (hasRedc && lra.isValid()) {
+        mBandwidthAmplitudeMap = lra.bandwidthAmplitudeMap(
+                PWLE_FREQUENCY_MIN_HZ, PWLE_FREQUENCY_RESOLUTION_HZ, PWLE_BW_MAP_SIZE);
+    } else {
+        ALOGW("Uncalibrated LRA, using a flat bandwidth amplitude map");
+        mBandwidthAmplitudeMap.assign(PWLE_BW_MAP_SIZE, PWLE_LEVEL_MAX);
     }
 }
 
+void Vibrator::initFlip(bool uploadEffects) {
+    ATRACE_NAME("Vibrator::initFlip");
+    int64_t startNs = Histogram::now();
+    std::string caldata{8, '0'};
+    uint8_t effectIndex;
+
+    // ====================HAL internal effect table== Flip ==================================
+    mFfEffectsDual.resize(WAVEFORM_MAX_INDEX);
+    mEffectCustomDataDual.reserve(WAVEFORM_MAX_INDEX);
+
+    for (effectIndex = 0; effectIndex < WAVEFORM_MAX_INDEX; effectIndex++) {
+        if (effectIndex < WAVEFORM_MAX_PHYSICAL_INDEX) {
+            /* Initialize physical waveforms. */
+            mEffectCustomDataDual.push_back({RAM_WVFRM_BANK, effectIndex});
+            mFfEffectsDual[effectIndex] = {
+                    .type = FF_PERIODIC,
+                    .id = -1,
+                    // Length == 0 to allow firmware control of the duration
+                    .replay.length = 0,
+                    .u.periodic.waveform = FF_CUSTOM,
+                    .u.periodic.custom_data = mEffectCustomDataDual[effectIndex].data(),
+                    .u.periodic.custom_len =
+                            static_cast<uint32_t>(mEffectCustomDataDual[effectIndex].size()),
+            };
+            if (uploadEffects) {
+                // Let the firmware control the playback duration to avoid
+                // cutting any effect that is played short
+                if (!mHwApiDual->setFFEffect(
+                            mInputFdDual, &mFfEffectsDual[effectIndex],
+                            mEffectDurations[effectIndex])) {
+                    ALOGE("Failed upload flip's effect %d (%d): %s", effectIndex, errno,
+                          strerror(errno));
+                }
+            }
+            if (mFfEffectsDual[effectIndex].id != effectIndex) {
+                ALOGW("Unexpected effect index: %d -> %d", effectIndex,
+                      mFfEffectsDual[effectIndex].id);
+            }
+        } else {
+            /* Initiate placeholders for OWT effects. The waveform is passed
+             * in at upload, straight from the encoded DspMemChunk. */
+            mEffectCustomDataDual.emplace_back();
+            mFfEffectsDual[effectIndex] = {
+                    .type = FF_PERIODIC,
+                    .id = -1,
+                    .replay.length = 0,
+                    .u.periodic.waveform = FF_CUSTOM,
+                    .u.periodic.custom_data = nullptr,
+                    .u.periodic.custom_len = 0,
+            };
+        }
+    }
+
+    // ==============Calibration data checking======================================
+
+    if (mHwCalDual->getF0(&caldata)) {
+        mHwApiDual->setF0(caldata);
+    }
+    if (mHwCalDual->getRedc(&caldata)) {
+        mHwApiDual->setRedc(caldata);
+    }
+    if (mHwCalDual->getQ(&caldata)) {
+        mHwApiDual->setQ(caldata);
+    }
+
+    if (mHwCalDual->getF0SyncOffset(&mF0OffsetDual)) {
+        ALOGD("Vibrator::Vibrator: Dual: F0 offset calculated from both base and flip "
+              "calibration data: "
+              "%u",
+              mF0OffsetDual);
+    }
+
+    // ================Project specific setting to driver===============================
+
+    mHwApiDual->setF0CompEnable(mHwCalDual->isF0CompEnabled());
+    mHwApiDual->setRedcCompEnable(mHwCalDual->isRedcCompEnabled());
+    mHwApiDual->setMinOnOffInterval(MIN_ON_OFF_INTERVAL_US);
+
+    mCalibrationGeneration++;
+    recordPhase("flip", &startNs);
+}
+
+void Vibrator::recordPhase(const char *name, int64_t *startNs) {
+    int64_t nowNs = Histogram::now();
+    const std::scoped_lock<std::mutex> lock(mReadyMutex);
+    mStartup.push_back({name, nowNs - *startNs});
+    *startNs = nowNs;
+}
+
+bool Vibrator::waitForReady() {
+    if (mReady) {
+        return true;
+    }
+    ATRACE_NAME("Vibrator::waitForReady");
+    std::unique_lock<std::mutex> lock(mReadyMutex);
+    if (!mReadyCondition.wait_for(lock, READY_TIMEOUT, [this] { return mReady.load(); })) {
+        ALOGE("Vibrator: Hardware not ready after %lld ms",
+              static_cast<long long>(READY_TIMEOUT.count()));
+        return false;
+    }
+    return true;
+}
+
 ndk::ScopedAStatus Vibrator::getCapabilities(int32_t *_aidl_return) {
     ATRACE_NAME("Vibrator::getCapabilities");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
 
     int32_t ret = IVibrator::CAP_ON_CALLBACK | IVibrator::CAP_PERFORM_CALLBACK |
                   IVibrator::CAP_AMPLITUDE_CONTROL | IVibrator::CAP_GET_RESONANT_FREQUENCY |
@@ -710,41 +597,58 @@ ndk::ScopedAStatus Vibrator::getCapabilities(int32_t *_aidl_return) {
 
 ndk::ScopedAStatus Vibrator::off() {
     ATRACE_NAME("Vibrator::off");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    using Phase = PlaybackState::Phase;
     bool ret{true};
-    const std::scoped_lock<std::mutex> lock(mActiveId_mutex);
+    PlaybackState::State state = mState.load();
 
-    if (mActiveId >= 0) {
-        ALOGD("Off: Stop the active effect: %d", mActiveId);
-        /* Stop the active effect. */
-        if (!mHwApiDef->setFFPlay(mInputFd, mActiveId, false)) {
-            ALOGE("Off: Failed to stop effect %d (%d): %s", mActiveId, errno, strerror(errno));
-            ret = false;
-        }
-        if (mIsDual && (!mHwApiDual->setFFPlay(mInputFdDual, mActiveId, false))) {
-            ALOGE("Off: Failed to stop flip's effect %d (%d): %s", mActiveId, errno,
-                  strerror(errno));
-            ret = false;
-        }
+    while (true) {
+        if (state.phase == Phase::PLAYING) {
+            if (!mState.transition(&state, Phase::STOPPING)) {
+                continue;
+            }
+            ALOGD("Off: Stop the active effect: %d", state.effectIndex);
+            ret = stopEffect(state.effectIndex);
 
-        if (!mHwGPIO->setGPIOOutput(false)) {
-            ALOGE("Off: Failed to reset GPIO(%d): %s", errno, strerror(errno));
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+            if (!mHwGPIO->setGPIOOutput(false)) {
+                ALOGE("Off: Failed to reset GPIO(%d): %s", errno, strerror(errno));
+                mState.transition(&state, Phase::PLAYING);
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+            }
+            // Its completion cleans up after it.
+            mState.transition(&state, ret ? Phase::IDLE : Phase::PLAYING);
+        } else if (state.phase == Phase::UPLOADING || state.phase == Phase::ARMED ||
+                   state.phase == Phase::STOPPING) {
+            // An effect is starting, or the one playing is being stopped to
+            // make way for it. Cancel it rather than wait for the ioctls in
+            // flight; whoever issued them finds out once they are done.
+            if (!mState.transition(&state, Phase::IDLE)) {
+                continue;
+            }
+            ALOGD("Off: Cancelled the effect starting");
+        } else {
+            ALOGD("Off: Vibrator is already off");
         }
-    } else {
-        ALOGD("Off: Vibrator is already off");
+        break;
     }
 
-    setGlobalAmplitude(false);
-    if (mF0Offset) {
-        mHwApiDef->setF0Offset(0);
-        if (mIsDual && mF0OffsetDual) {
-            mHwApiDual->setF0Offset(0);
+    {
+        // Cancelled already; only the resets wait for an effect starting.
+        const std::scoped_lock<std::mutex> lock(mStart_mutex);
+        HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
+        setGlobalAmplitude(false);
+        if (mF0Offset) {
+            mHwApiDef->setF0Offset(0);
+            if (mIsDual && mF0OffsetDual) {
+                mHwApiDual->setF0Offset(0);
+            }
         }
     }
 
     if (ret) {
         ALOGD("Off: Done.");
-        mActiveId = -1;
         return ndk::ScopedAStatus::ok();
     } else {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -754,6 +658,9 @@ ndk::ScopedAStatus Vibrator::off() {
 ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
                                 const std::shared_ptr<IVibratorCallback> &callback) {
     ATRACE_NAME("Vibrator::on");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     ALOGD("Vibrator::on");
 
     if (timeoutMs > MAX_TIME_MS) {
@@ -765,11 +672,15 @@ ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
     if (MAX_COLD_START_LATENCY_MS <= MAX_TIME_MS - timeoutMs) {
         timeoutMs += MAX_COLD_START_LATENCY_MS;
     }
-    setGlobalAmplitude(true);
-    if (mF0Offset) {
-        mHwApiDef->setF0Offset(mF0Offset);
-        if (mIsDual && mF0OffsetDual) {
-            mHwApiDual->setF0Offset(mF0OffsetDual);
+    const std::scoped_lock<std::mutex> lock(mStart_mutex);
+    {
+        HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
+        setGlobalAmplitude(true);
+        if (mF0Offset) {
+            mHwApiDef->setF0Offset(mF0Offset);
+            if (mIsDual && mF0OffsetDual) {
+                mHwApiDual->setF0Offset(mF0OffsetDual);
+            }
         }
     }
     return on(timeoutMs, index, nullptr /*ignored*/, callback);
@@ -779,11 +690,101 @@ ndk::ScopedAStatus Vibrator::perform(Effect effect, EffectStrength strength,
                                      const std::shared_ptr<IVibratorCallback> &callback,
                                      int32_t *_aidl_return) {
     ATRACE_NAME("Vibrator::perform");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     ALOGD("Vibrator::perform");
     return performEffect(effect, strength, callback, _aidl_return);
 }
 
+ndk::ScopedAStatus Vibrator::scheduleEffects(const std::vector<ScheduledEffect> &effects,
+                                             const std::shared_ptr<IVibratorCallback> &callback) {
+    ATRACE_NAME("Vibrator::scheduleEffects");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    if (effects.size() > TIMELINE_SIZE_MAX) {
+        ALOGE("Too many scheduled effects: %zu", effects.size());
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    std::vector<EffectPlan> plans;
+    plans.reserve(effects.size());
+    for (size_t i = 0; i < effects.size(); i++) {
+        if (i > 0 && effects[i].startNs < effects[i - 1].startNs) {
+            ALOGE("Scheduled effect %zu starts before the previous one", i);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        plans.emplace_back();
+        ndk::ScopedAStatus status = planEffect(effects[i].effect, effects[i].strength, &plans[i]);
+        if (!status.isOk()) {
+            return status;
+        }
+    }
+
+    // Upload the waveforms now, so that firing only has to trigger them, and
+    // pin them until they fire or are dropped, so that other effects cannot
+    // evict them in between.
+    std::vector<std::shared_ptr<const void>> pins(effects.size());
+    {
+        const std::scoped_lock<std::mutex> lock(mStart_mutex);
+        PlaybackState::State state = mState.load();
+        const int16_t keep = state.phase == PlaybackState::Phase::IDLE ? -1 : state.effectIndex;
+        for (size_t i = 0; i < effects.size(); i++) {
+            if (plans[i].kind() != EffectPlan::Kind::CHUNK) {
+                continue;
+            }
+            uint32_t effectIndex;
+            ndk::ScopedAStatus status = prepareOwtEffect(plans[i].chunk(), &effectIndex, keep);
+            if (status.getExceptionCode() == EX_ILLEGAL_STATE) {
+                // No room while the chip plays; firing uploads it then.
+                ALOGD("Uploading scheduled effect %zu once it fires", i);
+                continue;
+            }
+            if (!status.isOk()) {
+                return status;
+            }
+            pins[i] = pinOwtEffect(plans[i].chunk());
+        }
+    }
+
+    std::vector<TimelineScheduler::Entry> entries;
+    auto completion = std::make_shared<ScheduledCompletion>(callback);
+    for (size_t i = 0; i < effects.size(); i++) {
+        const bool last = i + 1 == effects.size();
+        entries.push_back({effects[i].startNs, [this, plan = plans[i], pin = std::move(pins[i]),
+                                                completion = last ? completion : nullptr] {
+                               auto lastCallback = completion ? completion->take() : nullptr;
+                               auto status = performPlan(plan, nullptr, lastCallback);
+                               if (!status.isOk()) {
+                                   ALOGE("Failed to play scheduled effect (%d)",
+                                         status.getExceptionCode());
+                                   if (lastCallback) {
+                                       dispatchComplete(lastCallback);
+                                   }
+                               }
+                           }});
+    }
+    // With no effects to play, the callback completes right away.
+    completion.reset();
+
+    if (mTimeline.schedule(std::move(entries)) < 0) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Vibrator::cancelScheduledEffects() {
+    if (mTimeline.cancel() < 0) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
 ndk::ScopedAStatus Vibrator::getSupportedEffects(std::vector<Effect> *_aidl_return) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     *_aidl_return = {Effect::TEXTURE_TICK, Effect::TICK, Effect::CLICK, Effect::HEAVY_CLICK,
                      Effect::DOUBLE_CLICK};
     return ndk::ScopedAStatus::ok();
@@ -791,11 +792,16 @@ ndk::ScopedAStatus Vibrator::getSupportedEffects(std::vector<Effect> *_aidl_retu
 
 ndk::ScopedAStatus Vibrator::setAmplitude(float amplitude) {
     ATRACE_NAME("Vibrator::setAmplitude");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
 
     if (amplitude <= 0.0f || amplitude > 1.0f) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
 
+    const std::scoped_lock<std::mutex> lock(mExternalControl_mutex);
+    const std::scoped_lock<std::mutex> startLock(mStart_mutex);
     mLongEffectScale = amplitude;
     if (!isUnderExternalControl()) {
         return setGlobalAmplitude(true);
@@ -806,10 +812,18 @@ ndk::ScopedAStatus Vibrator::setAmplitude(float amplitude) {
 
 ndk::ScopedAStatus Vibrator::setExternalControl(bool enabled) {
     ATRACE_NAME("Vibrator::setExternalControl");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
 
-    setGlobalAmplitude(enabled);
+    const std::scoped_lock<std::mutex> lock(mExternalControl_mutex);
+    {
+        const std::scoped_lock<std::mutex> startLock(mStart_mutex);
+        setGlobalAmplitude(enabled);
+    }
 
-    if (mHasHapticAlsaDevice || mConfigHapticAlsaDeviceDone || hasHapticAlsaDevice()) {
+    // The device found stays put, so mCard and mDevice need no locking.
+    if (hasHapticAlsaDevice()) {
         if (!mHwApiDef->setHapticPcmAmp(&mHapticPcm, enabled, mCard, mDevice)) {
             ALOGE("Failed to %s haptic pcm device: %d", (enabled ? "enable" : "disable"), mDevice);
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -825,23 +839,35 @@ ndk::ScopedAStatus Vibrator::setExternalControl(bool enabled) {
 
 ndk::ScopedAStatus Vibrator::getCompositionDelayMax(int32_t *maxDelayMs) {
     ATRACE_NAME("Vibrator::getCompositionDelayMax");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     *maxDelayMs = COMPOSE_DELAY_MAX_MS;
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::getCompositionSizeMax(int32_t *maxSize) {
     ATRACE_NAME("Vibrator::getCompositionSizeMax");
-    *maxSize = COMPOSE_SIZE_MAX;
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    *maxSize = COMPOSE_STREAM_SIZE_MAX;
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::getSupportedPrimitives(std::vector<CompositePrimitive> *supported) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     *supported = mSupportedPrimitives;
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive,
                                                   int32_t *durationMs) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     ndk::ScopedAStatus status;
     uint32_t effectIndex;
     if (primitive != CompositePrimitive::NOOP) {
@@ -860,36 +886,52 @@ ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive,
 ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composite,
                                      const std::shared_ptr<IVibratorCallback> &callback) {
     ATRACE_NAME("Vibrator::compose");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     ALOGD("Vibrator::compose");
-    uint16_t size;
-    uint16_t nextEffectDelay;
-    uint16_t totalDuration = 0;
 
-    if (composite.size() > COMPOSE_SIZE_MAX || composite.empty()) {
+    EffectCache::Key key;
+    key << WAVEFORM_COMPOSE << mCalibrationGeneration.load();
+    for (auto &e : composite) {
+        key << e.primitive << e.scale << e.delayMs;
+    }
+    if (auto cached = mEffectCache.find(key)) {
+        return performEffect(WAVEFORM_MAX_INDEX /*ignored*/, VOLTAGE_SCALE_MAX /*ignored*/,
+                             cached->ch.get(), callback);
+    }
+
+    if (composite.size() > COMPOSE_STREAM_SIZE_MAX || composite.empty()) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
 
+    EffectPlan plan(OWT_STREAM_SEGMENTS_MAX, MIN_ON_OFF_INTERVAL_US);
+    auto status = planCompose(composite, &plan);
+    if (!status.isOk()) {
+        return status;
+    }
+
+    return performPlan(plan, &key, callback);
+}
+
+ndk::ScopedAStatus Vibrator::planCompose(const std::vector<CompositeEffect> &composite,
+                                         EffectPlan *outPlan) {
+    std::vector<ComposeSection> sections;
+    uint16_t nextEffectDelay = 0;
+
     /* Check if there is a wait before the first effect. */
     nextEffectDelay = composite.front().delayMs;
-    totalDuration += nextEffectDelay;
     if (nextEffectDelay > COMPOSE_DELAY_MAX_MS || nextEffectDelay < 0) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    } else if (nextEffectDelay > 0) {
-        size = composite.size() + 1;
-    } else {
-        size = composite.size();
     }
 
-    DspMemChunk ch(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
-    const uint8_t header_count = ch.size();
-
+    sections.reserve(composite.size() + 1);
     /* Insert 1 section for a wait before the first effect. */
     if (nextEffectDelay) {
-        ch.constructComposeSegment(0 /*amplitude*/, 0 /*index*/, 0 /*repeat*/, 0 /*flags*/,
-                                   nextEffectDelay /*delay*/);
+        sections.push_back({0 /*amplitude*/, 0 /*index*/, 0 /*repeat*/, nextEffectDelay});
     }
 
-    for (uint32_t i_curr = 0, i_next = 1; i_curr < composite.size(); i_curr++, i_next++) {
+    for (size_t i_curr = 0, i_next = 1; i_curr < composite.size(); i_curr++, i_next++) {
         auto &e_curr = composite[i_curr];
         uint32_t effectIndex = 0;
         uint32_t effectVolLevel = 0;
@@ -913,7 +955,6 @@ ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composi
                 effectScale = mPrimitiveMinScale[static_cast<uint32_t>(e_curr.primitive)];
             }
             effectVolLevel = intensityToVolLevel(effectScale, effectIndex);
-            totalDuration += mEffectDurations[effectIndex];
         }
 
         /* Fetch the next composite effect delay and fill into the current section */
@@ -922,178 +963,390 @@ ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composi
             auto &e_next = composite[i_next];
             int32_t delay = e_next.delayMs;
 
-            if (delay > COMPOSE_DELAY_MAX_MS || delay < 0) {
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            if (delay > COMPOSE_DELAY_MAX_MS || delay < 0) {
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            nextEffectDelay = delay;
+        }
+
+        if (effectIndex == 0 && nextEffectDelay == 0) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        if (effectVolLevel > 100 || effectIndex > WAVEFORM_MAX_PHYSICAL_INDEX) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+
+        sections.push_back({static_cast<uint8_t>(effectVolLevel),
+                            static_cast<uint8_t>(effectIndex), 0 /*repeat*/, nextEffectDelay});
+    }
+
+    if (outPlan->setCompose(std::move(sections), mEffectDurations) < 0) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus Vibrator::prepareOwtEffect(const DspMemChunk *ch, uint32_t *outEffectIndex,
+                                              int16_t keep, bool evict) {
+    if (ch->front() == nullptr) {
+        ALOGE("Invalid OWT bank");
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    if (ch->type() != WAVEFORM_PWLE && ch->type() != WAVEFORM_COMPOSE) {
+        ALOGE("Invalid OWT type");
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+    int16_t id = mOwtSlots.find({reinterpret_cast<const char *>(ch->front()), ch->size()});
+    if (id >= 0 && mGPIOStatus && mIsDual && id != mGpiEffect) {
+        // The trigger was mapped to another effect since this one was
+        // uploaded. Only uploading it again maps it back.
+        if (!evict) {
+            ALOGD("Not remapping effect %d without erasing", id);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+        if (!waitForErasable()) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+        mOwtSlots.erase(id);
+        if (!mHwApiDef->eraseOwtEffect(mInputFd, id, &mFfEffects)) {
+            ALOGE("Failed to erase the composed effect %d", id);
+        }
+        if (!mHwApiDual->eraseOwtEffect(mInputFdDual, id, &mFfEffectsDual)) {
+            ALOGE("Failed to erase flip's composed effect %d", id);
+        }
+        id = -1;
+    }
+    if (id >= 0) {
+        *outEffectIndex = id;
+        return ndk::ScopedAStatus::ok();
+    }
+    *outEffectIndex = ch->type();
+    return uploadOwtEffect(ch, outEffectIndex, keep, evict);
+}
+
+ndk::ScopedAStatus Vibrator::uploadOwtEffect(const DspMemChunk *ch, uint32_t *outEffectIndex,
+                                             int16_t keep, bool evict) {
+    uint32_t effectIndex = ch->type();
+    std::string_view waveform{reinterpret_cast<const char *>(ch->front()), ch->size()};
+
+    // Make room, evicting the least recently played waveforms.
+    bool erasable = false;
+    while (true) {
+        uint32_t freeBytes = 0;
+        uint32_t freeBytesDual = 0;
+        {
+            HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
+            bool read = mHwApiDef->getOwtFreeSpace(&freeBytes);
+            if (mIsDual && !mHwApiDual->getOwtFreeSpace(&freeBytesDual)) {
+                read = false;
+            }
+            // Without the free space, any eviction would be a guess.
+            if (!batch.submit() || !read) {
+                ALOGE("Failed to get OWT free space");
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+            }
+        }
+        bool fits = ch->size() <= freeBytes && (!mIsDual || ch->size() <= freeBytesDual);
+        if (fits && !mOwtSlots.full()) {
+            break;
+        }
+        if (!evict) {
+            ALOGD("No room for effect %d without evicting", effectIndex);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+
+        if (!erasable) {
+            if (!waitForErasable()) {
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
             }
-            nextEffectDelay = delay;
-            totalDuration += delay;
+            erasable = true;
         }
 
-        if (effectIndex == 0 && nextEffectDelay == 0) {
+        int16_t victim = mOwtSlots.evict(keep);
+        if (victim < 0 && mOwtSlots.size()) {
+            // Only kept or pinned waveforms are left.
+            ALOGD("No effect to evict for effect %d", effectIndex);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+        if (victim < 0) {
+            if (ch->size() > freeBytes) {
+                ALOGE("Invalid OWT length: Effect %d: %zu > %d!", effectIndex, ch->size(),
+                      freeBytes);
+            } else {
+                ALOGE("Invalid OWT length in flip: Effect %d: %zu > %d!", effectIndex,
+                      ch->size(), freeBytesDual);
+            }
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
         }
+        if (!mHwApiDef->eraseOwtEffect(mInputFd, victim, &mFfEffects)) {
+            ALOGE("Failed to evict the composed effect %d", victim);
+        }
+        if (mIsDual && !mHwApiDual->eraseOwtEffect(mInputFdDual, victim, &mFfEffectsDual)) {
+            ALOGE("Failed to evict flip's composed effect %d", victim);
+        }
+    }
+
+    int errorStatus;
+    if (mGPIOStatus && mIsDual) {
+        mFfEffects[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
+        mFfEffectsDual[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
+    } else {
+        ALOGD("Not dual haptics HAL and GPIO status fail");
+    }
 
-        ch.constructComposeSegment(effectVolLevel, effectIndex, 0 /*repeat*/, 0 /*flags*/,
-                                   nextEffectDelay /*delay*/);
+    // The previous upload of this type may still be resident under the id
+    // left in the template; always create a new effect.
+    mFfEffects[effectIndex].id = -1;
+    if (!mHwApiDef->uploadOwtEffect(mInputFd, ch->front(), ch->size(), &mFfEffects[effectIndex],
+                                    outEffectIndex, &errorStatus)) {
+        ALOGE("Invalid uploadOwtEffect");
+        return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+    }
+    uint32_t baseIndex = *outEffectIndex;
+    if (mIsDual) {
+        mFfEffectsDual[effectIndex].id = -1;
+        if (!mHwApiDual->uploadOwtEffect(mInputFdDual, ch->front(), ch->size(),
+                                         &mFfEffectsDual[effectIndex], outEffectIndex,
+                                         &errorStatus)) {
+            ALOGE("Invalid uploadOwtEffect in flip");
+            return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+        }
     }
 
-    ch.flush();
-    if (ch.updateNSection(size) < 0) {
-        ALOGE("%s: Failed to update the section count", __func__);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    if (mGPIOStatus && mIsDual) {
+        mGpiEffect = *outEffectIndex;
     }
-    if (header_count == ch.size()) {
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+
+    // Both actuators are played through one id. If they diverged, leave the
+    // effect out of the slots; syncOwtSlots() flushes it after playback.
+    if (*outEffectIndex == baseIndex) {
+        mOwtSlots.insert(waveform, *outEffectIndex);
     } else {
-        // Composition duration should be 0 to allow firmware to play the whole effect
-        mFfEffects[WAVEFORM_COMPOSE].replay.length = 0;
-        if (mIsDual) {
-            mFfEffectsDual[WAVEFORM_COMPOSE].replay.length = 0;
-        }
-        return performEffect(WAVEFORM_MAX_INDEX /*ignored*/, VOLTAGE_SCALE_MAX /*ignored*/, &ch,
-                             callback);
+        ALOGE("OWT effect ids differ: base: %u flip: %u", baseIndex, *outEffectIndex);
     }
+    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, uint32_t effectIndex, const DspMemChunk *ch,
-                                const std::shared_ptr<IVibratorCallback> &callback) {
-    ndk::ScopedAStatus status = ndk::ScopedAStatus::ok();
+                                const std::shared_ptr<IVibratorCallback> &callback,
+                                Segments &&queued) {
+    using Phase = PlaybackState::Phase;
 
     if (effectIndex >= FF_MAX_EFFECTS) {
         ALOGE("Invalid waveform index %d", effectIndex);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
-    if (mAsyncHandle.wait_for(ASYNC_COMPLETION_TIMEOUT) != std::future_status::ready) {
-        ALOGE("Previous vibration pending: prev: %d, curr: %d", mActiveId, effectIndex);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-    }
-
-    if (ch) {
-        /* Upload OWT effect. */
-        if (ch->front() == nullptr) {
-            ALOGE("Invalid OWT bank");
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
-
-        if (ch->type() != WAVEFORM_PWLE && ch->type() != WAVEFORM_COMPOSE) {
-            ALOGE("Invalid OWT type");
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
-        effectIndex = ch->type();
-
-        uint32_t freeBytes;
-        mHwApiDef->getOwtFreeSpace(&freeBytes);
-        if (ch->size() > freeBytes) {
-            ALOGE("Invalid OWT length: Effect %d: %zu > %d!", effectIndex, ch->size(), freeBytes);
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    int16_t preempted = -1;
+    int64_t preemptNs = 0;
+    PlaybackState::State state = mState.load();
+    if (state.phase == Phase::PLAYING && mIsPreemptionEnabled &&
+        mState.transition(&state, Phase::STOPPING)) {
+        preemptNs = Histogram::now();
+        ALOGD("Preempting effect %d with %d", state.effectIndex, effectIndex);
+        if (!stopEffect(state.effectIndex) || (mGPIOStatus && !mHwGPIO->setGPIOOutput(false))) {
+            mState.transition(&state, Phase::PLAYING);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
         }
-        if (mIsDual) {
-            mHwApiDual->getOwtFreeSpace(&freeBytes);
-            if (ch-> size() > freeBytes) {
-                ALOGE("Invalid OWT length in flip: Effect %d: %d > %d!", effectIndex,
-                      ch-> size(), freeBytes);
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        preempted = state.effectIndex;
+        // Taking over from it retires its completion, which may not see it
+        // stop before this effect starts.
+        if (!mState.transition(&state, Phase::UPLOADING, -1, state.playback + 1)) {
+            ALOGD("Effect %d cancelled before it started", effectIndex);
+            if (callback) {
+                dispatchComplete(callback);
             }
+            return ndk::ScopedAStatus::ok();
         }
+    } else {
+        // Only an effect still playing holds us up; the completion of one
+        // that was stopped carries on in the background.
+        do {
+            if (!mState.waitFor([](auto &s) { return s.phase == Phase::IDLE; },
+                                ASYNC_COMPLETION_TIMEOUT, &state)) {
+                ALOGE("Previous vibration pending: prev: %d, curr: %d", state.effectIndex,
+                      effectIndex);
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+            }
+        } while (!mState.transition(&state, Phase::UPLOADING, -1, state.playback + 1));
+    }
+    // Either way, the previous playback is retired; its completion may still
+    // be waiting for it to stop.
+    mHwApiDef->wakePolls();
+    if (mIsDual) {
+        mHwApiDual->wakePolls();
+    }
 
-        int errorStatus;
-        if (mGPIOStatus && mIsDual) {
-            mFfEffects[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
-            mFfEffectsDual[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
-        } else {
-            ALOGD("Not dual haptics HAL and GPIO status fail");
-        }
+    // The effect preempted, or stopped by off() before its completion caught
+    // up, completes right here.
+    std::shared_ptr<IVibratorCallback> previous;
+    {
+        const std::scoped_lock<std::mutex> lock(mActiveCallback_mutex);
+        previous = std::move(mActiveCallback);
+    }
+    if (previous) {
+        ALOGD("Cancelled effect %d", preempted);
+        dispatchComplete(previous);
+        previous = nullptr;
+    }
 
-        if (!mHwApiDef->uploadOwtEffect(mInputFd, ch->front(), ch->size(), &mFfEffects[effectIndex],
-                                        &effectIndex, &errorStatus)) {
-            ALOGE("Invalid uploadOwtEffect");
-            return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+    // Should it evict, uploading waits for the effect preempted to stop, but
+    // no longer than STOP_TIMEOUT_MS; it fails rather than wait longer.
+    ndk::ScopedAStatus status = prepareEffect(timeoutMs, &effectIndex, ch, preempted);
+    if (!status.isOk()) {
+        mState.transition(&state, Phase::IDLE);
+        return status;
+    }
+    // off() may have cancelled it meanwhile.
+    if (!mState.transition(&state, Phase::ARMED, effectIndex, state.playback)) {
+        ALOGD("Effect %d cancelled before it started", effectIndex);
+        if (callback) {
+            dispatchComplete(callback);
         }
-        if (mIsDual && !mHwApiDual->uploadOwtEffect(mInputFdDual, ch->front(), ch->size(),
-                                                    &mFfEffectsDual[effectIndex], &effectIndex,
-                                                    &errorStatus)) {
-            ALOGE("Invalid uploadOwtEffect in flip");
-            return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+        return ndk::ScopedAStatus::ok();
+    }
+
+    status = startEffect(effectIndex);
+    if (!status.isOk()) {
+        mState.transition(&state, Phase::IDLE);
+        return status;
+    }
+    {
+        const std::scoped_lock<std::mutex> lock(mActiveCallback_mutex);
+        mActiveCallback = callback;
+    }
+    if (!mState.transition(&state, Phase::PLAYING)) {
+        // off() came in while it was triggered and could not stop it yet.
+        ALOGD("Effect %d cancelled as it started", effectIndex);
+        stopEffect(effectIndex);
+        if (mGPIOStatus && !mHwGPIO->setGPIOOutput(false)) {
+            ALOGE("Failed to reset GPIO(%d): %s", errno, strerror(errno));
         }
+    }
+    if (preemptNs) {
+        mPreemptionLatency.record(Histogram::now() - preemptNs);
+    }
+
+    // Either way, its completion cleans up after it.
+    mCompletionWorker.post(
+            [this, playback = state.playback, queued = std::move(queued)]() mutable {
+                waitForComplete(playback, std::move(queued));
+            });
+    ALOGD("Vibrator::on, set done.");
+    return ndk::ScopedAStatus::ok();
+}
 
-    } else if (effectIndex == WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX ||
-               effectIndex == WAVEFORM_LONG_VIBRATION_EFFECT_INDEX) {
+ndk::ScopedAStatus Vibrator::prepareEffect(uint32_t timeoutMs, uint32_t *effectIndex,
+                                           const DspMemChunk *ch, int16_t keep) {
+    if (ch) {
+        /* Upload OWT effect, leaving the preempted one resident: the DSP may
+         * still be winding it down. */
+        return prepareOwtEffect(ch, effectIndex, keep);
+    }
+    const uint32_t index = *effectIndex;
+    if (index == WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX ||
+        index == WAVEFORM_LONG_VIBRATION_EFFECT_INDEX) {
         /* Update duration for long/short vibration. */
-        mFfEffects[effectIndex].replay.length = static_cast<uint16_t>(timeoutMs);
+        const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+        mFfEffects[index].replay.length = static_cast<uint16_t>(timeoutMs);
         if (mGPIOStatus && mIsDual) {
-            mFfEffects[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
-            mFfEffectsDual[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
+            mFfEffects[index].trigger.button = GPIO_TRIGGER_CONFIG | index;
+            mFfEffectsDual[index].trigger.button = GPIO_TRIGGER_CONFIG | index;
         } else {
             ALOGD("Not dual haptics HAL and GPIO status fail");
         }
-        if (!mHwApiDef->setFFEffect(mInputFd, &mFfEffects[effectIndex],
+        if (!mHwApiDef->setFFEffect(mInputFd, &mFfEffects[index],
                                     static_cast<uint16_t>(timeoutMs))) {
-            ALOGE("Failed to edit effect %d (%d): %s", effectIndex, errno, strerror(errno));
+            ALOGE("Failed to edit effect %d (%d): %s", index, errno, strerror(errno));
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
         }
         if (mIsDual) {
-            mFfEffectsDual[effectIndex].replay.length = static_cast<uint16_t>(timeoutMs);
-            if (!mHwApiDual->setFFEffect(mInputFdDual, &mFfEffectsDual[effectIndex],
+            mFfEffectsDual[index].replay.length = static_cast<uint16_t>(timeoutMs);
+            if (!mHwApiDual->setFFEffect(mInputFdDual, &mFfEffectsDual[index],
                                          static_cast<uint16_t>(timeoutMs))) {
-                ALOGE("Failed to edit flip's effect %d (%d): %s", effectIndex, errno,
+                ALOGE("Failed to edit flip's effect %d (%d): %s", index, errno,
                       strerror(errno));
                 return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
             }
         }
+        if (mGPIOStatus && mIsDual) {
+            mGpiEffect = index;
+        }
     }
+    return ndk::ScopedAStatus::ok();
+}
 
-    {
-        const std::scoped_lock<std::mutex> lock(mActiveId_mutex);
-        /* Play the event now. */
-        mActiveId = effectIndex;
-        if (!mGPIOStatus) {
-            ALOGE("GetVibrator: GPIO status error");
-            // Do playcode to play effect
-            if (!mHwApiDef->setFFPlay(mInputFd, effectIndex, true)) {
-                ALOGE("Failed to play effect %d (%d): %s", effectIndex, errno, strerror(errno));
-                mActiveId = -1;
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-            }
-            if (mIsDual && !mHwApiDual->setFFPlay(mInputFdDual, effectIndex, true)) {
-                ALOGE("Failed to play flip's effect %d (%d): %s", effectIndex, errno,
-                      strerror(errno));
-                mActiveId = -1;
+ndk::ScopedAStatus Vibrator::startEffect(uint32_t effectIndex) {
+    /* Play the event now. */
+    if (!mGPIOStatus) {
+        ALOGE("GetVibrator: GPIO status error");
+        // Do playcode to play effect
+        HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
+        if (!mHwApiDef->setFFPlay(mInputFd, effectIndex, true)) {
+            ALOGE("Failed to play effect %d (%d): %s", effectIndex, errno, strerror(errno));
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+        if (mIsDual && !mHwApiDual->setFFPlay(mInputFdDual, effectIndex, true)) {
+            ALOGE("Failed to play flip's effect %d (%d): %s", effectIndex, errno, strerror(errno));
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+        if (!batch.submit()) {
+            ALOGE("Failed to play effect %d", effectIndex);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        }
+    } else {
+        // Using GPIO to play effect
+        if ((effectIndex == WAVEFORM_CLICK_INDEX || effectIndex == WAVEFORM_LIGHT_TICK_INDEX)) {
+            const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+            mFfEffects[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
+            if (!mHwApiDef->setFFEffect(mInputFd, &mFfEffects[effectIndex],
+                                        mFfEffects[effectIndex].replay.length)) {
+                ALOGE("Failed to edit effect %d (%d): %s", effectIndex, errno, strerror(errno));
                 return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
             }
-        } else {
-            // Using GPIO to play effect
-            if ((effectIndex == WAVEFORM_CLICK_INDEX || effectIndex == WAVEFORM_LIGHT_TICK_INDEX)) {
-                mFfEffects[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
-                if (!mHwApiDef->setFFEffect(mInputFd, &mFfEffects[effectIndex],
-                                            mFfEffects[effectIndex].replay.length)) {
-                    ALOGE("Failed to edit effect %d (%d): %s", effectIndex, errno, strerror(errno));
+            if (mIsDual) {
+                mFfEffectsDual[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
+                if (!mHwApiDual->setFFEffect(mInputFdDual, &mFfEffectsDual[effectIndex],
+                                             mFfEffectsDual[effectIndex].replay.length)) {
+                    ALOGE("Failed to edit flip's effect %d (%d): %s", effectIndex, errno,
+                          strerror(errno));
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
                 }
-                if (mIsDual) {
-                    mFfEffectsDual[effectIndex].trigger.button = GPIO_TRIGGER_CONFIG | effectIndex;
-                    if (!mHwApiDual->setFFEffect(mInputFdDual, &mFfEffectsDual[effectIndex],
-                                                 mFfEffectsDual[effectIndex].replay.length)) {
-                        ALOGE("Failed to edit flip's effect %d (%d): %s", effectIndex, errno,
-                              strerror(errno));
-                        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-                    }
-                }
-            }
-            if (!mHwGPIO->setGPIOOutput(true)) {
-                ALOGE("Failed to trigger effect %d (%d) by GPIO: %s", effectIndex, errno,
-                      strerror(errno));
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
             }
+            mGpiEffect = effectIndex;
+        }
+        if (!mHwGPIO->setGPIOOutput(true)) {
+            ALOGE("Failed to trigger effect %d (%d) by GPIO: %s", effectIndex, errno,
+                  strerror(errno));
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
         }
     }
-
-    mAsyncHandle = std::async(&Vibrator::waitForComplete, this, callback);
-    ALOGD("Vibrator::on, set done.");
     return ndk::ScopedAStatus::ok();
 }
 
+bool Vibrator::stopEffect(int16_t effectIndex) {
+    bool ret{true};
+    HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
+    if (!mHwApiDef->setFFPlay(mInputFd, effectIndex, false)) {
+        ALOGE("Failed to stop effect %d (%d): %s", effectIndex, errno, strerror(errno));
+        ret = false;
+    }
+    if (mIsDual && (!mHwApiDual->setFFPlay(mInputFdDual, effectIndex, false))) {
+        ALOGE("Failed to stop flip's effect %d (%d): %s", effectIndex, errno, strerror(errno));
+        ret = false;
+    }
+    if (!batch.submit()) {
+        ALOGE("Failed to stop effect %d", effectIndex);
+        ret = false;
+    }
+    return ret;
+}
+
 ndk::ScopedAStatus Vibrator::setEffectAmplitude(float amplitude, float maximum) {
     uint16_t scale = amplitudeToScale(amplitude, maximum);
+    HwApiBatch batch(mHwApiDef.get(), mIsDual ? mHwApiDual.get() : nullptr);
     if (!mHwApiDef->setFFGain(mInputFd, scale)) {
         ALOGE("Failed to set the gain to %u (%d): %s", scale, errno, strerror(errno));
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -1104,6 +1357,10 @@ ndk::ScopedAStatus Vibrator::setEffectAmplitude(float amplitude, float maximum)
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
         }
     }
+    if (!batch.submit()) {
+        ALOGE("Failed to set the gain to %u", scale);
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
@@ -1129,6 +1386,9 @@ ndk::ScopedAStatus Vibrator::alwaysOnDisable(int32_t /*id*/) {
 }
 
 ndk::ScopedAStatus Vibrator::getResonantFrequency(float *resonantFreqHz) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     std::string caldata{8, '0'};
     if (!mHwCalDef->getF0(&caldata)) {
         ALOGE("Failed to get resonant frequency (%d): %s", errno, strerror(errno));
@@ -1140,6 +1400,9 @@ ndk::ScopedAStatus Vibrator::getResonantFrequency(float *resonantFreqHz) {
 }
 
 ndk::ScopedAStatus Vibrator::getQFactor(float *qFactor) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     std::string caldata{8, '0'};
     if (!mHwCalDef->getQ(&caldata)) {
         ALOGE("Failed to get q factor (%d): %s", errno, strerror(errno));
@@ -1151,6 +1414,9 @@ ndk::ScopedAStatus Vibrator::getQFactor(float *qFactor) {
 }
 
 ndk::ScopedAStatus Vibrator::getFrequencyResolution(float *freqResolutionHz) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_FREQUENCY_CONTROL) {
@@ -1162,6 +1428,9 @@ ndk::ScopedAStatus Vibrator::getFrequencyResolution(float *freqResolutionHz) {
 }
 
 ndk::ScopedAStatus Vibrator::getFrequencyMinimum(float *freqMinimumHz) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_FREQUENCY_CONTROL) {
@@ -1173,12 +1442,13 @@ ndk::ScopedAStatus Vibrator::getFrequencyMinimum(float *freqMinimumHz) {
 }
 
 ndk::ScopedAStatus Vibrator::getBandwidthAmplitudeMap(std::vector<float> *_aidl_return) {
-    // TODO(b/170919640): complete implementation
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_FREQUENCY_CONTROL) {
-        std::vector<float> bandwidthAmplitudeMap(PWLE_BW_MAP_SIZE, 1.0);
-        *_aidl_return = bandwidthAmplitudeMap;
+        *_aidl_return = mBandwidthAmplitudeMap;
         return ndk::ScopedAStatus::ok();
     } else {
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
@@ -1186,6 +1456,9 @@ ndk::ScopedAStatus Vibrator::getBandwidthAmplitudeMap(std::vector<float> *_aidl_
 }
 
 ndk::ScopedAStatus Vibrator::getPwlePrimitiveDurationMax(int32_t *durationMs) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_COMPOSE_PWLE_EFFECTS) {
@@ -1197,10 +1470,13 @@ ndk::ScopedAStatus Vibrator::getPwlePrimitiveDurationMax(int32_t *durationMs) {
 }
 
 ndk::ScopedAStatus Vibrator::getPwleCompositionSizeMax(int32_t *maxSize) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_COMPOSE_PWLE_EFFECTS) {
-        *maxSize = COMPOSE_PWLE_SIZE_MAX_DEFAULT;
+        *maxSize = COMPOSE_PWLE_STREAM_SIZE_MAX;
         return ndk::ScopedAStatus::ok();
     } else {
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
@@ -1208,6 +1484,9 @@ ndk::ScopedAStatus Vibrator::getPwleCompositionSizeMax(int32_t *maxSize) {
 }
 
 ndk::ScopedAStatus Vibrator::getSupportedBraking(std::vector<Braking> *supported) {
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
     Vibrator::getCapabilities(&capabilities);
     if (capabilities & IVibrator::CAP_COMPOSE_PWLE_EFFECTS) {
@@ -1227,13 +1506,12 @@ static void resetPreviousEndAmplitudeEndFrequency(float *prevEndAmplitude,
     *prevEndFrequency = reset;
 }
 
-static void incrementIndex(int *index) {
-    *index += 1;
-}
-
 ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &composite,
                                          const std::shared_ptr<IVibratorCallback> &callback) {
     ATRACE_NAME("Vibrator::composePwle");
+    if (!waitForReady()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     int32_t capabilities;
 
     Vibrator::getCapabilities(&capabilities);
@@ -1241,23 +1519,51 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
 
-    if (composite.empty() || composite.size() > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
+    if (composite.empty() || composite.size() > COMPOSE_PWLE_STREAM_SIZE_MAX) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
 
+    EffectCache::Key key;
+    key << WAVEFORM_PWLE << mCalibrationGeneration.load();
+    for (auto &e : composite) {
+        key << e.getTag();
+        if (e.getTag() == PrimitivePwle::active) {
+            auto &active = e.get<PrimitivePwle::active>();
+            key << active.startAmplitude << active.startFrequency << active.endAmplitude
+                << active.endFrequency << active.duration;
+        } else {
+            auto &braking = e.get<PrimitivePwle::braking>();
+            key << braking.braking << braking.duration;
+        }
+    }
+    if (auto cached = mEffectCache.find(key)) {
+        return performEffect(WAVEFORM_MAX_INDEX /*ignored*/, VOLTAGE_SCALE_MAX /*ignored*/,
+                             cached->ch.get(), callback);
+    }
+
+    EffectPlan plan(OWT_STREAM_SEGMENTS_MAX, MIN_ON_OFF_INTERVAL_US);
+    ndk::ScopedAStatus status = planPwle(composite, &plan);
+    if (!status.isOk()) {
+        return status;
+    }
+    return performPlan(plan, &key, callback);
+}
+
+ndk::ScopedAStatus Vibrator::planPwle(const std::vector<PrimitivePwle> &composite,
+                                      EffectPlan *outPlan) {
     std::vector<Braking> supported;
     Vibrator::getSupportedBraking(&supported);
     bool isClabSupported =
             std::find(supported.begin(), supported.end(), Braking::CLAB) != supported.end();
 
-    int segmentIdx = 0;
-    uint32_t totalDuration = 0;
     float prevEndAmplitude;
     float prevEndFrequency;
     resetPreviousEndAmplitudeEndFrequency(&prevEndAmplitude, &prevEndFrequency);
-    DspMemChunk ch(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE);
+    std::vector<PwleSection> sections;
+    PwleSection section;
     bool chirp = false;
 
+    sections.reserve(composite.size() * 2);
     for (auto &e : composite) {
         switch (e.getTag()) {
             case PrimitivePwle::active: {
@@ -1287,25 +1593,24 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
 
                 if (!((active.startAmplitude == prevEndAmplitude) &&
                       (active.startFrequency == prevEndFrequency))) {
-                    if (ch.constructActiveSegment(0, active.startAmplitude, active.startFrequency,
-                                                  false) < 0) {
+                    if (makeActiveSection(0, active.startAmplitude, active.startFrequency, false,
+                                          &section) < 0) {
                         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                     }
-                    incrementIndex(&segmentIdx);
+                    sections.push_back(section);
                 }
 
                 if (active.startFrequency != active.endFrequency) {
                     chirp = true;
                 }
-                if (ch.constructActiveSegment(active.duration, active.endAmplitude,
-                                              active.endFrequency, chirp) < 0) {
+                if (makeActiveSection(active.duration, active.endAmplitude, active.endFrequency,
+                                      chirp, &section) < 0) {
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                 }
-                incrementIndex(&segmentIdx);
+                sections.push_back(section);
 
                 prevEndAmplitude = active.endAmplitude;
                 prevEndFrequency = active.endFrequency;
-                totalDuration += active.duration;
                 chirp = false;
                 break;
             }
@@ -1321,49 +1626,26 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                 }
 
-                if (ch.constructBrakingSegment(0, braking.braking) < 0) {
+                if (makeBrakingSection(0, braking.braking, &section) < 0) {
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                 }
-                incrementIndex(&segmentIdx);
+                sections.push_back(section);
 
-                if (ch.constructBrakingSegment(braking.duration, braking.braking) < 0) {
+                if (makeBrakingSection(braking.duration, braking.braking, &section) < 0) {
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                 }
-                incrementIndex(&segmentIdx);
+                sections.push_back(section);
 
                 resetPreviousEndAmplitudeEndFrequency(&prevEndAmplitude, &prevEndFrequency);
-                totalDuration += braking.duration;
                 break;
             }
         }
-
-        if (segmentIdx > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
-            ALOGE("Too many PrimitivePwle section!");
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
-    }
-    ch.flush();
-
-    /* Update wlength */
-    totalDuration += MAX_COLD_START_LATENCY_MS;
-    if (totalDuration > 0x7FFFF) {
-        ALOGE("Total duration is too long (%d)!", totalDuration);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    }
-
-    if (ch.updateWLength(totalDuration) < 0) {
-        ALOGE("%s: Failed to update the waveform length length", __func__);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
 
-    /* Update nsections */
-    if (ch.updateNSection(segmentIdx) < 0) {
-        ALOGE("%s: Failed to update the section count", __func__);
+    if (outPlan->setPwle(std::move(sections)) < 0) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
-
-    return performEffect(WAVEFORM_MAX_INDEX /*ignored*/, VOLTAGE_SCALE_MAX /*ignored*/, &ch,
-                         callback);
+    return ndk::ScopedAStatus::ok();
 }
 
 bool Vibrator::isUnderExternalControl() {
@@ -1383,6 +1665,59 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
 
     dprintf(fd, "AIDL:\n");
 
+    {
+        const std::scoped_lock<std::mutex> lock(mReadyMutex);
+        dprintf(fd, "  Startup (ms):%s\n", mReady ? "" : " initializing");
+        for (auto &phase : mStartup) {
+            dprintf(fd, "    %s: %.1f\n", phase.name, phase.durationNs / 1e6);
+        }
+    }
+    if (!mReady) {
+        // the effect tables are still being filled in
+        fsync(fd);
+        return STATUS_OK;
+    }
+
+    dprintf(fd,
+            "  Preemption: %s cancelled: %" PRIu64
+            " latency (us): p50=%.1f p90=%.1f p99=%.1f max=%.1f\n",
+            mIsPreemptionEnabled ? "enabled" : "disabled", mPreemptionLatency.count(),
+            mPreemptionLatency.percentile(0.50) / 1000.0,
+            mPreemptionLatency.percentile(0.90) / 1000.0,
+            mPreemptionLatency.percentile(0.99) / 1000.0, mPreemptionLatency.max() / 1000.0);
+    const PlaybackState::State playback = mState.load();
+    dprintf(fd, "  Playback: %s effect: %d for %.1f ms\n", PlaybackState::name(playback.phase),
+            playback.effectIndex, (Histogram::now() - mState.sinceNs()) / 1e6);
+    for (uint8_t i = 0; i < static_cast<uint8_t>(PlaybackState::Phase::COUNT); i++) {
+        const auto phase = static_cast<PlaybackState::Phase>(i);
+        const Histogram &duration = mState.duration(phase);
+        dprintf(fd,
+                "    %s (us): n=%" PRIu64 " p50=%.1f p90=%.1f p99=%.1f max=%.1f\n",
+                PlaybackState::name(phase), duration.count(), duration.percentile(0.50) / 1000.0,
+                duration.percentile(0.90) / 1000.0, duration.percentile(0.99) / 1000.0,
+                duration.max() / 1000.0);
+    }
+    dprintf(fd,
+            "  Timeline: scheduled: %zu fired: %" PRIu64
+            " error (us): p50=%.1f p90=%.1f p99=%.1f max=%.1f\n",
+            mTimeline.pending(), mTimeline.error().count(),
+            mTimeline.error().percentile(0.50) / 1000.0,
+            mTimeline.error().percentile(0.90) / 1000.0,
+            mTimeline.error().percentile(0.99) / 1000.0, mTimeline.error().max() / 1000.0);
+    dprintf(fd, "  Effect Cache: %zu/%zu hits: %" PRIu64 " misses: %" PRIu64 "\n",
+            mEffectCache.size(), mEffectCache.capacity(), mEffectCache.hits(),
+            mEffectCache.misses());
+    dprintf(fd, "  Chunk Pool: %zu/%zu free reuses: %" PRIu64 " heap allocations: %" PRIu64 "\n",
+            mChunkPool.available(), mChunkPool.capacity(), mChunkPool.reuses(),
+            mChunkPool.allocations());
+    {
+        const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+        dprintf(fd,
+                "  OWT Slots: %zu/%zu bytes: %zu hits: %" PRIu64 " misses: %" PRIu64
+                " evictions: %" PRIu64 "\n",
+                mOwtSlots.size(), OWT_SLOTS_MAX, mOwtSlots.bytes(), mOwtSlots.hits(),
+                mOwtSlots.misses(), mOwtSlots.evictions());
+    }
     dprintf(fd, "  F0 Offset: base: %" PRIu32 " flip: %" PRIu32 "\n", mF0Offset, mF0OffsetDual);
 
     dprintf(fd, "  Voltage Levels:\n");
@@ -1393,6 +1728,7 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
     dprintf(fd, "     Long Effect Min: %" PRIu32 " Max: %" PRIu32 "\n", mLongEffectVol[0],
             mLongEffectVol[1]);
 
+    const std::scoped_lock<std::mutex> owtLock(mOwtSlots_mutex);
     dprintf(fd, "  FF effect:\n");
     dprintf(fd, "    Physical waveform:\n");
     dprintf(fd, "==== Base ====\n\tId\tIndex\tt   ->\tt'\ttrigger button\n");
@@ -1412,38 +1748,35 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
         }
     }
 
+    // The templates do not keep the uploaded waveforms; show the resident
+    // copies instead.
     dprintf(fd, "Base: OWT waveform:\n");
     dprintf(fd, "\tId\tBytes\tData\tt\ttrigger button\n");
     for (effectId = WAVEFORM_MAX_PHYSICAL_INDEX; effectId < WAVEFORM_MAX_INDEX; effectId++) {
-        uint32_t numBytes = mFfEffects[effectId].u.periodic.custom_len * 2;
+        std::string_view waveform = mOwtSlots.waveform(mFfEffects[effectId].id);
         std::stringstream ss;
         ss << " ";
-        for (int i = 0; i < numBytes; i++) {
+        for (uint8_t byte : waveform) {
             ss << std::uppercase << std::setfill('0') << std::setw(2) << std::hex
-               << (uint16_t)(*(
-                          reinterpret_cast<uint8_t *>(mFfEffects[effectId].u.periodic.custom_data) +
-                          i))
-               << " ";
+               << (uint16_t)byte << " ";
         }
-        dprintf(fd, "\t%d\t%d\t{%s}\t%u\t%X\n", mFfEffects[effectId].id, numBytes, ss.str().c_str(),
-                mFfEffectsDual[effectId].replay.length, mFfEffects[effectId].trigger.button);
+        dprintf(fd, "\t%d\t%zu\t{%s}\t%u\t%X\n", mFfEffects[effectId].id, waveform.size(),
+                ss.str().c_str(), mFfEffects[effectId].replay.length,
+                mFfEffects[effectId].trigger.button);
     }
     if (mIsDual) {
         dprintf(fd, "Flip: OWT waveform:\n");
         dprintf(fd, "\tId\tBytes\tData\tt\ttrigger button\n");
         for (effectId = WAVEFORM_MAX_PHYSICAL_INDEX; effectId < WAVEFORM_MAX_INDEX; effectId++) {
-            uint32_t numBytes = mFfEffectsDual[effectId].u.periodic.custom_len * 2;
+            std::string_view waveform = mOwtSlots.waveform(mFfEffectsDual[effectId].id);
             std::stringstream ss;
             ss << " ";
-            for (int i = 0; i < numBytes; i++) {
+            for (uint8_t byte : waveform) {
                 ss << std::uppercase << std::setfill('0') << std::setw(2) << std::hex
-                   << (uint16_t)(*(reinterpret_cast<uint8_t *>(
-                                           mFfEffectsDual[effectId].u.periodic.custom_data) +
-                                   i))
-                   << " ";
+                   << (uint16_t)byte << " ";
             }
-            dprintf(fd, "\t%d\t%d\t{%s}\t%u\t%X\n", mFfEffectsDual[effectId].id, numBytes,
-                    ss.str().c_str(), mFfEffectsDual[effectId].replay.length,
+            dprintf(fd, "\t%d\t%zu\t{%s}\t%u\t%X\n", mFfEffectsDual[effectId].id,
+                    waveform.size(), ss.str().c_str(), mFfEffectsDual[effectId].replay.length,
                     mFfEffectsDual[effectId].trigger.button);
         }
     }
@@ -1470,6 +1803,7 @@ bool Vibrator::hasHapticAlsaDevice() {
     // We need to call findHapticAlsaDevice once only. Calling in the
     // constructor is too early in the boot process and the pcm file contents
     // are empty. Hence we make the call here once only right before we need to.
+    const std::scoped_lock<std::mutex> lock(mHapticAlsaDevice_mutex);
     if (!mConfigHapticAlsaDeviceDone) {
         if (mHwApiDef->getHapticAlsaDevice(&mCard, &mDevice)) {
             mHasHapticAlsaDevice = true;
@@ -1484,10 +1818,8 @@ bool Vibrator::hasHapticAlsaDevice() {
 }
 
 ndk::ScopedAStatus Vibrator::getSimpleDetails(Effect effect, EffectStrength strength,
-                                              uint32_t *outEffectIndex, uint32_t *outTimeMs,
-                                              uint32_t *outVolLevel) {
+                                              EffectPlan *outPlan) {
     uint32_t effectIndex;
-    uint32_t timeMs;
     float intensity;
     uint32_t volLevel;
     switch (strength) {
@@ -1530,64 +1862,55 @@ ndk::ScopedAStatus Vibrator::getSimpleDetails(Effect effect, EffectStrength stre
     }
 
     volLevel = intensityToVolLevel(intensity, effectIndex);
-    timeMs = mEffectDurations[effectIndex] + MAX_COLD_START_LATENCY_MS;
 
-    *outEffectIndex = effectIndex;
-    *outTimeMs = timeMs;
-    *outVolLevel = volLevel;
+    outPlan->setEffect(effectIndex, volLevel, mEffectDurations[effectIndex]);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::getCompoundDetails(Effect effect, EffectStrength strength,
-                                                uint32_t *outTimeMs, DspMemChunk *outCh) {
-    ndk::ScopedAStatus status;
-    uint32_t timeMs = 0;
-    uint32_t thisEffectIndex;
-    uint32_t thisTimeMs;
-    uint32_t thisVolLevel;
+                                                EffectPlan *outPlan) {
     switch (effect) {
-        case Effect::DOUBLE_CLICK:
-            status = getSimpleDetails(Effect::CLICK, strength, &thisEffectIndex, &thisTimeMs,
-                                      &thisVolLevel);
-            if (!status.isOk()) {
-                return status;
-            }
-            timeMs += thisTimeMs;
-            outCh->constructComposeSegment(thisVolLevel, thisEffectIndex, 0 /*repeat*/, 0 /*flags*/,
-                                           WAVEFORM_DOUBLE_CLICK_SILENCE_MS);
-
-            timeMs += WAVEFORM_DOUBLE_CLICK_SILENCE_MS + MAX_PAUSE_TIMING_ERROR_MS;
-
-            status = getSimpleDetails(Effect::HEAVY_CLICK, strength, &thisEffectIndex, &thisTimeMs,
-                                      &thisVolLevel);
-            if (!status.isOk()) {
-                return status;
+        case Effect::DOUBLE_CLICK: {
+            auto it = mDoubleClick.find(strength);
+            if (it == mDoubleClick.end()) {
+                return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
             }
-            timeMs += thisTimeMs;
-
-            outCh->constructComposeSegment(thisVolLevel, thisEffectIndex, 0 /*repeat*/, 0 /*flags*/,
-                                           0 /*delay*/);
-            outCh->flush();
-            if (outCh->updateNSection(2) < 0) {
-                ALOGE("%s: Failed to update the section count", __func__);
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-            }
-
+            outPlan->setChunk(it->second.ch.get(), it->second.timeMs);
             break;
+        }
         default:
             return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
 
-    *outTimeMs = timeMs;
-    // Compositions should have 0 duration
-    mFfEffects[WAVEFORM_COMPOSE].replay.length = 0;
-    if (mIsDual) {
-        mFfEffectsDual[WAVEFORM_COMPOSE].replay.length = 0;
-    }
-
     return ndk::ScopedAStatus::ok();
 }
 
+void Vibrator::prepareCompoundEffects() {
+    for (auto strength : {EffectStrength::LIGHT, EffectStrength::MEDIUM, EffectStrength::STRONG}) {
+        EffectPlan click, heavyClick, doubleClick;
+
+        if (!getSimpleDetails(Effect::CLICK, strength, &click).isOk() ||
+            !getSimpleDetails(Effect::HEAVY_CLICK, strength, &heavyClick).isOk()) {
+            continue;
+        }
+        const uint32_t volLevels[] = {click.volLevel(), heavyClick.volLevel()};
+        if (volLevels[0] > VOLTAGE_SCALE_MAX || volLevels[1] > VOLTAGE_SCALE_MAX) {
+            ALOGE("%s: Invalid volume levels: %u, %u", __func__, volLevels[0], volLevels[1]);
+            continue;
+        }
+        // Times the image as the composition it was encoded from.
+        if (doubleClick.setCompose({{static_cast<uint8_t>(volLevels[0]), WAVEFORM_CLICK_INDEX, 0,
+                                     static_cast<uint16_t>(WAVEFORM_DOUBLE_CLICK_SILENCE_MS)},
+                                    {static_cast<uint8_t>(volLevels[1]), WAVEFORM_CLICK_INDEX, 0,
+                                     0}},
+                                   mEffectDurations) < 0) {
+            continue;
+        }
+        mDoubleClick[strength] = {std::make_unique<DspMemChunk>(DOUBLE_CLICK_IMAGE, volLevels),
+                                  doubleClick.durationMs()};
+    }
+}
+
 ndk::ScopedAStatus Vibrator::getPrimitiveDetails(CompositePrimitive primitive,
                                                  uint32_t *outEffectIndex) {
     uint32_t effectIndex;
@@ -1632,14 +1955,8 @@ ndk::ScopedAStatus Vibrator::getPrimitiveDetails(CompositePrimitive primitive,
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::performEffect(Effect effect, EffectStrength strength,
-                                           const std::shared_ptr<IVibratorCallback> &callback,
-                                           int32_t *outTimeMs) {
-    ndk::ScopedAStatus status;
-    uint32_t effectIndex;
-    uint32_t timeMs = 0;
-    uint32_t volLevel;
-    std::optional<DspMemChunk> maybeCh;
+ndk::ScopedAStatus Vibrator::planEffect(Effect effect, EffectStrength strength,
+                                        EffectPlan *outPlan) {
     switch (effect) {
         case Effect::TEXTURE_TICK:
             // fall-through
@@ -1648,96 +1965,247 @@ ndk::ScopedAStatus Vibrator::performEffect(Effect effect, EffectStrength strengt
         case Effect::CLICK:
             // fall-through
         case Effect::HEAVY_CLICK:
-            status = getSimpleDetails(effect, strength, &effectIndex, &timeMs, &volLevel);
-            break;
+            return getSimpleDetails(effect, strength, outPlan);
         case Effect::DOUBLE_CLICK:
-            maybeCh.emplace(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
-            status = getCompoundDetails(effect, strength, &timeMs, &*maybeCh);
-            volLevel = VOLTAGE_SCALE_MAX;
-            break;
+            return getCompoundDetails(effect, strength, outPlan);
         default:
-            status = ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
-            break;
+            return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
+}
+
+ndk::ScopedAStatus Vibrator::performEffect(Effect effect, EffectStrength strength,
+                                           const std::shared_ptr<IVibratorCallback> &callback,
+                                           int32_t *outTimeMs) {
+    EffectPlan plan;
+    ndk::ScopedAStatus status = planEffect(effect, strength, &plan);
     if (status.isOk()) {
-        DspMemChunk *ch = maybeCh ? &*maybeCh : nullptr;
-        status = performEffect(effectIndex, volLevel, ch, callback);
+        status = performPlan(plan, nullptr, callback);
     }
 
-    *outTimeMs = timeMs;
+    *outTimeMs = plan.durationMs();
     return status;
 }
 
 ndk::ScopedAStatus Vibrator::performEffect(uint32_t effectIndex, uint32_t volLevel,
                                            const DspMemChunk *ch,
                                            const std::shared_ptr<IVibratorCallback> &callback) {
+    const std::scoped_lock<std::mutex> lock(mStart_mutex);
     setEffectAmplitude(volLevel, VOLTAGE_SCALE_MAX);
 
     return on(MAX_TIME_MS, effectIndex, ch, callback);
 }
 
-void Vibrator::waitForComplete(std::shared_ptr<IVibratorCallback> &&callback) {
-    ALOGD("waitForComplete: Callback status in waitForComplete(): callBack: %d",
-          (callback != nullptr));
-
-    // Bypass checking flip part's haptic state
-    if (!mHwApiDef->pollVibeState(VIBE_STATE_HAPTIC, POLLING_TIMEOUT)) {
-        ALOGD("Failed to get state \"Haptic\"");
+ndk::ScopedAStatus Vibrator::performPlan(const EffectPlan &plan, EffectCache::Key *key,
+                                         const std::shared_ptr<IVibratorCallback> &callback) {
+    switch (plan.kind()) {
+        case EffectPlan::Kind::EFFECT:
+            return performEffect(plan.effectIndex(), plan.volLevel(), nullptr, callback);
+        case EffectPlan::Kind::CHUNK:
+            return performEffect(WAVEFORM_MAX_INDEX /*ignored*/, VOLTAGE_SCALE_MAX, plan.chunk(),
+                                 callback);
+        case EffectPlan::Kind::COMPOSE:
+            // fall-through
+        case EffectPlan::Kind::PWLE: {
+            // Shared through the pool, and queued only when streamed, so a
+            // single waveform is played without touching the heap.
+            std::shared_ptr<const DspMemChunk> first =
+                    mChunkPool.makeShared<DspMemChunk>(plan.encode(0, &mChunkPool));
+            Segments queued;
+            for (size_t i = 1; i < plan.waveforms(); i++) {
+                queued.push_back(mChunkPool.makeShared<DspMemChunk>(plan.encode(i, &mChunkPool)));
+            }
+            if (key && queued.empty()) {
+                // The cache takes over the pooled buffer; nothing is copied.
+                mEffectCache.insert(std::move(*key), {first, plan.durationMs()});
+            }
+            return performSegments(first.get(), std::move(queued), callback);
+        }
+        default:
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+}
+
+ndk::ScopedAStatus Vibrator::performSegments(const DspMemChunk *first, Segments &&queued,
+                                             const std::shared_ptr<IVibratorCallback> &callback) {
+    const std::scoped_lock<std::mutex> lock(mStart_mutex);
+    setEffectAmplitude(VOLTAGE_SCALE_MAX, VOLTAGE_SCALE_MAX);
 
-    mHwApiDef->pollVibeState(VIBE_STATE_STOPPED);
+    return on(MAX_TIME_MS, WAVEFORM_MAX_INDEX /*ignored*/, first, callback, std::move(queued));
+}
+
+bool Vibrator::waitForErasable() {
     // Check flip's state after base was done
-    if (mIsDual) {
-        mHwApiDual->pollVibeState(VIBE_STATE_STOPPED);
+    if (!mHwApiDef->pollVibeState(VIBE_STATE_STOPPED, STOP_TIMEOUT_MS) ||
+        (mIsDual && !mHwApiDual->pollVibeState(VIBE_STATE_STOPPED, STOP_TIMEOUT_MS))) {
+        ALOGE("Not erasing effects before the chip stopped (%d): %s", errno, strerror(errno));
+        return false;
     }
-    ALOGD("waitForComplete: get STOP");
-    {
-        const std::scoped_lock<std::mutex> lock(mActiveId_mutex);
-        if (mActiveId >= WAVEFORM_MAX_PHYSICAL_INDEX) {
-            if (!mHwApiDef->eraseOwtEffect(mInputFd, mActiveId, &mFfEffects)) {
-                ALOGE("Failed to clean up the composed effect %d", mActiveId);
+    return true;
+}
+
+bool Vibrator::waitForStopped(uint32_t playback) {
+    // A later effect may retire this playback before its stop shows; don't
+    // hold up the completions queued behind this one until that one stops.
+    // on() wakes the wait once it retired it.
+    auto retired = [this, playback] { return mState.load().playback != playback; };
+    auto waitFor = [&](HwApi *hwApi) {
+        for (int retries = 0;; retries++) {
+            if (hwApi->pollVibeState(VIBE_STATE_STOPPED, -1, retired)) {
+                return true;
             }
-            if (mIsDual &&
-                (!mHwApiDual->eraseOwtEffect(mInputFdDual, mActiveId, &mFfEffectsDual))) {
-                ALOGE("Failed to clean up flip's composed effect %d", mActiveId);
+            if (retired()) {
+                return false;
+            }
+            ALOGE("Failed to poll for state \"Stopped\" (%d): %s", errno, strerror(errno));
+            // Should reading the state keep failing, carry on as if it stopped.
+            if (retries == POLLING_RETRIES_MAX) {
+                return true;
             }
-        } else {
-            ALOGD("waitForComplete: Vibrator is already off");
         }
-        mActiveId = -1;
-        if (mGPIOStatus && !mHwGPIO->setGPIOOutput(false)) {
-            ALOGE("waitForComplete: Failed to reset GPIO(%d): %s", errno, strerror(errno));
-        }
-        // Do waveform number checking
-        uint32_t effectCount = WAVEFORM_MAX_PHYSICAL_INDEX;
-        mHwApiDef->getEffectCount(&effectCount);
-        if (effectCount > WAVEFORM_MAX_PHYSICAL_INDEX) {
-            // Forcibly clean all OWT waveforms
-            if (!mHwApiDef->eraseOwtEffect(mInputFd, WAVEFORM_MAX_INDEX, &mFfEffects)) {
-                ALOGE("Failed to clean up all base's composed effect");
+    };
+
+    // Check flip's state after base was done
+    return waitFor(mHwApiDef.get()) && (!mIsDual || waitFor(mHwApiDual.get()));
+}
+
+void Vibrator::waitForComplete(uint32_t playback, Segments &&queued) {
+    using Phase = PlaybackState::Phase;
+    std::shared_ptr<IVibratorCallback> callback;
+    PlaybackState::State state;
+    auto next = queued.begin();
+    bool playing = true;
+
+    while (playing) {
+        playing = false;
+        // Bypass checking flip part's haptic state
+        if (!mHwApiDef->pollVibeState(VIBE_STATE_HAPTIC, POLLING_TIMEOUT)) {
+            if (errno == ETIMEDOUT) {
+                ALOGD("Failed to get state \"Haptic\"");
+            } else {
+                ALOGE("Failed to poll for state \"Haptic\" (%d): %s", errno, strerror(errno));
             }
         }
 
-        if (mIsDual) {
-            // Forcibly clean all OWT waveforms
-            effectCount = WAVEFORM_MAX_PHYSICAL_INDEX;
-            mHwApiDual->getEffectCount(&effectCount);
-            if ((effectCount > WAVEFORM_MAX_PHYSICAL_INDEX) &&
-                (!mHwApiDual->eraseOwtEffect(mInputFdDual, WAVEFORM_MAX_INDEX, &mFfEffectsDual))) {
-                ALOGE("Failed to clean up all flip's composed effect");
+        // Upload the next segment while this one plays, so that only the
+        // driver's minimum off time, MIN_ON_OFF_INTERVAL_US, separates them.
+        // Evicting erases effects, which the driver only allows once the chip
+        // stopped; a segment that only fits by evicting is uploaded then.
+        uint32_t nextIndex = 0;
+        bool hasNext = false;
+        bool prefetched = false;
+        if (next != queued.end()) {
+            state = mState.load();
+            hasNext = state.playback == playback && state.phase == Phase::PLAYING;
+            prefetched = hasNext &&
+                         prepareOwtEffect(next->get(), &nextIndex, state.effectIndex, false).isOk();
+        }
+
+        if (!waitForStopped(playback)) {
+            ALOGD("waitForComplete: retired before STOP");
+            break;
+        }
+        ALOGD("waitForComplete: get STOP");
+
+        state = mState.load();
+        if (hasNext && !prefetched && state.playback == playback &&
+            state.phase == Phase::PLAYING && !prepareOwtEffect(next->get(), &nextIndex).isOk()) {
+            ALOGE("waitForComplete: Failed to upload segment %zu",
+                  static_cast<size_t>(next - queued.begin()) + 1);
+            hasNext = false;
+        }
+        // off() moves it out of PLAYING, ending the stream.
+        if (hasNext && state.playback == playback && state.phase == Phase::PLAYING &&
+            mState.transition(&state, Phase::ARMED, nextIndex, playback)) {
+            if (mGPIOStatus && !mHwGPIO->setGPIOOutput(false)) {
+                ALOGE("waitForComplete: Failed to reset GPIO(%d): %s", errno, strerror(errno));
+            }
+            bool started = startEffect(nextIndex).isOk();
+            if (started && mState.transition(&state, Phase::PLAYING)) {
+                ++next;
+                playing = true;
+                continue;
+            }
+            if (started) {
+                // off() came in while it was triggered and could not stop it.
+                stopEffect(nextIndex);
+            } else {
+                ALOGE("waitForComplete: Failed to continue with segment %zu",
+                      static_cast<size_t>(next - queued.begin()) + 1);
+            }
+        }
+
+        // A later effect taking over the actuators cleans up after both.
+        while (state.playback == playback) {
+            // Let off(), or the next effect, finish stopping this one.
+            if (state.phase == Phase::STOPPING) {
+                mState.waitFor([](auto &s) { return s.phase != Phase::STOPPING; },
+                               ASYNC_COMPLETION_TIMEOUT, &state);
+                continue;
             }
+            if (!mState.transition(&state, Phase::CLEANUP)) {
+                continue;
+            }
+            // OWT effects stay resident for replay; see uploadOwtEffect().
+            if (mGPIOStatus && !mHwGPIO->setGPIOOutput(false)) {
+                ALOGE("waitForComplete: Failed to reset GPIO(%d): %s", errno, strerror(errno));
+            }
+            syncOwtSlots();
+            {
+                const std::scoped_lock<std::mutex> lock(mActiveCallback_mutex);
+                callback = std::move(mActiveCallback);
+            }
+            mState.transition(&state, Phase::IDLE);
+            break;
         }
     }
 
     if (callback) {
-        auto ret = callback->onComplete();
-        if (!ret.isOk()) {
-            ALOGE("Failed completion callback: %d", ret.getExceptionCode());
-        }
+        dispatchComplete(callback);
     }
     ALOGD("waitForComplete: Done.");
 }
 
+std::shared_ptr<const void> Vibrator::pinOwtEffect(const DspMemChunk *ch) {
+    const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+    uint64_t pin = mOwtSlots.pin({reinterpret_cast<const char *>(ch->front()), ch->size()});
+    if (!pin) {
+        return nullptr;
+    }
+    // Owns nothing; dropping the last copy unpins it.
+    return std::shared_ptr<const void>(nullptr, [this, pin](const void *) {
+        const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+        mOwtSlots.unpin(pin);
+    });
+}
+
+void Vibrator::syncOwtSlots() {
+    const std::scoped_lock<std::mutex> lock(mOwtSlots_mutex);
+    const uint32_t expected = WAVEFORM_MAX_PHYSICAL_INDEX + mOwtSlots.size();
+    uint32_t effectCount = expected;
+    uint32_t effectCountDual = expected;
+
+    // Do waveform number checking
+    mHwApiDef->getEffectCount(&effectCount);
+    if (mIsDual) {
+        mHwApiDual->getEffectCount(&effectCountDual);
+    }
+    if (effectCount == expected && effectCountDual == expected) {
+        return;
+    }
+
+    // The driver dropped resident waveforms, e.g. on a DSP reset, or holds
+    // ones we lost track of. Forcibly clean all OWT waveforms and start over.
+    ALOGW("OWT waveforms out of sync: resident: %zu base: %u flip: %u", mOwtSlots.size(),
+          effectCount, effectCountDual);
+    if (!mHwApiDef->flushOwtEffects(mInputFd, &mFfEffects)) {
+        ALOGE("Failed to clean up all base's composed effect");
+    }
+    if (mIsDual && !mHwApiDual->flushOwtEffects(mInputFdDual, &mFfEffectsDual)) {
+        ALOGE("Failed to clean up all flip's composed effect");
+    }
+    mOwtSlots.clear();
+}
+
 uint32_t Vibrator::intensityToVolLevel(float intensity, uint32_t effectIndex) {
     uint32_t volLevel;
     auto calc = [](float intst, std::array<uint32_t, 2> v) -> uint32_t {
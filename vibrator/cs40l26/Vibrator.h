@@ -21,8 +21,22 @@
 #include <tinyalsa/asoundlib.h>
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
 #include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "ChunkPool.h"
+#include "CompletionWorker.h"
+#include "EffectCache.h"
+#include "Histogram.h"
+#include "OwtSlots.h"
+#include "PlaybackState.h"
+#include "TimelineScheduler.h"
 
 namespace aidl {
 namespace android {
@@ -63,8 +77,13 @@ class Vibrator : public BnVibrator {
         // Reports the number of effect waveforms loaded in firmware.
         virtual bool getEffectCount(uint32_t *value) = 0;
         // Blocks until timeout or vibrator reaches desired state
-        // (2 = ASP enabled, 1 = haptic enabled, 0 = disabled).
-        virtual bool pollVibeState(uint32_t value, int32_t timeoutMs = -1) = 0;
+        // (2 = ASP enabled, 1 = haptic enabled, 0 = disabled), or until
+        // 'cancel', checked on wakePolls(), returns true. Fails with errno
+        // ETIMEDOUT on timeout and ECANCELED once cancelled.
+        virtual bool pollVibeState(uint32_t value, int32_t timeoutMs = -1,
+                                   const std::function<bool()> &cancel = nullptr) = 0;
+        // Has pollVibeState() callers check their 'cancel' again.
+        virtual void wakePolls() {}
         // Reports whether getOwtFreeSpace() is supported.
         virtual bool hasOwtFreeSpace() = 0;
         // Reports the available OWT bytes.
@@ -88,12 +107,24 @@ class Vibrator : public BnVibrator {
         // Set haptics PCM amplifier before triggering audio haptics feature
         virtual bool setHapticPcmAmp(struct pcm **haptic_pcm, bool enable, int card,
                                      int device) = 0;
-        // Set OWT waveform for compose or compose PWLE request
+        // Set OWT waveform for compose or compose PWLE request. 'owtData' is
+        // only referenced during the call.
         virtual bool uploadOwtEffect(int fd, const uint8_t *owtData, const uint32_t numBytes,
                                      struct ff_effect *effect, uint32_t *outEffectIndex,
                                      int *status) = 0;
-        // Erase OWT waveform
+        // Erase the OWT waveform held by effect 'effectIndex' only
         virtual bool eraseOwtEffect(int fd, int8_t effectIndex, std::vector<ff_effect> *effect) = 0;
+        // Erase every OWT waveform, e.g. once the driver lost track of them
+        virtual bool flushOwtEffects(int fd, std::vector<ff_effect> *effect) = 0;
+        // Starts collecting sysfs accesses and FF gain/play writes, so they
+        // can be sent to the kernel together by submitBatch(). Until then,
+        // they report success and values read are not yet available.
+        // Implementations without batching perform them immediately.
+        virtual void beginBatch() {}
+        // Sends the accesses collected since beginBatch() and waits for them.
+        // Returns false if any of them failed. Batches may nest, in which
+        // case only the outermost submitBatch() sends and reports anything.
+        virtual bool submitBatch() { return true; }
         // Emit diagnostic information to the given file.
         virtual void debug(int fd) = 0;
     };
@@ -131,6 +162,9 @@ class Vibrator : public BnVibrator {
         virtual bool isF0CompEnabled() = 0;
         // Checks if the redc compensation feature needs to be enabled.
         virtual bool isRedcCompEnabled() = 0;
+        // Checks if a new effect may stop the one playing instead of being
+        // rejected.
+        virtual bool isPreemptionEnabled() = 0;
         // Emit diagnostic information to the given file.
         virtual void debug(int fd) = 0;
     };
@@ -139,6 +173,15 @@ class Vibrator : public BnVibrator {
     Vibrator(std::unique_ptr<HwApi> hwApiDefault, std::unique_ptr<HwCal> hwCalDefault,
              std::unique_ptr<HwApi> hwApiDual, std::unique_ptr<HwCal> hwCalDual,
              std::unique_ptr<HwGPIO> hwgpio);
+    ~Vibrator();
+
+    // Brings up the hardware: input discovery, effect uploads, calibration and
+    // GPIO. Must be called once; until it finishes, binder calls wait for up
+    // to READY_TIMEOUT and then fail with EX_ILLEGAL_STATE.
+    void init();
+    // Runs init() on a background thread, so the service can be registered
+    // while the hardware is brought up.
+    void initAsync();
 
     // BnVibrator APIs
     ndk::ScopedAStatus getCapabilities(int32_t *_aidl_return) override;
@@ -177,68 +220,205 @@ class Vibrator : public BnVibrator {
 
     static constexpr uint32_t MIN_ON_OFF_INTERVAL_US = 8500;  // SVC initialization time
 
+    // Effect to play at a CLOCK_MONOTONIC time.
+    struct ScheduledEffect {
+        int64_t startNs;
+        Effect effect;
+        EffectStrength strength;
+    };
+    // Plays each of 'effects', sorted by start time, at its start time from
+    // the timeline thread, replacing the effects still scheduled. Waveforms
+    // are uploaded ahead of time. 'callback' completes after the last effect,
+    // or once it is dropped.
+    ndk::ScopedAStatus scheduleEffects(const std::vector<ScheduledEffect> &effects,
+                                       const std::shared_ptr<IVibratorCallback> &callback);
+    ndk::ScopedAStatus cancelScheduledEffects();
+
   private:
+    // OWT waveforms played back to back, for compositions too long for one.
+    using Segments = std::vector<std::shared_ptr<const class DspMemChunk>>;
+
+    // Plays 'ch', if given, or 'effectIndex', followed by every waveform in
+    // 'queued'. Must hold mStart_mutex.
     ndk::ScopedAStatus on(uint32_t timeoutMs, uint32_t effectIndex, const class DspMemChunk *ch,
-                          const std::shared_ptr<IVibratorCallback> &callback);
-    // set 'amplitude' based on an arbitrary scale determined by 'maximum'
+                          const std::shared_ptr<IVibratorCallback> &callback,
+                          Segments &&queued = {});
+    // Uploads 'ch', if given, or sets how long 'effectIndex' plays for, never
+    // evicting effect 'keep'. Sets '*effectIndex' to the effect to trigger.
+    ndk::ScopedAStatus prepareEffect(uint32_t timeoutMs, uint32_t *effectIndex,
+                                     const class DspMemChunk *ch, int16_t keep);
+    // Triggers 'effectIndex' on both actuators.
+    ndk::ScopedAStatus startEffect(uint32_t effectIndex);
+    // Stops 'effectIndex' on both actuators.
+    bool stopEffect(int16_t effectIndex);
+    // Looks up 'ch' among the resident waveforms or uploads it, never
+    // evicting effect 'keep', nor any effect unless 'evict'.
+    ndk::ScopedAStatus prepareOwtEffect(const class DspMemChunk *ch, uint32_t *outEffectIndex,
+                                        int16_t keep = -1, bool evict = true);
+    // Uploads 'ch' to both actuators, evicting resident waveforms other than
+    // 'keep' as needed if 'evict', and keeps it resident under
+    // '*outEffectIndex'.
+    ndk::ScopedAStatus uploadOwtEffect(const class DspMemChunk *ch, uint32_t *outEffectIndex,
+                                       int16_t keep, bool evict);
+    // Keeps 'ch', if it is resident, from being evicted until the returned
+    // pin is dropped.
+    std::shared_ptr<const void> pinOwtEffect(const class DspMemChunk *ch);
+    // Flushes all OWT waveforms if the driver's count disagrees with mOwtSlots.
+    void syncOwtSlots();
+    // set 'amplitude' based on an arbitrary scale determined by 'maximum'.
+    // Must hold mStart_mutex, as must every gain and f0_offset write.
     ndk::ScopedAStatus setEffectAmplitude(float amplitude, float maximum);
+    // Must hold mStart_mutex.
     ndk::ScopedAStatus setGlobalAmplitude(bool set);
     // 'simple' effects are those precompiled and loaded into the controller
     ndk::ScopedAStatus getSimpleDetails(Effect effect, EffectStrength strength,
-                                        uint32_t *outEffectIndex, uint32_t *outTimeMs,
-                                        uint32_t *outVolLevel);
+                                        class EffectPlan *outPlan);
     // 'compound' effects are those composed by stringing multiple 'simple' effects
     ndk::ScopedAStatus getCompoundDetails(Effect effect, EffectStrength strength,
-                                          uint32_t *outTimeMs, class DspMemChunk *outCh);
+                                          class EffectPlan *outPlan);
+    // Encodes the compound effects for every strength, once the calibration is
+    // loaded.
+    void prepareCompoundEffects();
     ndk::ScopedAStatus getPrimitiveDetails(CompositePrimitive primitive, uint32_t *outEffectIndex);
+    ndk::ScopedAStatus planEffect(Effect effect, EffectStrength strength,
+                                  class EffectPlan *outPlan);
     ndk::ScopedAStatus performEffect(Effect effect, EffectStrength strength,
                                      const std::shared_ptr<IVibratorCallback> &callback,
                                      int32_t *outTimeMs);
     ndk::ScopedAStatus performEffect(uint32_t effectIndex, uint32_t volLevel,
                                      const class DspMemChunk *ch,
                                      const std::shared_ptr<IVibratorCallback> &callback);
+    // Validate 'composite' and plan the waveforms playing it, without encoding
+    // anything.
+    ndk::ScopedAStatus planCompose(const std::vector<CompositeEffect> &composite,
+                                   class EffectPlan *outPlan);
+    ndk::ScopedAStatus planPwle(const std::vector<PrimitivePwle> &composite,
+                                class EffectPlan *outPlan);
+    // Encodes and plays 'plan', caching its waveform under 'key', if given,
+    // should it take only one.
+    ndk::ScopedAStatus performPlan(const class EffectPlan &plan, EffectCache::Key *key,
+                                   const std::shared_ptr<IVibratorCallback> &callback);
+    // Plays 'first', then each of 'queued' in turn.
+    ndk::ScopedAStatus performSegments(const class DspMemChunk *first, Segments &&queued,
+                                       const std::shared_ptr<IVibratorCallback> &callback);
     ndk::ScopedAStatus setPwle(const std::string &pwleQueue);
     bool isUnderExternalControl();
-    void waitForComplete(std::shared_ptr<IVibratorCallback> &&callback);
+    // Waits for 'playback' to stop, uploading each of 'queued' while its
+    // predecessor plays and triggering it as soon as that stops, then
+    // completes mActiveCallback. Runs on mCompletionWorker.
+    void waitForComplete(uint32_t playback, Segments &&queued);
+    // Waits up to STOP_TIMEOUT_MS for both actuators to stop, which erasing
+    // effects requires. Returns whether they did.
+    bool waitForErasable();
+    // Waits for both actuators to stop. Returns false as soon as a later
+    // effect retired 'playback' instead.
+    bool waitForStopped(uint32_t playback);
     uint32_t intensityToVolLevel(float intensity, uint32_t effectIndex);
     bool findHapticAlsaDevice(int *card, int *device);
     bool hasHapticAlsaDevice();
     bool enableHapticPcmAmp(struct pcm **haptic_pcm, bool enable, int card, int device);
+    // Uploads the physical effects and applies the calibration of one
+    // actuator. They run concurrently from init().
+    void initBase(bool uploadEffects);
+    void initFlip(bool uploadEffects);
+    // Models the bandwidth amplitude map on the calibrated LRA, falling back
+    // to a flat one if it was not calibrated.
+    void updateBandwidthAmplitudeMap(const class LraModel &lra, bool hasRedc);
+    // Appends the time since '*startNs' to the startup timeline as 'name' and
+    // moves '*startNs' to now.
+    void recordPhase(const char *name, int64_t *startNs);
+    // Returns false if init() has not finished within READY_TIMEOUT.
+    bool waitForReady();
 
     std::unique_ptr<HwApi> mHwApiDef;
     std::unique_ptr<HwCal> mHwCalDef;
     std::unique_ptr<HwApi> mHwApiDual;
     std::unique_ptr<HwCal> mHwCalDual;
     std::unique_ptr<HwGPIO> mHwGPIO;
+    // Set by init() and only read once mReady is set, so they need no locking.
     uint32_t mF0Offset;
     uint32_t mF0OffsetDual;
     std::array<uint32_t, 2> mTickEffectVol;
     std::array<uint32_t, 2> mClickEffectVol;
     std::array<uint32_t, 2> mLongEffectVol;
-    std::vector<ff_effect> mFfEffects;
-    std::vector<ff_effect> mFfEffectsDual;
     std::vector<uint32_t> mEffectDurations;
     std::vector<std::vector<int16_t>> mEffectCustomData;
     std::vector<std::vector<int16_t>> mEffectCustomDataDual;
-    std::future<void> mAsyncHandle;
     ::android::base::unique_fd mInputFd;
     ::android::base::unique_fd mInputFdDual;
-    int8_t mActiveId{-1};
-    struct pcm *mHapticPcm;
-    int mCard;
-    int mDevice;
-    bool mHasHapticAlsaDevice{false};
-    bool mIsUnderExternalControl;
-    float mLongEffectScale{1.0};
     bool mIsChirpEnabled;
     uint32_t mSupportedPrimitivesBits = 0x0;
     std::vector<CompositePrimitive> mSupportedPrimitives;
     std::vector<float> mPrimitiveMaxScale;
     std::vector<float> mPrimitiveMinScale;
-    bool mConfigHapticAlsaDeviceDone{false};
+    // Declared before the members holding its buffers, so it outlives them.
+    ChunkPool mChunkPool;
+    struct CompoundEffect {
+        std::unique_ptr<const class DspMemChunk> ch;
+        uint32_t timeMs;
+    };
+    std::map<EffectStrength, CompoundEffect> mDoubleClick;
+    // Built from the base actuator's calibration once it is applied.
+    std::vector<float> mBandwidthAmplitudeMap;
+    // Bumped whenever calibration is applied, retiring cached waveforms
+    // encoded with the previous one.
+    std::atomic<uint32_t> mCalibrationGeneration{0};
+    EffectCache mEffectCache;
     bool mGPIOStatus;
     bool mIsDual{false};
-    std::mutex mActiveId_mutex;  // protects mActiveId
+    // Whether on() stops the effect playing rather than waiting for it.
+    bool mIsPreemptionEnabled{false};
+    // protects mOwtSlots, mFfEffects, mFfEffectsDual and mGpiEffect
+    std::mutex mOwtSlots_mutex;
+    OwtSlots mOwtSlots;
+    // Effect the GPI trigger was last mapped to. Triggering by GPIO plays it,
+    // whichever effect was meant.
+    int16_t mGpiEffect{-1};
+    std::vector<ff_effect> mFfEffects;
+    std::vector<ff_effect> mFfEffectsDual;
+    std::mutex mHapticAlsaDevice_mutex;  // protects the ALSA device lookup below
+    int mCard;
+    int mDevice;
+    bool mHasHapticAlsaDevice{false};
+    bool mConfigHapticAlsaDeviceDone{false};
+    // Serializes setAmplitude() and setExternalControl(), keeping the global
+    // amplitude in line with the external control state. Taken before
+    // mStart_mutex.
+    std::mutex mExternalControl_mutex;  // protects mHapticPcm
+    struct pcm *mHapticPcm;
+    std::atomic<bool> mIsUnderExternalControl{false};
+    // Serializes starting effects, from setting their amplitude to triggering
+    // them, so that one caller's upload cannot evict the waveform another is
+    // about to trigger, nor off() or setAmplitude() rewrite the gain or
+    // f0_offset in between. Taken before mOwtSlots_mutex.
+    std::mutex mStart_mutex;  // protects mLongEffectScale
+    float mLongEffectScale{1.0};
+    // Where the effect playing is, moved along without any lock so that off()
+    // cancels, and status queries answer, without waiting on the ioctls of
+    // the one starting.
+    PlaybackState mState;
+    // Never held across ioctls.
+    std::mutex mActiveCallback_mutex;  // protects mActiveCallback
+    // Completed by the effect's completion, or by the next effect if that
+    // starts first.
+    std::shared_ptr<IVibratorCallback> mActiveCallback;
+    // From on() stopping the playing effect to starting its own.
+    Histogram mPreemptionLatency;
+    const int64_t mCreatedNs;
+    std::thread mInitThread;
+    std::mutex mReadyMutex;  // protects mStartup
+    std::condition_variable mReadyCondition;
+    std::atomic<bool> mReady{false};
+    struct StartupPhase {
+        const char *name;
+        int64_t durationNs;
+    };
+    std::vector<StartupPhase> mStartup;
+    // Declared after the members the completions use, so it finishes the
+    // ones still queued before those are destroyed.
+    CompletionWorker mCompletionWorker;
+    // Last, as the effects it fires use all of the above.
+    TimelineScheduler mTimeline;
 };
 
 }  // namespace vibrator
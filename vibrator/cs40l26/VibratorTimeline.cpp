@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VibratorTimeline.h"
+
+#include <utils/Trace.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+ndk::ScopedAStatus VibratorTimeline::schedule(const std::vector<ScheduledEffect> &effects,
+                                              const std::shared_ptr<IVibratorCallback> &callback) {
+    ATRACE_NAME("VibratorTimeline::schedule");
+    auto vibrator = mVibrator.lock();
+    if (!vibrator) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    std::vector<Vibrator::ScheduledEffect> scheduled;
+    scheduled.reserve(effects.size());
+    for (auto &e : effects) {
+        scheduled.push_back({e.startTimeNs, e.effect, e.strength});
+    }
+    return vibrator->scheduleEffects(scheduled, callback);
+}
+
+ndk::ScopedAStatus VibratorTimeline::cancel() {
+    auto vibrator = mVibrator.lock();
+    if (!vibrator) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    return vibrator->cancelScheduledEffects();
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/vendor/google/vibrator/BnVibratorTimeline.h>
+
+#include "Vibrator.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::aidl::vendor::google::vibrator::BnVibratorTimeline;
+using ::aidl::vendor::google::vibrator::ScheduledEffect;
+
+// IVibratorTimeline extension of a Vibrator, scheduling effects on it.
+class VibratorTimeline : public BnVibratorTimeline {
+  public:
+    explicit VibratorTimeline(const std::shared_ptr<Vibrator> &vibrator) : mVibrator(vibrator) {}
+
+    ndk::ScopedAStatus schedule(const std::vector<ScheduledEffect> &effects,
+                                const std::shared_ptr<IVibratorCallback> &callback) override;
+    ndk::ScopedAStatus cancel() override;
+
+  private:
+    // Weak, as the vibrator holds on to its extension.
+    const std::weak_ptr<Vibrator> mVibrator;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
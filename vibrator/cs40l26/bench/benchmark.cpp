@@ -0,0 +1,508 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <gmock/gmock.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "DspMemChunk.h"
+#include "FakeDevice.h"
+#include "Hardware.h"
+#include "mocks.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::android::base::unique_fd;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+// Fake sysfs trees for both actuators, placed on tmpfs when available. Input
+// devices are stood in for by /dev/null.
+class FakeSysfs {
+  public:
+    FakeSysfs() {
+        std::string base = std::getenv("HWAPI_BENCH_DIR") ?: "/dev/shm";
+        std::error_code ec;
+
+        if (!std::filesystem::is_directory(base, ec)) {
+            base = std::filesystem::temp_directory_path(ec);
+        }
+        mRoot = base + "/vibrator-bench-XXXXXX";
+        if (mkdtemp(mRoot.data()) == nullptr) {
+            ALOGE("Failed to create %s (%d): %s", mRoot.c_str(), errno, strerror(errno));
+            return;
+        }
+
+        for (auto actuator : {"def", "dual"}) {
+            for (auto name : {"default/f0_offset", "default/owt_free_space",
+                              "default/delay_before_stop_playback_us"}) {
+                auto path = std::filesystem::path(mRoot) / actuator / name;
+                std::filesystem::create_directories(path.parent_path(), ec);
+                std::ofstream{path} << 0 << std::endl;
+            }
+            std::ofstream{std::filesystem::path(mRoot) / actuator / "default/owt_free_space"}
+                    << 4096 << std::endl;
+        }
+
+        mInputFd.reset(::open("/dev/null", O_WRONLY | O_CLOEXEC));
+        mInputFdDual.reset(::open("/dev/null", O_WRONLY | O_CLOEXEC));
+    }
+
+    ~FakeSysfs() {
+        std::error_code ec;
+        std::filesystem::remove_all(mRoot, ec);
+    }
+
+    template <typename Api>
+    std::unique_ptr<Vibrator::HwApi> create(const char *actuator) {
+        setenv("HWAPI_PATH_PREFIX", (mRoot + "/" + actuator + "/").c_str(), true);
+        return Api::Create();
+    }
+
+    int inputFd() const { return mInputFd; }
+    int inputFdDual() const { return mInputFdDual; }
+
+  private:
+    std::string mRoot;
+    unique_fd mInputFd;
+    unique_fd mInputFdDual;
+};
+
+// Replays the HwApi accesses of a dual actuator OWT play and stop, batched
+// the way Vibrator does.
+template <typename Api>
+static void BM_DualPlay(benchmark::State &state) {
+    FakeSysfs device;
+    auto def = device.create<Api>("def");
+    auto dual = device.create<Api>("dual");
+    uint32_t offset = 0;
+
+    if (!def || !dual) {
+        state.SkipWithError("backend not available");
+        return;
+    }
+
+    for (auto _ : state) {
+        uint32_t freeBytes, freeBytesDual;
+        bool ret = true;
+
+        // alternate so the shadow registers never elide the writes
+        offset ^= 1;
+
+        def->beginBatch();
+        dual->beginBatch();
+        ret &= def->setFFGain(device.inputFd(), 80);
+        ret &= dual->setFFGain(device.inputFdDual(), 80);
+        ret &= def->setF0Offset(offset);
+        ret &= dual->setF0Offset(offset);
+        ret &= def->submitBatch() & dual->submitBatch();
+
+        def->beginBatch();
+        dual->beginBatch();
+        ret &= def->getOwtFreeSpace(&freeBytes);
+        ret &= dual->getOwtFreeSpace(&freeBytesDual);
+        ret &= def->submitBatch() & dual->submitBatch();
+
+        def->beginBatch();
+        dual->beginBatch();
+        ret &= def->setFFPlay(device.inputFd(), WAVEFORM_COMPOSE, true);
+        ret &= dual->setFFPlay(device.inputFdDual(), WAVEFORM_COMPOSE, true);
+        ret &= def->submitBatch() & dual->submitBatch();
+
+        if (!ret) {
+            state.SkipWithError("access failed");
+            break;
+        }
+        benchmark::DoNotOptimize(freeBytes);
+        benchmark::DoNotOptimize(freeBytesDual);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_DualPlay, HwApi);
+BENCHMARK_TEMPLATE(BM_DualPlay, HwApiUring);
+
+// Vibrator driving the real HwApi/HwCal classes against a FakeDevice.
+class FakeVibrator {
+  public:
+    FakeVibrator() : mDevice("cs40l26_input", mSysfsDir.path) {
+        if (!mDevice.ok()) {
+            return;
+        }
+        setenv("INPUT_EVENT_NAME", "cs40l26_input", true);
+        setenv("INPUT_EVENT_PATH", "/dev/input/event*", true);
+        setenv("HWAPI_PATH_PREFIX", mDevice.sysfsPrefix().c_str(), true);
+        setenv("CALIBRATION_FILEPATH", mCalFile.path, true);
+
+        mVibrator = ndk::SharedRefBase::make<Vibrator>(HwApi::Create(), HwCal::Create(), nullptr,
+                                                       nullptr, std::make_unique<FakeGPIO>());
+        mVibrator->init();
+    }
+
+    FakeDevice &device() { return mDevice; }
+    const std::shared_ptr<Vibrator> &vibrator() { return mVibrator; }
+
+  private:
+    TemporaryDir mSysfsDir;
+    TemporaryFile mCalFile;
+    FakeDevice mDevice;
+    std::shared_ptr<Vibrator> mVibrator;
+};
+
+static constexpr std::chrono::milliseconds E2E_TIMEOUT{1000};
+
+static double seconds(FakeDevice::Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+// Time from perform() until the play event reaches the device.
+static void BM_PerformToPlay(benchmark::State &state) {
+    FakeVibrator fake;
+    uint64_t plays = 0;
+
+    if (!fake.vibrator()) {
+        state.SkipWithError("uinput not available");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto callback = ndk::SharedRefBase::make<CompletionCallback>();
+        int32_t lengthMs;
+
+        auto start = FakeDevice::Clock::now();
+        fake.vibrator()->perform(Effect::CLICK, EffectStrength::MEDIUM, callback, &lengthMs);
+        if (!fake.device().waitForPlays(++plays, E2E_TIMEOUT)) {
+            state.SkipWithError("play not received");
+            break;
+        }
+        state.SetIterationTime(seconds(fake.device().lastPlay() - start));
+
+        if (!callback->waitForCompletions(1, E2E_TIMEOUT)) {
+            state.SkipWithError("completion not received");
+            break;
+        }
+    }
+}
+
+// Time from off() until onComplete() is called.
+static void BM_StopToComplete(benchmark::State &state) {
+    FakeVibrator fake;
+    uint64_t plays = 0;
+
+    if (!fake.vibrator()) {
+        state.SkipWithError("uinput not available");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto callback = ndk::SharedRefBase::make<CompletionCallback>();
+
+        fake.vibrator()->on(E2E_TIMEOUT.count(), callback);
+        if (!fake.device().waitForPlays(++plays, E2E_TIMEOUT)) {
+            state.SkipWithError("play not received");
+            break;
+        }
+
+        auto start = FakeDevice::Clock::now();
+        fake.vibrator()->off();
+        if (!callback->waitForCompletions(1, E2E_TIMEOUT)) {
+            state.SkipWithError("completion not received");
+            break;
+        }
+        state.SetIterationTime(seconds(callback->lastCompletion() - start));
+    }
+}
+
+// Returns the duration of the startup phase 'name' reported in 'dump'.
+static double startupPhaseMs(const std::string &dump, const std::string &name) {
+    auto pos = dump.find("    " + name + ": ");
+    return pos == std::string::npos ? 0 : std::stod(dump.substr(pos + name.size() + 6));
+}
+
+// Time taken by init() on a dual actuator configuration, with each effect
+// upload taking state.range(0) microseconds. The "serial_ms" counter sums the
+// per-actuator bring-up times, i.e. what init() took before they overlapped.
+static void BM_InitDual(benchmark::State &state) {
+    FakeDevice::Config config;
+    config.uploadLatency = std::chrono::microseconds(state.range(0));
+    TemporaryDir sysfsDir;
+    TemporaryFile calFile;
+    FakeDevice base("cs40l26_input", sysfsDir.path, config);
+    FakeDevice flip("cs40l26_dual_input", sysfsDir.path, config);
+    double serialMs = 0;
+
+    if (!base.ok() || !flip.ok()) {
+        state.SkipWithError("uinput not available");
+        return;
+    }
+    setenv("INPUT_EVENT_NAME", "cs40l26_input", true);
+    setenv("INPUT_EVENT_NAME_DUAL", "cs40l26_dual_input", true);
+    setenv("INPUT_EVENT_PATH", "/dev/input/event*", true);
+    setenv("CALIBRATION_FILEPATH", calFile.path, true);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        setenv("HWAPI_PATH_PREFIX", base.sysfsPrefix().c_str(), true);
+        auto hwApiDef = HwApi::Create();
+        setenv("HWAPI_PATH_PREFIX", flip.sysfsPrefix().c_str(), true);
+        auto hwApiDual = HwApi::Create();
+        auto vibrator = ndk::SharedRefBase::make<Vibrator>(
+                std::move(hwApiDef), HwCal::Create(), std::move(hwApiDual), HwCal::Create(),
+                std::make_unique<FakeGPIO>());
+        state.ResumeTiming();
+
+        vibrator->init();
+
+        state.PauseTiming();
+        TemporaryFile dump;
+        vibrator->dump(dump.fd, nullptr, 0);
+        std::ifstream file{dump.path};
+        std::string output{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        serialMs += startupPhaseMs(output, "base") + startupPhaseMs(output, "flip");
+        vibrator.reset();
+        state.ResumeTiming();
+    }
+    state.counters["serial_ms"] = benchmark::Counter(serialMs, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_PerformToPlay)->UseManualTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StopToComplete)->UseManualTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_InitDual)->Arg(0)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// Time an OWT upload takes over I2C.
+static constexpr std::chrono::microseconds OWT_UPLOAD_LATENCY{2000};
+
+// Vibrator on the unit test mocks, uploading OWT waveforms as slowly as the
+// chip and preempting the effect playing, so that callers never wait for
+// playback.
+static std::shared_ptr<Vibrator> createMockVibrator() {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto cal = std::make_unique<NiceMock<MockCal>>();
+    // OWT ids in use; uploads and erases are serialized by the Vibrator.
+    auto ids = std::make_shared<std::set<uint32_t>>();
+
+    ON_CALL(*api, hasOwtFreeSpace()).WillByDefault(Return(true));
+    ON_CALL(*api, getOwtFreeSpace(_)).WillByDefault(DoAll(SetArgPointee<0>(4096), Return(true)));
+    ON_CALL(*api, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([ids](int, const uint8_t *, uint32_t, ff_effect *,
+                                        uint32_t *outEffectIndex, int *) {
+                std::this_thread::sleep_for(OWT_UPLOAD_LATENCY);
+                uint32_t id = WAVEFORM_MAX_PHYSICAL_INDEX;
+                while (ids->count(id)) {
+                    id++;
+                }
+                ids->insert(id);
+                *outEffectIndex = id;
+                return true;
+            }));
+    ON_CALL(*api, eraseOwtEffect(_, _, _))
+            .WillByDefault(Invoke([ids](int, int8_t effectIndex, std::vector<ff_effect> *) {
+                ids->erase(effectIndex);
+                return true;
+            }));
+    ON_CALL(*api, flushOwtEffects(_, _))
+            .WillByDefault(Invoke([ids](int, std::vector<ff_effect> *) {
+                ids->clear();
+                return true;
+            }));
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFEffect(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, pollVibeState(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*cal, getClickVolLevels(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(std::array<uint32_t, 2>{1, 100}), Return(true)));
+    ON_CALL(*cal, isPreemptionEnabled()).WillByDefault(Return(true));
+    // not an input device name, so that nothing is discovered
+    setenv("INPUT_EVENT_NAME", "CS40L26TestSuite", true);
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api), std::move(cal), nullptr,
+                                                       nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+    return vibrator;
+}
+
+// Time taken by the queries of a client while state.range(0) other callers
+// keep composing effects, each of which has to be uploaded.
+static void BM_QueryUnderContention(benchmark::State &state) {
+    auto vibrator = createMockVibrator();
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> composes{0};
+    std::vector<std::thread> callers;
+
+    for (int64_t i = 0; i < state.range(0); i++) {
+        callers.emplace_back([&, i] {
+            // vary the scale so that compositions miss the effect cache
+            for (uint32_t n = 0; !stopping; n++) {
+                float scale = ((i * 31 + n) % 90 + 10) / 100.0f;
+                vibrator->compose({{0, CompositePrimitive::CLICK, scale}}, nullptr);
+                composes++;
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        int32_t capabilities;
+        float qFactor;
+        std::vector<float> bandwidthAmplitudeMap;
+
+        vibrator->getCapabilities(&capabilities);
+        vibrator->getQFactor(&qFactor);
+        vibrator->getBandwidthAmplitudeMap(&bandwidthAmplitudeMap);
+        benchmark::DoNotOptimize(capabilities);
+        benchmark::DoNotOptimize(bandwidthAmplitudeMap.data());
+    }
+
+    stopping = true;
+    for (auto &caller : callers) {
+        caller.join();
+    }
+    vibrator->off();
+    state.counters["composes"] = benchmark::Counter(composes, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_QueryUnderContention)
+        ->ArgName("composers")
+        ->Arg(0)
+        ->Arg(1)
+        ->Arg(4)
+        ->UseRealTime()
+        ->Unit(benchmark::kMicrosecond);
+
+// The recursive, bit-at-a-time encoder DspMemChunk used before BitPacker,
+// kept as the baseline for BM_Pack.
+class LegacyPacker {
+  public:
+    LegacyPacker(uint8_t *first, const uint8_t *last) : _current(first), _max(last) {}
+
+    int write(int nbits, uint32_t val) {
+        int nwrite, i;
+
+        nwrite = std::min(24 - _cachebits, nbits);
+        _cache <<= nwrite;
+        _cache |= val >> (nbits - nwrite);
+        _cachebits += nwrite;
+        nbits -= nwrite;
+
+        if (_cachebits == 24) {
+            if (_current == _max)
+                return -ENOSPC;
+
+            _cache &= 0xFFFFFF;
+            for (i = 0; i < sizeof(_cache); i++, _cache <<= 8)
+                *_current++ = (_cache & 0xFF000000) >> 24;
+
+            bytes += sizeof(_cache);
+            _cachebits = 0;
+        }
+
+        if (nbits)
+            return write(nbits, val);
+
+        return 0;
+    }
+
+    int flush() { return _cachebits ? write(24 - _cachebits, 0) : 0; }
+    size_t size() const { return bytes; }
+
+  private:
+    size_t bytes = 0;
+    uint8_t *_current;
+    const uint8_t *_max;
+    uint32_t _cache = 0;
+    int _cachebits = 0;
+};
+
+struct Field {
+    uint32_t nbits;
+    uint32_t value;
+};
+
+// Fields DspMemChunk writes for a composition of COMPOSE_SIZE_MAX primitives.
+static std::vector<Field> composeFields() {
+    std::vector<Field> fields = {{8, 0}, {8, 0}, {8, 0}};
+    for (int i = 0; i < COMPOSE_SIZE_MAX; i++) {
+        fields.insert(fields.end(), {{8, 50u + i % 50}, {8, WAVEFORM_CLICK_INDEX}, {8, 0},
+                                     {8, 0}, {16, 10u + i}});
+    }
+    return fields;
+}
+
+// Fields DspMemChunk writes for a PWLE of COMPOSE_PWLE_SIZE_MAX_DEFAULT
+// chirping segments.
+static std::vector<Field> pwleFields() {
+    std::vector<Field> fields = {{24, 0}, {8, 0}, {12, 0}, {8, 0}};
+    for (int i = 0; i < COMPOSE_PWLE_SIZE_MAX_DEFAULT; i++) {
+        fields.insert(fields.end(), {{16, 40u + i}, {12, 1024u + i}, {12, 600u + i},
+                                     {8, (PWLE_CHIRP_BIT | 1) << 4}});
+    }
+    return fields;
+}
+
+template <typename Packer>
+static size_t pack(const std::vector<Field> &fields,
+                   std::array<uint8_t, FF_CUSTOM_DATA_LEN_MAX_PWLE> *out) {
+    Packer packer(out->data(), out->data() + out->size());
+    for (auto &field : fields) {
+        packer.write(field.nbits, field.value);
+    }
+    packer.flush();
+    return packer.size();
+}
+
+// Time taken to encode the largest composition (state.range(0) == 0) or PWLE
+// (state.range(0) == 1) the HAL accepts.
+template <typename Packer>
+static void BM_Pack(benchmark::State &state) {
+    auto fields = state.range(0) ? pwleFields() : composeFields();
+    std::array<uint8_t, FF_CUSTOM_DATA_LEN_MAX_PWLE> out{}, legacy{};
+
+    if (pack<Packer>(fields, &out) != pack<LegacyPacker>(fields, &legacy) || out != legacy) {
+        state.SkipWithError("encoding differs from LegacyPacker");
+        return;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pack<Packer>(fields, &out));
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Pack, LegacyPacker)->ArgName("pwle")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Pack, BitPacker)->ArgName("pwle")->Arg(0)->Arg(1);
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
@@ -22,11 +22,14 @@
 #include "Hardware.h"
 #include "VibMgrHwApi.h"
 #include "Vibrator.h"
+#include "VibratorTimeline.h"
 
 using ::aidl::android::hardware::vibrator::HwApi;
+using ::aidl::android::hardware::vibrator::HwApiUring;
 using ::aidl::android::hardware::vibrator::HwCal;
 using ::aidl::android::hardware::vibrator::VibMgrHwApi;
 using ::aidl::android::hardware::vibrator::Vibrator;
+using ::aidl::android::hardware::vibrator::VibratorTimeline;
 using ::android::defaultServiceManager;
 using ::android::ProcessState;
 using ::android::sp;
@@ -36,6 +39,23 @@ using ::android::String16;
 #define VIBRATOR_NAME "default"
 #endif
 
+// Binder threads besides the main one. Vibrator is thread-safe, so queries
+// are answered while another call uploads or plays an effect.
+static constexpr uint32_t BINDER_THREAD_POOL_SIZE = 3;
+
+// HWAPI_BACKEND=uring selects the io_uring backed HwApi, if available.
+static std::unique_ptr<Vibrator::HwApi> createHwApi() {
+    const char *backend = std::getenv("HWAPI_BACKEND");
+
+    if (backend != nullptr && !strcmp(backend, "uring")) {
+        if (auto hwapi = HwApiUring::Create()) {
+            return hwapi;
+        }
+        ALOGE("Failed to create io_uring HwApi, using default");
+    }
+    return HwApi::Create();
+}
+
 int main() {
     const char *hwApiPathPrefixDual = std::getenv("HWAPI_PATH_PREFIX_DUAL");
     const char *calFilePath = std::getenv("CALIBRATION_FILEPATH");
@@ -45,7 +65,7 @@ int main() {
     if (!hwgpio) {
         return EXIT_FAILURE;
     }
-    auto hwApiDef = HwApi::Create();
+    auto hwApiDef = createHwApi();
     if (!hwApiDef) {
         return EXIT_FAILURE;
     }
@@ -62,7 +82,7 @@ int main() {
         !setenv("CALIBRATION_FILEPATH_DUAL", calFilePath, 1)) {
         ALOGD("Init dual HAL: %s", std::getenv("HWAPI_PATH_PREFIX"));
         svc = ndk::SharedRefBase::make<Vibrator>(std::move(hwApiDef), std::move(hwCalDef),
-                                                 std::make_unique<HwApi>(),
+                                                 createHwApi(),
                                                  std::make_unique<HwCal>(), std::move(hwgpio));
     } else {
         ALOGD("Failed to init dual HAL");
@@ -75,13 +95,20 @@ int main() {
     ProcessState::initWithDriver("/dev/vndbinder");
 
     auto svcBinder = svc->asBinder();
-    binder_status_t status = AServiceManager_addService(svcBinder.get(), svcName.c_str());
+    auto timeline = ndk::SharedRefBase::make<VibratorTimeline>(svc);
+    binder_status_t status = AIBinder_setExtension(svcBinder.get(), timeline->asBinder().get());
+    LOG_ALWAYS_FATAL_IF(status != STATUS_OK);
+    status = AServiceManager_addService(svcBinder.get(), svcName.c_str());
     LOG_ALWAYS_FATAL_IF(status != STATUS_OK);
 
-    ProcessState::self()->setThreadPoolMaxThreadCount(1);
+    // Register first and bring up the hardware in the background; early calls
+    // wait for it.
+    svc->initAsync();
+
+    ProcessState::self()->setThreadPoolMaxThreadCount(BINDER_THREAD_POOL_SIZE);
     ProcessState::self()->startThreadPool();
 
-    ABinderProcess_setThreadPoolMaxThreadCount(0);
+    ABinderProcess_setThreadPoolMaxThreadCount(BINDER_THREAD_POOL_SIZE);
     ABinderProcess_joinThreadPool();
 
     return EXIT_FAILURE;  // should not reach
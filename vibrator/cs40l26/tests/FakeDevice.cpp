@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeDevice.h"
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+#include "PollReactor.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr const char *UINPUT_PATH = "/dev/uinput";
+static constexpr uint32_t VIBE_STATE_STOPPED = 0;
+static constexpr uint32_t VIBE_STATE_HAPTIC = 1;
+
+// Bumps the watch of a file on every write to it.
+class InotifyFallback : public PollReactor::Fallback {
+  public:
+    InotifyFallback() : mFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+    int fd() const override { return mFd; }
+    int add(const std::string &path) override {
+        return inotify_add_watch(mFd, path.c_str(), IN_MODIFY);
+    }
+    void drain(const std::function<void(int)> &changed) override {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t len;
+
+        while ((len = TEMP_FAILURE_RETRY(read(mFd, buffer, sizeof(buffer)))) > 0) {
+            for (ssize_t offset = 0; offset < len;) {
+                auto *event = reinterpret_cast<inotify_event *>(buffer + offset);
+                changed(event->wd);
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+
+  private:
+    ::android::base::unique_fd mFd;
+};
+
+void watchRegularFiles() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        auto fallback = std::make_unique<InotifyFallback>();
+        if (fallback->fd() < 0) {
+            ALOGE("Failed to create inotify fallback (%d): %s", errno, strerror(errno));
+            return;
+        }
+        PollReactor::Get().setFallback(std::move(fallback));
+    });
+}
+
+FakeDevice::FakeDevice(const std::string &name, const std::string &sysfsRoot,
+                       const Config &config)
+    : mConfig(config), mNumWaves(config.numWaves), mOwtFreeSpace(config.owtFreeSpace) {
+    std::error_code ec;
+
+    watchRegularFiles();
+    mPrefix = sysfsRoot + "/" + name + "/";
+    for (auto attr : {"calibration/f0_stored", "calibration/redc_stored", "calibration/q_stored",
+                      "default/f0_offset", "default/f0_comp_enable", "default/redc_comp_enable",
+                      "default/delay_before_stop_playback_us", "default/vibe_state",
+                      "default/num_waves", "default/owt_free_space"}) {
+        auto path = std::filesystem::path(mPrefix) / attr;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::ofstream{path} << 0 << std::endl;
+    }
+    writeAttribute("default/num_waves", mNumWaves);
+    writeAttribute("default/owt_free_space", mOwtFreeSpace);
+
+    ::android::base::unique_fd fd{TEMP_FAILURE_RETRY(::open(UINPUT_PATH, O_RDWR | O_CLOEXEC))};
+    if (!fd.ok()) {
+        ALOGE("Failed to open %s (%d): %s", UINPUT_PATH, errno, strerror(errno));
+        return;
+    }
+
+    struct uinput_setup setup = {};
+    setup.id.bustype = BUS_I2C;
+    strncpy(setup.name, name.c_str(), UINPUT_MAX_NAME_SIZE - 1);
+    setup.ff_effects_max = FF_MAX_EFFECTS;
+
+    if (ioctl(fd, UI_SET_EVBIT, EV_FF) < 0 || ioctl(fd, UI_SET_FFBIT, FF_PERIODIC) < 0 ||
+        ioctl(fd, UI_SET_FFBIT, FF_CUSTOM) < 0 || ioctl(fd, UI_SET_FFBIT, FF_GAIN) < 0 ||
+        ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        ALOGE("Failed to create input device %s (%d): %s", name.c_str(), errno, strerror(errno));
+        return;
+    }
+
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    mUinputFd = std::move(fd);
+    mThread = std::thread(&FakeDevice::run, this);
+}
+
+FakeDevice::~FakeDevice() {
+    if (mThread.joinable()) {
+        uint64_t stop = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd, &stop, sizeof(stop)));
+        mThread.join();
+    }
+    if (mUinputFd.ok()) {
+        ioctl(mUinputFd, UI_DEV_DESTROY);
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(mPrefix, ec);
+}
+
+bool FakeDevice::waitForPlays(uint64_t count, std::chrono::milliseconds timeout) {
+    std::unique_lock lock{mMutex};
+    return mCondition.wait_for(lock, timeout, [&] { return mPlays >= count; });
+}
+
+FakeDevice::Clock::time_point FakeDevice::lastPlay() {
+    std::scoped_lock lock{mMutex};
+    return mLastPlay;
+}
+
+FakeDevice::Clock::time_point FakeDevice::lastStop() {
+    std::scoped_lock lock{mMutex};
+    return mLastStop;
+}
+
+uint32_t FakeDevice::gain() {
+    std::scoped_lock lock{mMutex};
+    return mGain;
+}
+
+bool FakeDevice::hasEffect(int16_t id) {
+    std::scoped_lock lock{mMutex};
+    return mEffects.count(id);
+}
+
+void FakeDevice::run() {
+    struct pollfd fds[] = {
+            {.fd = mUinputFd, .events = POLLIN},
+            {.fd = mStopFd, .events = POLLIN},
+    };
+
+    while (true) {
+        int timeoutMs = -1;
+        {
+            std::scoped_lock lock{mMutex};
+            auto next = std::min(mHapticAt, mStoppedAt);
+            if (next != Clock::time_point::max()) {
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - Clock::now());
+                timeoutMs = std::max<int64_t>(wait.count(), 0);
+            }
+        }
+
+        if (poll(fds, std::size(fds), timeoutMs) < 0 && errno != EINTR) {
+            ALOGE("Fake device polling error (%d): %s", errno, strerror(errno));
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            struct input_event event;
+            if (TEMP_FAILURE_RETRY(read(mUinputFd, &event, sizeof(event))) == sizeof(event)) {
+                handleEvent(event);
+            }
+        }
+        step(Clock::now());
+    }
+}
+
+void FakeDevice::handleEvent(const struct input_event &event) {
+    if (event.type == EV_UINPUT && event.code == UI_FF_UPLOAD) {
+        upload(event.value);
+    } else if (event.type == EV_UINPUT && event.code == UI_FF_ERASE) {
+        erase(event.value);
+    } else if (event.type == EV_FF && event.code == FF_GAIN) {
+        std::scoped_lock lock{mMutex};
+        mGain = event.value;
+    } else if (event.type == EV_FF) {
+        play(event.code, event.value);
+    }
+}
+
+void FakeDevice::upload(uint32_t requestId) {
+    struct uinput_ff_upload upload = {};
+    upload.request_id = requestId;
+    if (ioctl(mUinputFd, UI_BEGIN_FF_UPLOAD, &upload) < 0) {
+        ALOGE("Failed to begin upload (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    {
+        std::scoped_lock lock{mMutex};
+        auto &effect = upload.effect;
+        // physical effects only carry {bank, index}
+        uint32_t owtBytes = effect.u.periodic.custom_len > 2
+                                    ? effect.u.periodic.custom_len * sizeof(int16_t)
+                                    : 0;
+        auto old = mEffects.find(effect.id);
+
+        if (old != mEffects.end() && old->second.owtBytes) {
+            mOwtFreeSpace += old->second.owtBytes;
+            mNumWaves--;
+        }
+        if (owtBytes > mOwtFreeSpace) {
+            upload.retval = -ENOSPC;
+        } else {
+            mEffects[effect.id] = {effect.replay.length, owtBytes};
+            if (owtBytes) {
+                mOwtFreeSpace -= owtBytes;
+                mNumWaves++;
+            }
+        }
+        writeAttribute("default/num_waves", mNumWaves);
+        writeAttribute("default/owt_free_space", mOwtFreeSpace);
+    }
+
+    std::this_thread::sleep_for(mConfig.uploadLatency);
+    if (ioctl(mUinputFd, UI_END_FF_UPLOAD, &upload) < 0) {
+        ALOGE("Failed to end upload (%d): %s", errno, strerror(errno));
+    }
+}
+
+void FakeDevice::erase(uint32_t requestId) {
+    struct uinput_ff_erase erase = {};
+    erase.request_id = requestId;
+    if (ioctl(mUinputFd, UI_BEGIN_FF_ERASE, &erase) < 0) {
+        ALOGE("Failed to begin erase (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    {
+        std::scoped_lock lock{mMutex};
+        auto it = mEffects.find(erase.effect_id);
+        if (it != mEffects.end()) {
+            if (it->second.owtBytes) {
+                mOwtFreeSpace += it->second.owtBytes;
+                mNumWaves--;
+            }
+            mEffects.erase(it);
+        }
+        writeAttribute("default/num_waves", mNumWaves);
+        writeAttribute("default/owt_free_space", mOwtFreeSpace);
+    }
+
+    if (ioctl(mUinputFd, UI_END_FF_ERASE, &erase) < 0) {
+        ALOGE("Failed to end erase (%d): %s", errno, strerror(errno));
+    }
+}
+
+void FakeDevice::play(int16_t id, bool start) {
+    std::scoped_lock lock{mMutex};
+    auto now = Clock::now();
+
+    if (!start) {
+        mHapticAt = Clock::time_point::max();
+        mStoppedAt = now + mConfig.stopLatency;
+        return;
+    }
+
+    auto it = mEffects.find(id);
+    std::chrono::microseconds duration = mConfig.defaultDuration;
+    if (it != mEffects.end() && it->second.length) {
+        duration = std::chrono::milliseconds(it->second.length);
+    }
+
+    mPlays++;
+    mLastPlay = now;
+    mHapticAt = now + mConfig.startLatency;
+    mStoppedAt = mHapticAt + duration + mConfig.stopLatency;
+    mCondition.notify_all();
+}
+
+void FakeDevice::step(Clock::time_point now) {
+    std::scoped_lock lock{mMutex};
+
+    if (now >= mHapticAt) {
+        mHapticAt = Clock::time_point::max();
+        writeAttribute("default/vibe_state", VIBE_STATE_HAPTIC);
+    }
+    if (now >= mStoppedAt) {
+        mStoppedAt = Clock::time_point::max();
+        mLastStop = now;
+        writeAttribute("default/vibe_state", VIBE_STATE_STOPPED);
+        mCondition.notify_all();
+    }
+}
+
+void FakeDevice::writeAttribute(const char *name, uint32_t value) {
+    auto path = mPrefix + name;
+    auto data = std::to_string(value) + "\n";
+    ::android::base::unique_fd fd{TEMP_FAILURE_RETRY(::open(path.c_str(), O_WRONLY | O_CLOEXEC))};
+
+    // rewrite in place, so readers holding the attribute open see the update
+    if (!fd.ok() || TEMP_FAILURE_RETRY(pwrite(fd, data.data(), data.size(), 0)) < 0 ||
+        ftruncate(fd, data.size()) < 0) {
+        ALOGE("Failed to write %s (%d): %s", path.c_str(), errno, strerror(errno));
+    }
+}
+
+ndk::ScopedAStatus CompletionCallback::onComplete() {
+    std::scoped_lock lock{mMutex};
+    mCompletions++;
+    mLastCompletion = FakeDevice::Clock::now();
+    mCondition.notify_all();
+    return ndk::ScopedAStatus::ok();
+}
+
+bool CompletionCallback::waitForCompletions(uint64_t count, std::chrono::milliseconds timeout) {
+    std::unique_lock lock{mMutex};
+    return mCondition.wait_for(lock, timeout, [&] { return mCompletions >= count; });
+}
+
+FakeDevice::Clock::time_point CompletionCallback::lastCompletion() {
+    std::scoped_lock lock{mMutex};
+    return mLastCompletion;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
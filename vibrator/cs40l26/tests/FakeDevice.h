@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/BnVibratorCallback.h>
+#include <android-base/unique_fd.h>
+#include <linux/input.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Vibrator.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Lets PollReactor watch regular files, through inotify, so that attributes
+// standing in for sysfs can be polled. Safe to call any number of times.
+void watchRegularFiles();
+
+// Stand-in for one CS40L26 on a plain Linux machine: a uinput force feedback
+// device carrying the name the HAL looks for, e.g. "cs40l26_input", and a
+// sysfs tree of regular files, preferably on tmpfs. A simulator thread serves
+// effect uploads and erases, and drives "vibe_state", "num_waves" and
+// "owt_free_space" the way the driver would.
+//
+// Requires write access to /dev/uinput; check ok() before use.
+class FakeDevice {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        // from a play event until vibe_state reports haptic playback
+        std::chrono::microseconds startLatency{200};
+        // playback length of effects without replay.length, e.g. OWT effects
+        std::chrono::microseconds defaultDuration{5000};
+        // from a stop event or the end of playback until vibe_state reports
+        // stopped
+        std::chrono::microseconds stopLatency{200};
+        // time taken by each effect upload, e.g. for the DSP writes over I2C
+        std::chrono::microseconds uploadLatency{0};
+        uint32_t numWaves{14};
+        uint32_t owtFreeSpace{4096};
+    };
+
+    // Creates the input device 'name' and its sysfs tree under
+    // 'sysfsRoot'/'name'/.
+    FakeDevice(const std::string &name, const std::string &sysfsRoot, const Config &config);
+    FakeDevice(const std::string &name, const std::string &sysfsRoot)
+        : FakeDevice(name, sysfsRoot, Config{}) {}
+    ~FakeDevice();
+
+    bool ok() const { return mUinputFd.ok(); }
+    // Value for HWAPI_PATH_PREFIX.
+    const std::string &sysfsPrefix() const { return mPrefix; }
+
+    // Blocks until 'count' play events were received in total. Returns false
+    // on timeout.
+    bool waitForPlays(uint64_t count, std::chrono::milliseconds timeout);
+    // Time of the last play event.
+    Clock::time_point lastPlay();
+    // Time vibe_state last reported stopped.
+    Clock::time_point lastStop();
+    uint32_t gain();
+    // Whether the device holds effect 'id'.
+    bool hasEffect(int16_t id);
+
+  private:
+    struct Effect {
+        uint16_t length;
+        uint32_t owtBytes;
+    };
+
+    void run();
+    void handleEvent(const struct input_event &event);
+    void upload(uint32_t requestId);
+    void erase(uint32_t requestId);
+    void play(int16_t id, bool start);
+    void step(Clock::time_point now);
+    void writeAttribute(const char *name, uint32_t value);
+
+    const Config mConfig;
+    std::string mPrefix;
+    ::android::base::unique_fd mUinputFd;
+    ::android::base::unique_fd mStopFd;
+    std::thread mThread;
+
+    std::mutex mMutex;  // protects everything below
+    std::condition_variable mCondition;
+    std::map<int16_t, Effect> mEffects;
+    uint32_t mNumWaves;
+    uint32_t mOwtFreeSpace;
+    uint32_t mGain{100};
+    uint64_t mPlays{0};
+    Clock::time_point mLastPlay;
+    Clock::time_point mLastStop;
+    // pending vibe_state transitions, max() when none
+    Clock::time_point mHapticAt{Clock::time_point::max()};
+    Clock::time_point mStoppedAt{Clock::time_point::max()};
+};
+
+// HwGPIO without a GPIO line, so effects are triggered through the input
+// device only.
+class FakeGPIO : public Vibrator::HwGPIO {
+  public:
+    bool getGPIO() override { return false; }
+    bool initGPIO() override { return false; }
+    bool setGPIOOutput(bool /*value*/) override { return true; }
+    void debug(int /*fd*/) override {}
+};
+
+// Records when onComplete() is called.
+class CompletionCallback : public BnVibratorCallback {
+  public:
+    ndk::ScopedAStatus onComplete() override;
+    // Blocks until 'count' completions were received in total. Returns false
+    // on timeout.
+    bool waitForCompletions(uint64_t count, std::chrono::milliseconds timeout);
+    FakeDevice::Clock::time_point lastCompletion();
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    uint64_t mCompletions{0};
+    FakeDevice::Clock::time_point mLastCompletion;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
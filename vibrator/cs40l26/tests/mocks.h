@@ -39,7 +39,9 @@ class MockApi : public ::aidl::android::hardware::vibrator::Vibrator::HwApi {
     MOCK_METHOD1(setRedc, bool(std::string value));
     MOCK_METHOD1(setQ, bool(std::string value));
     MOCK_METHOD1(getEffectCount, bool(uint32_t *value));
-    MOCK_METHOD2(pollVibeState, bool(uint32_t value, int32_t timeoutMs));
+    MOCK_METHOD3(pollVibeState,
+                 bool(uint32_t value, int32_t timeoutMs, const std::function<bool()> &cancel));
+    MOCK_METHOD0(wakePolls, void());
     MOCK_METHOD0(hasOwtFreeSpace, bool());
     MOCK_METHOD1(getOwtFreeSpace, bool(uint32_t *value));
     MOCK_METHOD1(setF0CompEnable, bool(bool value));
@@ -54,6 +56,7 @@ class MockApi : public ::aidl::android::hardware::vibrator::Vibrator::HwApi {
                  bool(int fd, const uint8_t *owtData, const uint32_t numBytes, struct ff_effect *effect,
                       uint32_t *outEffectIndex, int *status));
     MOCK_METHOD3(eraseOwtEffect, bool(int fd, int8_t effectIndex, std::vector<ff_effect> *effect));
+    MOCK_METHOD2(flushOwtEffects, bool(int fd, std::vector<ff_effect> *effect));
     MOCK_METHOD1(debug, void(int fd));
 
     ~MockApi() override { destructor(); };
@@ -75,6 +78,7 @@ class MockCal : public ::aidl::android::hardware::vibrator::Vibrator::HwCal {
     MOCK_METHOD1(getSupportedPrimitives, bool(uint32_t *value));
     MOCK_METHOD0(isF0CompEnabled, bool());
     MOCK_METHOD0(isRedcCompEnabled, bool());
+    MOCK_METHOD0(isPreemptionEnabled, bool());
     MOCK_METHOD1(debug, void(int fd));
 
     ~MockCal() override { destructor(); };
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ChunkPool.h"
+#include "DspMemChunk.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+TEST(ChunkPoolTest, acquire_reusesReleasedBuffers) {
+    ChunkPool pool(2, 64);
+    uint8_t *first;
+
+    {
+        auto buffer = pool.acquire(64);
+        first = buffer.get();
+        EXPECT_EQ(pool.available(), 1);
+    }
+    EXPECT_EQ(pool.available(), 2);
+    EXPECT_EQ(pool.acquire(32).get(), first);
+    EXPECT_EQ(pool.reuses(), 2);
+    EXPECT_EQ(pool.allocations(), 0);
+}
+
+TEST(ChunkPoolTest, acquire_fallsBackToHeap) {
+    ChunkPool pool(1, 64);
+
+    auto oversized = pool.acquire(128);
+    auto pooled = pool.acquire(64);
+    auto exhausted = pool.acquire(64);
+
+    EXPECT_NE(oversized, nullptr);
+    EXPECT_NE(exhausted, nullptr);
+    EXPECT_EQ(pool.reuses(), 1);
+    EXPECT_EQ(pool.allocations(), 2);
+    // heap buffers are freed, not pooled
+    exhausted.reset();
+    oversized.reset();
+    EXPECT_EQ(pool.available(), 0);
+}
+
+TEST(ChunkPoolTest, makeShared_drawsBlocksFromPool) {
+    ChunkPool pool(1, 64);
+
+    {
+        auto pooled = pool.makeShared<uint64_t>(1);
+        auto exhausted = pool.makeShared<uint64_t>(2);
+        EXPECT_EQ(*pooled + *exhausted, 3);
+        EXPECT_EQ(pool.allocations(), 1);
+    }
+    auto reused = pool.makeShared<uint64_t>(3);
+    EXPECT_EQ(pool.allocations(), 1);
+    // blocks do not take up buffers
+    EXPECT_EQ(pool.available(), 1);
+}
+
+TEST(ChunkPoolTest, chunk_returnsBufferWhenDestroyed) {
+    ChunkPool pool(1, FF_CUSTOM_DATA_LEN_MAX_PWLE);
+
+    {
+        DspMemChunk chunk(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP, &pool);
+        EXPECT_EQ(chunk.constructComposeSegment(100, WAVEFORM_CLICK_INDEX, 0, 0, 0), 0);
+        std::shared_ptr<const DspMemChunk> moved = pool.makeShared<DspMemChunk>(std::move(chunk));
+        EXPECT_EQ(moved->size(), 12);
+        EXPECT_EQ(pool.available(), 0);
+    }
+    EXPECT_EQ(pool.available(), 1);
+    EXPECT_EQ(pool.allocations(), 0);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
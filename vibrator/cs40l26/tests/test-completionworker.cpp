@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <vector>
+
+#include "CompletionWorker.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+TEST(CompletionWorkerTest, post_runsCommandsInOrderOnOneThread) {
+    std::vector<int> ran;
+    std::vector<std::thread::id> threads;
+
+    {
+        CompletionWorker worker;
+        for (int i = 0; i < 3; i++) {
+            worker.post([&, i] {
+                ran.push_back(i);
+                threads.push_back(std::this_thread::get_id());
+            });
+        }
+    }
+
+    EXPECT_EQ(ran, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(threads[0], threads[1]);
+    EXPECT_EQ(threads[1], threads[2]);
+    EXPECT_NE(threads[0], std::this_thread::get_id());
+}
+
+TEST(CompletionWorkerTest, post_doesNotWaitForRunningCommand) {
+    CompletionWorker worker;
+    std::promise<void> release;
+    std::promise<void> done;
+    auto released = release.get_future().share();
+
+    worker.post([released] { released.wait(); });
+    worker.post([&] { done.set_value(); });
+
+    EXPECT_EQ(worker.pending(), 2);
+    release.set_value();
+    done.get_future().wait();
+}
+
+TEST(CompletionWorkerTest, destructor_runsQueuedCommands) {
+    int ran = 0;
+
+    {
+        CompletionWorker worker;
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        worker.post([released] { released.wait(); });
+        worker.post([&] { ran++; });
+        worker.post([&] { ran++; });
+        release.set_value();
+    }
+
+    EXPECT_EQ(ran, 2);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include "DspMemChunk.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static std::vector<uint8_t> bytes(DspMemChunk &chunk) {
+    return {chunk.front(), chunk.front() + chunk.size()};
+}
+
+// A 24 bit word packed from uneven fields, then a partial word padded by flush().
+static constexpr bool packsAtCompileTime() {
+    constexpr uint8_t expected[] = {0x00, 0xA5, 0x3C, 0x0F, 0x00, 0xFC, 0x00, 0x00};
+    uint8_t out[sizeof(expected)] = {};
+    BitPacker packer(out, out + sizeof(out));
+
+    packer.write(8, 0xA5);
+    packer.write(4, 0x3);
+    packer.write(12, 0xC0F);
+    packer.write(6, 0x3F);
+    packer.flush();
+    for (size_t i = 0; i < sizeof(out); i++) {
+        if (out[i] != expected[i]) {
+            return false;
+        }
+    }
+    return packer.size() == sizeof(out);
+}
+
+static_assert(packsAtCompileTime());
+
+TEST(BitPackerTest, write_failsWhenFull) {
+    std::array<uint8_t, 6> out{};
+    BitPacker packer(out.data(), out.data() + out.size());
+
+    EXPECT_EQ(packer.write(24, 0x123456), 0);
+    EXPECT_EQ(packer.write(24, 0x789ABC), -ENOSPC);
+    EXPECT_EQ(packer.write(8, 0), -ENOSPC);
+    EXPECT_EQ(packer.flush(), -ENOSPC);
+    EXPECT_EQ(packer.size(), 4);
+    EXPECT_EQ(out, (std::array<uint8_t, 6>{0x00, 0x12, 0x34, 0x56, 0x00, 0x00}));
+}
+
+// Expected bytes below were produced by the recursive, bit-at-a-time encoder
+// this packer replaced.
+TEST(DspMemChunkTest, compose_matchesLegacyEncoding) {
+    DspMemChunk chunk(WAVEFORM_COMPOSE, 2044);
+
+    EXPECT_EQ(chunk.constructComposeSegment(0, WAVEFORM_LONG_VIBRATION_EFFECT_INDEX, 0, 1, 10), 0);
+    EXPECT_EQ(chunk.constructComposeSegment(100, WAVEFORM_CLICK_INDEX, 0, 0, 25), 0);
+    EXPECT_EQ(chunk.constructComposeSegment(42, WAVEFORM_THUD_INDEX, 0, 0, 0), 0);
+    EXPECT_EQ(chunk.flush(), 0);
+    EXPECT_EQ(chunk.updateNSection(3), 0);
+
+    EXPECT_EQ(bytes(chunk), (std::vector<uint8_t>{
+                                    0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+                                    0x00, 0x0A, 0x00, 0x64, 0x02, 0x00, 0x00, 0x00, 0x00, 0x19,
+                                    0x00, 0x2A, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+                            }));
+}
+
+TEST(DspMemChunkTest, pwle_matchesLegacyEncoding) {
+    DspMemChunk chunk(WAVEFORM_PWLE, 2302);
+
+    EXPECT_EQ(chunk.constructActiveSegment(0, 0.5f, 150.0f, false), 0);
+    EXPECT_EQ(chunk.constructActiveSegment(20, 0.75f, 175.25f, true), 0);
+    EXPECT_EQ(chunk.constructBrakingSegment(0, Braking::CLAB), 0);
+    EXPECT_EQ(chunk.constructBrakingSegment(30, Braking::CLAB), 0);
+    EXPECT_EQ(chunk.constructActiveSegment(15, 0.25f, 120.0f, false), 0);
+    EXPECT_EQ(chunk.flush(), 0);
+    EXPECT_EQ(chunk.updateWLength(71), 0);
+    EXPECT_EQ(chunk.updateNSection(5), 0);
+
+    EXPECT_EQ(bytes(chunk), (std::vector<uint8_t>{
+                                    0x00, 0x80, 0x02, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                    0x50, 0x00, 0x04, 0x00, 0x00, 0x25, 0x81, 0x00, 0x00,
+                                    0x05, 0x06, 0x00, 0x00, 0x2B, 0xD9, 0x00, 0x00, 0x00,
+                                    0x00, 0x00, 0x00, 0x00, 0x45, 0x00, 0x00, 0x07, 0x80,
+                                    0x00, 0x00, 0x00, 0x45, 0x00, 0x00, 0x03, 0xC2, 0x00,
+                                    0x00, 0x1E, 0x01, 0x00, 0x00, 0x00, 0x00,
+                            }));
+}
+
+// Reads back what the encoder wrote: 24 bit words, each in the low bytes of a
+// big endian 32 bit word.
+class BitReader {
+  public:
+    explicit BitReader(const std::vector<uint8_t> &bytes) : mBytes(bytes) {}
+
+    uint32_t read(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++, mPos++) {
+            size_t byte = mPos / 24 * 4 + 1 + mPos % 24 / 8;
+            value = (value << 1) | ((mBytes.at(byte) >> (7 - mPos % 8)) & 1);
+        }
+        return value;
+    }
+
+  private:
+    const std::vector<uint8_t> &mBytes;
+    size_t mPos{0};
+};
+
+struct PwleSample {
+    float amplitude;
+    float frequency;
+    bool braking;
+};
+
+// Plays a PWLE waveform back one 0.25 ms step at a time, the way the DSP ramps
+// between sections, staying silent while waiting between repeats.
+static std::vector<PwleSample> renderPwle(DspMemChunk &chunk) {
+    auto data = bytes(chunk);
+    BitReader reader(data);
+    std::vector<PwleSection> sections;
+    std::vector<PwleSample> samples;
+    PwleSample at{0, 0, false};
+
+    reader.read(24);  // wlength
+    uint32_t repeat = reader.read(8);
+    uint32_t wait = reader.read(12);
+    uint32_t nsections = reader.read(8);
+    for (uint32_t i = 0; i < nsections; i++) {
+        PwleSection &section = sections.emplace_back();
+        section.delay = reader.read(16);
+        section.amplitude = reader.read(12);
+        section.frequency = reader.read(12);
+        section.flags = reader.read(8) >> 4;
+        if (section.flags & PWLE_AMP_REG_BIT) {
+            reader.read(24);
+        }
+    }
+
+    for (uint32_t r = 0; r <= repeat; r++) {
+        if (r > 0) {
+            samples.insert(samples.end(), wait, {0, at.frequency, false});
+        }
+        for (auto &section : sections) {
+            float amplitude = section.amplitude / 2048.0f;
+            float frequency = section.frequency / 4.0f;
+            bool chirp = section.flags & PWLE_CHIRP_BIT;
+            bool braking = section.flags & PWLE_BRAKE_BIT;
+            for (uint32_t t = 1; t <= section.delay; t++) {
+                float frac = static_cast<float>(t) / section.delay;
+                samples.push_back({at.amplitude + (amplitude - at.amplitude) * frac,
+                                   chirp ? at.frequency + (frequency - at.frequency) * frac
+                                         : frequency,
+                                   braking});
+            }
+            at = {amplitude, frequency, braking};
+        }
+    }
+    return samples;
+}
+
+static DspMemChunk encodePwle(const std::vector<PwleSection> &sections) {
+    DspMemChunk chunk(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE);
+    for (auto &section : sections) {
+        EXPECT_EQ(chunk.constructPwleSection(section), 0);
+    }
+    chunk.flush();
+    chunk.updateNSection(sections.size());
+    return chunk;
+}
+
+static void expectSamePlayback(DspMemChunk &actualChunk, DspMemChunk &expectedChunk) {
+    auto expected = renderPwle(expectedChunk);
+    auto actual = renderPwle(actualChunk);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_NEAR(actual[i].amplitude, expected[i].amplitude, 1.0f / 2048) << "at " << i;
+        EXPECT_NEAR(actual[i].frequency, expected[i].frequency, 0.25f) << "at " << i;
+        EXPECT_EQ(actual[i].braking, expected[i].braking) << "at " << i;
+    }
+}
+
+TEST(DspMemChunkTest, optimizePwle_playsTheSame) {
+    std::vector<PwleSection> sections;
+    PwleSection section;
+    auto active = [&](int duration, float amplitude, float frequency, bool chirp) {
+        ASSERT_EQ(makeActiveSection(duration, amplitude, frequency, chirp, &section), 0);
+        sections.push_back(section);
+    };
+    auto braking = [&](int duration) {
+        ASSERT_EQ(makeBrakingSection(duration, Braking::CLAB, &section), 0);
+        sections.push_back(section);
+    };
+
+    // a ramp split into three primitives, each restating its start
+    active(0, 0.0f, 150.0f, false);
+    active(10, 0.125f, 150.0f, false);
+    active(0, 0.125f, 150.0f, false);
+    active(20, 0.375f, 150.0f, false);
+    active(0, 0.375f, 150.0f, false);
+    active(30, 0.75f, 150.0f, false);
+    // a chirp continuing at the same slope
+    active(10, 0.75f, 160.0f, true);
+    active(10, 0.75f, 170.0f, true);
+    // consecutive braking
+    braking(0);
+    braking(20);
+    braking(0);
+    braking(30);
+    // a step the optimizer must keep
+    active(0, 0.5f, 200.0f, false);
+    active(5, 0.5f, 200.0f, false);
+
+    auto original = encodePwle(sections);
+    optimizePwle(&sections);
+    auto optimized = encodePwle(sections);
+
+    EXPECT_EQ(sections.size(), 7);
+    EXPECT_LT(optimized.size(), original.size());
+    expectSamePlayback(optimized, original);
+}
+
+TEST(DspMemChunkTest, optimizePwle_keepsBends) {
+    std::vector<PwleSection> sections;
+    PwleSection section;
+
+    for (auto [duration, amplitude] : {std::pair{0, 0.0f}, {10, 0.2f}, {10, 0.3f}, {10, 0.2f}}) {
+        ASSERT_EQ(makeActiveSection(duration, amplitude, 150.0f, false, &section), 0);
+        sections.push_back(section);
+    }
+    optimizePwle(&sections);
+
+    EXPECT_EQ(sections.size(), 4);
+}
+
+TEST(DspMemChunkTest, updateRepeat_setsHeaderFields) {
+    DspMemChunk compose(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
+    DspMemChunk pwle(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE);
+
+    EXPECT_EQ(compose.flush(), 0);
+    EXPECT_EQ(compose.updateNSection(3), 0);
+    EXPECT_EQ(compose.updateRepeat(0x42), 0);
+    EXPECT_EQ(compose.updateRepeat(1, 1), -EINVAL);
+    EXPECT_EQ(bytes(compose), (std::vector<uint8_t>{0x00, 0x00, 0x03, 0x42}));
+
+    EXPECT_EQ(pwle.flush(), 0);
+    EXPECT_EQ(pwle.updateNSection(0x5A), 0);
+    EXPECT_EQ(pwle.updateRepeat(0x42, 0xABC), 0);
+    EXPECT_EQ(pwle.updateRepeat(1, 0x1000), -EINVAL);
+    EXPECT_EQ(bytes(pwle), (std::vector<uint8_t>{0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0xAB, 0xC5,
+                                                 0x00, 0xA0, 0x00, 0x00}));
+}
+
+TEST(DspMemChunkTest, foldComposeRepeats_foldsRunsAndPatterns) {
+    // a train of ticks, then the same again
+    std::vector<ComposeSection> sections;
+    for (int i = 0; i < 2; i++) {
+        sections.insert(sections.end(), 3, {50, WAVEFORM_LIGHT_TICK_INDEX, 0, 20});
+        sections.push_back({100, WAVEFORM_CLICK_INDEX, 0, 200});
+    }
+
+    EXPECT_EQ(foldComposeRepeats(&sections, COMPOSE_SIZE_MAX + 1), 1);
+    EXPECT_EQ(sections, (std::vector<ComposeSection>{
+                                {50, WAVEFORM_LIGHT_TICK_INDEX, 2, 20},
+                                {100, WAVEFORM_CLICK_INDEX, 0, 200},
+                        }));
+
+    // the last tick ends the composition without a delay
+    sections.assign(300, {50, WAVEFORM_LIGHT_TICK_INDEX, 0, 20});
+    sections.push_back({50, WAVEFORM_LIGHT_TICK_INDEX, 0, 0});
+
+    EXPECT_EQ(foldComposeRepeats(&sections, COMPOSE_SIZE_MAX + 1), 0);
+    EXPECT_EQ(sections, (std::vector<ComposeSection>{
+                                {50, WAVEFORM_LIGHT_TICK_INDEX, 255, 20},
+                                {50, WAVEFORM_LIGHT_TICK_INDEX, 43, 20},
+                                {50, WAVEFORM_LIGHT_TICK_INDEX, 0, 0},
+                        }));
+}
+
+TEST(DspMemChunkTest, composeImage_matchesEncoder) {
+    static constexpr ComposeImage<3> image({
+            {WAVEFORM_CLICK_INDEX, 100},
+            {WAVEFORM_THUD_INDEX, 0x1234},
+            {WAVEFORM_LIGHT_TICK_INDEX, 0},
+    });
+    const uint32_t volLevels[] = {35, 100, 0};
+    DspMemChunk expected(WAVEFORM_COMPOSE, 2044);
+
+    expected.constructComposeSegment(35, WAVEFORM_CLICK_INDEX, 0, 0, 100);
+    expected.constructComposeSegment(100, WAVEFORM_THUD_INDEX, 0, 0, 0x1234);
+    expected.constructComposeSegment(0, WAVEFORM_LIGHT_TICK_INDEX, 0, 0, 0);
+    expected.flush();
+    expected.updateNSection(3);
+
+    DspMemChunk chunk(image, volLevels);
+    EXPECT_EQ(chunk.type(), WAVEFORM_COMPOSE);
+    EXPECT_EQ(bytes(chunk), bytes(expected));
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
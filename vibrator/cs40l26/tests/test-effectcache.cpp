@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DspMemChunk.h"
+#include "EffectCache.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static EffectCache::Key key(uint32_t generation, int32_t delayMs) {
+    EffectCache::Key key;
+    key << generation << delayMs;
+    return key;
+}
+
+static EffectCache::Entry entry(uint32_t totalDurationMs) {
+    return {std::make_shared<DspMemChunk>(WAVEFORM_COMPOSE, 8), totalDurationMs};
+}
+
+TEST(EffectCacheTest, find_returnsInsertedEntry) {
+    EffectCache cache(2);
+    auto inserted = entry(42);
+
+    EXPECT_FALSE(cache.find(key(0, 10)));
+    cache.insert(key(0, 10), inserted);
+
+    auto found = cache.find(key(0, 10));
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->ch, inserted.ch);
+    EXPECT_EQ(found->totalDurationMs, 42);
+    EXPECT_FALSE(cache.find(key(1, 10)));
+    EXPECT_FALSE(cache.find(key(0, 11)));
+    EXPECT_EQ(cache.hits(), 1);
+    EXPECT_EQ(cache.misses(), 3);
+}
+
+TEST(EffectCacheTest, insert_evictsLeastRecentlyUsed) {
+    EffectCache cache(2);
+
+    cache.insert(key(0, 1), entry(1));
+    cache.insert(key(0, 2), entry(2));
+    EXPECT_TRUE(cache.find(key(0, 1)));
+    cache.insert(key(0, 3), entry(3));
+
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_TRUE(cache.find(key(0, 1)));
+    EXPECT_FALSE(cache.find(key(0, 2)));
+    EXPECT_TRUE(cache.find(key(0, 3)));
+}
+
+TEST(EffectCacheTest, insert_keepsExistingEntry) {
+    EffectCache cache(2);
+
+    cache.insert(key(0, 1), entry(1));
+    cache.insert(key(0, 1), entry(2));
+
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.find(key(0, 1))->totalDurationMs, 1);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "EffectPlan.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static const std::vector<uint32_t> EFFECT_DURATIONS_MS{0, 100, 12, 20, 40};
+
+static std::vector<uint8_t> bytes(const DspMemChunk &chunk) {
+    return {chunk.front(), chunk.front() + chunk.size()};
+}
+
+static PwleSection pwle(uint16_t delay, uint16_t amplitude) {
+    return {delay, amplitude, 600 /*150 Hz*/, 0};
+}
+
+TEST(EffectPlanTest, setEffect_addsColdStart) {
+    EffectPlan plan;
+
+    plan.setEffect(2, 50, EFFECT_DURATIONS_MS[2]);
+
+    EXPECT_EQ(plan.kind(), EffectPlan::Kind::EFFECT);
+    EXPECT_EQ(plan.effectIndex(), 2);
+    EXPECT_EQ(plan.volLevel(), 50);
+    EXPECT_EQ(plan.durationMs(), 12 + MAX_COLD_START_LATENCY_MS);
+}
+
+TEST(EffectPlanTest, setCompose_timesEffectsPausesAndRepeats) {
+    EffectPlan plan;
+
+    ASSERT_EQ(plan.setCompose({{0, 0, 0, 50}, {80, 2, 2, 20}, {100, 3, 0, 0}},
+                              EFFECT_DURATIONS_MS),
+              0);
+
+    EXPECT_EQ(plan.kind(), EffectPlan::Kind::COMPOSE);
+    EXPECT_EQ(plan.waveforms(), 1);
+    EXPECT_EQ(plan.durationMs(), MAX_COLD_START_LATENCY_MS + (50 + MAX_PAUSE_TIMING_ERROR_MS) +
+                                         3 * (12 + 20 + MAX_PAUSE_TIMING_ERROR_MS) + 20);
+
+    DspMemChunk expected(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
+    expected.constructComposeSegment(0, 0, 0, 0, 50);
+    expected.constructComposeSegment(80, 2, 2, 0, 20);
+    expected.constructComposeSegment(100, 3, 0, 0, 0);
+    expected.flush();
+    expected.updateNSection(3);
+    EXPECT_EQ(bytes(plan.encode(0, nullptr)), bytes(expected));
+}
+
+TEST(EffectPlanTest, setCompose_splitsIntoWaveforms) {
+    std::vector<ComposeSection> sections;
+    for (uint16_t i = 1; i <= COMPOSE_SIZE_MAX + 2; i++) {
+        sections.push_back({100, 1, 0, i});
+    }
+    EffectPlan single;
+    EffectPlan streamed(2, 8500);
+
+    EXPECT_EQ(single.setCompose(std::vector<ComposeSection>(sections), EFFECT_DURATIONS_MS),
+              -EINVAL);
+    EXPECT_EQ(single.kind(), EffectPlan::Kind::NONE);
+    ASSERT_EQ(streamed.setCompose(std::move(sections), EFFECT_DURATIONS_MS), 0);
+
+    const uint32_t n = COMPOSE_SIZE_MAX + 2;
+    EXPECT_EQ(streamed.waveforms(), 2);
+    EXPECT_EQ(streamed.sections(), n);
+    EXPECT_EQ(streamed.durationMs(), 2 * MAX_COLD_START_LATENCY_MS + 9 /*off time*/ +
+                                             n * (100 + MAX_PAUSE_TIMING_ERROR_MS) +
+                                             n * (n + 1) / 2);
+    EXPECT_EQ(streamed.encode(1, nullptr).size(), 4 + 8);
+}
+
+TEST(EffectPlanTest, setPwle_continuesFromPreviousWaveform) {
+    std::vector<PwleSection> sections{pwle(0, 0)};
+    for (int i = 0; i < COMPOSE_PWLE_SIZE_MAX_DEFAULT; i++) {
+        sections.push_back(pwle(40, i % 2 ? 0 : 1024));
+    }
+    EffectPlan plan(2);
+
+    ASSERT_EQ(plan.setPwle(std::move(sections)), 0);
+
+    EXPECT_EQ(plan.kind(), EffectPlan::Kind::PWLE);
+    EXPECT_EQ(plan.waveforms(), 2);
+    // the second waveform restates where the first one ended
+    EXPECT_EQ(plan.sections(), COMPOSE_PWLE_SIZE_MAX_DEFAULT + 2);
+    EXPECT_EQ(plan.durationMs(),
+              2 * MAX_COLD_START_LATENCY_MS + COMPOSE_PWLE_SIZE_MAX_DEFAULT * 10);
+
+    DspMemChunk expected(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE);
+    expected.constructPwleSection(pwle(0, 0));
+    expected.constructPwleSection(pwle(40, 1024));
+    expected.flush();
+    expected.updateWLength(10 + MAX_COLD_START_LATENCY_MS);
+    expected.updateNSection(2);
+    EXPECT_EQ(bytes(plan.encode(1, nullptr)), bytes(expected));
+}
+
+TEST(EffectPlanTest, setPwle_rejectsWaveformsTooLong) {
+    std::vector<PwleSection> sections{pwle(0, 0)};
+    // longer than the waveform length field holds, 0x7FFFF ms
+    for (int i = 0; i < 40; i++) {
+        sections.push_back(pwle(UINT16_MAX, i % 2 ? 0 : 1024));
+    }
+    EffectPlan plan(8);
+
+    EXPECT_EQ(plan.setPwle(std::move(sections)), -EINVAL);
+    EXPECT_EQ(plan.kind(), EffectPlan::Kind::NONE);
+    EXPECT_EQ(plan.durationMs(), 0);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <thread>
+
+#include "FakeDevice.h"
+#include "Hardware.h"
+#include "InputDiscovery.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+static constexpr std::chrono::milliseconds TIMEOUT{1000};
+
+// Drives the real HwApi/HwCal classes against a uinput device, end to end.
+class FakeDeviceTest : public Test {
+  public:
+    void SetUp() override {
+        mDevice = std::make_unique<FakeDevice>("cs40l26_input", mSysfsDir.path);
+        if (!mDevice->ok()) {
+            GTEST_SKIP() << "uinput is not available";
+        }
+
+        setenv("INPUT_EVENT_NAME", "cs40l26_input", true);
+        setenv("INPUT_EVENT_PATH", "/dev/input/event*", true);
+        setenv("HWAPI_PATH_PREFIX", mDevice->sysfsPrefix().c_str(), true);
+        setenv("CALIBRATION_FILEPATH", mCalFile.path, true);
+
+        mVibrator = ndk::SharedRefBase::make<Vibrator>(HwApi::Create(), HwCal::Create(), nullptr,
+                                                       nullptr, std::make_unique<FakeGPIO>());
+        mVibrator->init();
+    }
+
+  protected:
+    TemporaryDir mSysfsDir;
+    TemporaryFile mCalFile;
+    std::unique_ptr<FakeDevice> mDevice;
+    std::shared_ptr<Vibrator> mVibrator;
+};
+
+TEST_F(FakeDeviceTest, perform_playsAndCompletes) {
+    auto callback = ndk::SharedRefBase::make<CompletionCallback>();
+    int32_t lengthMs;
+
+    EXPECT_TRUE(mVibrator->perform(Effect::CLICK, EffectStrength::MEDIUM, callback, &lengthMs)
+                        .isOk());
+    EXPECT_TRUE(mDevice->waitForPlays(1, TIMEOUT));
+    EXPECT_TRUE(callback->waitForCompletions(1, TIMEOUT));
+    EXPECT_GE(callback->lastCompletion(), mDevice->lastStop());
+}
+
+TEST_F(FakeDeviceTest, off_stopsPlayback) {
+    auto callback = ndk::SharedRefBase::make<CompletionCallback>();
+
+    EXPECT_TRUE(mVibrator->on(60000, callback).isOk());
+    EXPECT_TRUE(mDevice->waitForPlays(1, TIMEOUT));
+    EXPECT_TRUE(mVibrator->off().isOk());
+    EXPECT_TRUE(callback->waitForCompletions(1, TIMEOUT));
+}
+
+TEST_F(FakeDeviceTest, initAsync_callsWaitUntilReady) {
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(HwApi::Create(), HwCal::Create(), nullptr,
+                                                       nullptr, std::make_unique<FakeGPIO>());
+    auto callback = ndk::SharedRefBase::make<CompletionCallback>();
+    int32_t lengthMs;
+
+    mVibrator.reset();
+    vibrator->initAsync();
+    EXPECT_TRUE(vibrator->perform(Effect::CLICK, EffectStrength::MEDIUM, callback, &lengthMs)
+                        .isOk());
+    EXPECT_TRUE(mDevice->waitForPlays(1, TIMEOUT));
+    EXPECT_TRUE(callback->waitForCompletions(1, TIMEOUT));
+}
+
+TEST_F(FakeDeviceTest, eraseOwtEffect_erasesOnlyThatEffect) {
+    std::vector<::android::base::unique_fd> fds;
+    auto api = HwApi::Create();
+    std::vector<uint8_t> owtData(16);
+    std::vector<ff_effect> effects(WAVEFORM_MAX_INDEX);
+    std::vector<uint32_t> ids;
+
+    ASSERT_TRUE(InputDiscovery("/dev/input/event*").find({"cs40l26_input"}, &fds, TIMEOUT));
+    // past the physical effects, so the third one lands at WAVEFORM_MAX_INDEX
+    for (int i = 0; i < 3; i++) {
+        ff_effect effect = {
+                .type = FF_PERIODIC,
+                .id = -1,
+                .u.periodic.waveform = FF_CUSTOM,
+        };
+        uint32_t id;
+        int status;
+
+        ASSERT_TRUE(api->uploadOwtEffect(fds[0], owtData.data(), owtData.size(), &effect, &id,
+                                         &status));
+        ids.push_back(id);
+    }
+    ASSERT_EQ(ids.back(), WAVEFORM_MAX_INDEX);
+
+    EXPECT_TRUE(api->eraseOwtEffect(fds[0], ids.back(), &effects));
+    EXPECT_FALSE(mDevice->hasEffect(ids[2]));
+    EXPECT_TRUE(mDevice->hasEffect(ids[0]));
+    EXPECT_TRUE(mDevice->hasEffect(ids[1]));
+}
+
+TEST(InputDiscoveryTest, find_timesOutWithoutDevice) {
+    TemporaryDir dir;
+    std::vector<::android::base::unique_fd> fds;
+    auto start = FakeDevice::Clock::now();
+
+    EXPECT_FALSE(InputDiscovery(std::string(dir.path) + "/event*")
+                         .find({"cs40l26_input"}, &fds, std::chrono::milliseconds(50)));
+    EXPECT_GE(FakeDevice::Clock::now() - start, std::chrono::milliseconds(50));
+    ASSERT_EQ(fds.size(), 1);
+    EXPECT_FALSE(fds[0].ok());
+}
+
+TEST(InputDiscoveryTest, find_waitsForLateDevices) {
+    TemporaryDir sysfsDir;
+    std::vector<::android::base::unique_fd> fds;
+    std::unique_ptr<FakeDevice> base, dual;
+
+    if (access("/dev/uinput", W_OK)) {
+        GTEST_SKIP() << "uinput is not available";
+    }
+    std::thread create([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        base = std::make_unique<FakeDevice>("cs40l26_input", sysfsDir.path);
+        dual = std::make_unique<FakeDevice>("cs40l26_dual_input", sysfsDir.path);
+    });
+    bool found = InputDiscovery("/dev/input/event*")
+                         .find({"cs40l26_input", "cs40l26_dual_input"}, &fds, TIMEOUT);
+    create.join();
+
+    if (!base->ok() || !dual->ok()) {
+        GTEST_SKIP() << "uinput is not available";
+    }
+    EXPECT_TRUE(found);
+    ASSERT_EQ(fds.size(), 2);
+    EXPECT_TRUE(fds[0].ok());
+    EXPECT_TRUE(fds[1].ok());
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -18,9 +18,12 @@
 #include <cutils/fs.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstdlib>
 #include <fstream>
+#include <thread>
 
+#include "FakeDevice.h"
 #include "Hardware.h"
 
 namespace aidl {
@@ -45,11 +48,14 @@ class HwApiTest : public Test {
             "default/owt_free_space",
             "default/num_waves",
             "default/delay_before_stop_playback_us",
+            "default/vibe_state",
     };
 
   public:
     void SetUp() override {
         std::string prefix;
+
+        watchRegularFiles();
         for (auto n : FILE_NAMES) {
             auto name = std::filesystem::path(n);
             auto path = std::filesystem::path(mFilesDir.path) / name;
@@ -116,6 +122,174 @@ class HwApiTest : public Test {
     std::map<std::string, std::stringstream> mExpectedContent;
 };
 
+TEST_F(HwApiTest, pollVibeState_alreadyReached) {
+    expectAndUpdateContent("default/vibe_state", 1);
+
+    EXPECT_TRUE(mHwApi->pollVibeState(1, 0));
+}
+
+TEST_F(HwApiTest, pollVibeState_reachedLater) {
+    expectAndUpdateContent("default/vibe_state", 1);
+
+    std::thread writer{[this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // Overwrite in place so the reader never observes a truncated file.
+        std::fstream(mFileMap["default/vibe_state"]) << 0 << std::endl;
+    }};
+
+    EXPECT_TRUE(mHwApi->pollVibeState(0, 1000));
+    writer.join();
+
+    mExpectedContent["default/vibe_state"] = std::stringstream{};
+    expectContent("default/vibe_state", 0);
+}
+
+TEST_F(HwApiTest, pollVibeState_timeout) {
+    expectAndUpdateContent("default/vibe_state", 1);
+
+    EXPECT_FALSE(mHwApi->pollVibeState(0, 10));
+    EXPECT_EQ(errno, ETIMEDOUT);
+}
+
+TEST_F(HwApiTest, pollVibeState_cancelled) {
+    expectAndUpdateContent("default/vibe_state", 1);
+    std::atomic<bool> cancelled{false};
+
+    std::thread canceller{[this, &cancelled] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        cancelled = true;
+        mHwApi->wakePolls();
+    }};
+
+    EXPECT_FALSE(mHwApi->pollVibeState(0, -1, [&cancelled] { return cancelled.load(); }));
+    EXPECT_EQ(errno, ECANCELED);
+    canceller.join();
+}
+
+TEST_F(HwApiTest, pollVibeState_timeoutDespiteNotifications) {
+    expectAndUpdateContent("default/vibe_state", 1);
+    std::atomic<bool> done{false};
+    auto start = std::chrono::steady_clock::now();
+
+    // Keep notifying without ever reaching the polled value.
+    std::thread writer{[this, &done, start] {
+        while (!done && std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            std::fstream(mFileMap["default/vibe_state"]) << 1 << std::endl;
+        }
+    }};
+
+    EXPECT_FALSE(mHwApi->pollVibeState(0, 50));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    done = true;
+    writer.join();
+}
+
+TEST_F(HwApiTest, pollVibeState_failure) {
+    EXPECT_FALSE(mNoApi->pollVibeState(0, 10));
+    EXPECT_NE(errno, ETIMEDOUT);
+}
+
+TEST_F(HwApiTest, setF0Offset_skipsUnchangedValue) {
+    EXPECT_TRUE(mHwApi->setF0Offset(1));
+
+    // modified behind the HAL's back, so a skipped write leaves this in place
+    updateContent("default/f0_offset", 2);
+    EXPECT_TRUE(mHwApi->setF0Offset(1));
+    EXPECT_TRUE(mHwApi->setF0Offset(1));
+    expectContent("default/f0_offset", 2);
+}
+
+TEST_F(HwApiTest, setF0Offset_writesChangedValue) {
+    EXPECT_TRUE(mHwApi->setF0Offset(1));
+    EXPECT_TRUE(mHwApi->setF0Offset(2));
+    expectContent("default/f0_offset", 2);
+}
+
+TEST_F(HwApiTest, debug_reportsLatency) {
+    TemporaryFile dump;
+    uint32_t count;
+    std::string output;
+
+    expectContent("default/f0_offset", 2);
+    expectAndUpdateContent("default/num_waves", 1);
+
+    EXPECT_TRUE(mHwApi->getEffectCount(&count));
+    EXPECT_TRUE(mHwApi->getEffectCount(&count));
+    EXPECT_TRUE(mHwApi->setF0Offset(2));
+    // skipped writes are not timed
+    EXPECT_TRUE(mHwApi->setF0Offset(2));
+
+    mHwApi->debug(dump.fd);
+    std::ifstream file{dump.path};
+    output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    EXPECT_NE(std::string::npos, output.find("get default/num_waves: n=2 p50="));
+    EXPECT_NE(std::string::npos, output.find("set default/f0_offset: n=1 p50="));
+    EXPECT_EQ(std::string::npos, output.find("get default/f0_offset:"));
+}
+
+TEST_F(HwApiTest, uring_batchesUntilSubmit) {
+    std::string prefix = std::filesystem::path(mFilesDir.path) / "";
+    uint32_t count = 0;
+
+    setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+    auto hwapi = HwApiUring::Create();
+    if (!hwapi) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    expectAndUpdateContent("default/num_waves", 7);
+    expectContent("default/f0_offset", 5);
+
+    hwapi->beginBatch();
+    EXPECT_TRUE(hwapi->setF0Offset(5));
+    EXPECT_TRUE(hwapi->getEffectCount(&count));
+    EXPECT_EQ(0, count);
+    EXPECT_TRUE(hwapi->submitBatch());
+    EXPECT_EQ(7, count);
+}
+
+TEST_F(HwApiTest, uring_reportsFailureOnSubmit) {
+    std::string prefix = std::filesystem::path(mEmptyDir.path) / "";
+    uint32_t count;
+
+    setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+    auto hwapi = HwApiUring::Create();
+    if (!hwapi) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    hwapi->beginBatch();
+    EXPECT_TRUE(hwapi->setF0Offset(5));
+    EXPECT_TRUE(hwapi->getEffectCount(&count));
+    EXPECT_FALSE(hwapi->submitBatch());
+}
+
+TEST_F(HwApiTest, debug_keepsLatestRecords) {
+    std::string prefix = std::filesystem::path(mFilesDir.path) / "";
+    TemporaryFile dump;
+    std::string output;
+
+    setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+    setenv("HWAPI_RECORDS_SIZE", "2", true);
+    auto hwapi = std::make_unique<HwApi>();
+    unsetenv("HWAPI_RECORDS_SIZE");
+
+    for (uint32_t value : {1, 2, 3}) {
+        EXPECT_TRUE(hwapi->setF0Offset(value));
+    }
+    expectContent("default/f0_offset", 3);
+
+    hwapi->debug(dump.fd);
+    std::ifstream file{dump.path};
+    output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    EXPECT_EQ(std::string::npos, output.find("set 'default/f0_offset' = '1'"));
+    EXPECT_NE(std::string::npos, output.find("set 'default/f0_offset' = '2'"));
+    EXPECT_NE(std::string::npos, output.find("set 'default/f0_offset' = '3'"));
+}
+
 template <typename T>
 class HwApiTypedTest : public HwApiTest,
                        public WithParamInterface<std::tuple<std::string, std::function<T>>> {
@@ -130,6 +304,41 @@ class HwApiTypedTest : public HwApiTest,
 
 using HasTest = HwApiTypedTest<bool(Vibrator::HwApi &)>;
 
+TEST_F(HwApiTest, debug_skipsRecordsBeingWritten) {
+    std::string prefix = std::filesystem::path(mFilesDir.path) / "";
+    std::atomic<bool> done{false};
+
+    setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+    setenv("HWAPI_RECORDS_SIZE", "4", true);
+    auto hwapi = std::make_unique<HwApi>();
+    unsetenv("HWAPI_RECORDS_SIZE");
+
+    uint32_t last = 0;
+
+    // Values of the same width, since writes do not truncate the file.
+    std::thread writer{[&hwapi, &done, &last] {
+        for (uint32_t value = 0; !done; value++) {
+            hwapi->setF0Offset(last = 100 + value % 900);
+        }
+    }};
+
+    for (int i = 0; i < 50; i++) {
+        TemporaryFile dump;
+        hwapi->debug(dump.fd);
+        std::ifstream file{dump.path};
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.find("'default/f0_offset'") != std::string::npos) {
+                EXPECT_NE(std::string::npos, line.find("] set 'default/f0_offset' = '")) << line;
+            }
+        }
+    }
+
+    done = true;
+    writer.join();
+    expectContent("default/f0_offset", last);
+}
+
 TEST_P(HasTest, success_returnsTrue) {
     auto param = GetParam();
     auto func = std::get<1>(param);
@@ -166,6 +375,24 @@ TEST_P(GetUint32Test, success) {
     EXPECT_EQ(expect, actual);
 }
 
+TEST_P(GetUint32Test, rereadsUpdatedValue) {
+    auto param = GetParam();
+    auto name = std::get<0>(param);
+    auto func = std::get<1>(param);
+    uint32_t first = std::rand();
+    uint32_t expect = ~first;
+    uint32_t actual;
+
+    updateContent(name, first);
+    EXPECT_TRUE(func(*mHwApi, &actual));
+    EXPECT_EQ(first, actual);
+
+    expectAndUpdateContent(name, expect);
+
+    EXPECT_TRUE(func(*mHwApi, &actual));
+    EXPECT_EQ(expect, actual);
+}
+
 TEST_P(GetUint32Test, failure) {
     auto param = GetParam();
     auto func = std::get<1>(param);
@@ -282,6 +509,21 @@ INSTANTIATE_TEST_CASE_P(
         }),
         SetStringTest::PrintParam);
 
+TEST(HwApiParseTest, fixedString_readsToken) {
+    static constexpr std::string_view text{"  0x1234abcd\n"};
+    utils::FixedString<16> value;
+
+    EXPECT_TRUE(utils::parse(text.data(), text.data() + text.size(), &value));
+    EXPECT_EQ(std::string_view(value), "0x1234abcd");
+}
+
+TEST(HwApiParseTest, fixedString_rejectsOversizedToken) {
+    static constexpr std::string_view text{"0x1234abcd"};
+    utils::FixedString<4> value;
+
+    EXPECT_FALSE(utils::parse(text.data(), text.data() + text.size(), &value));
+}
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
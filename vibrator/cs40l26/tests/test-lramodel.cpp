@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "LraModel.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+TEST(LraModelTest, acceleration_peaksAtResonance) {
+    LraModel lra(150, 10);
+
+    EXPECT_NEAR(lra.acceleration(150), 10, 1e-4);
+    EXPECT_LT(lra.acceleration(50), 0.2);
+    // the mass barely moves far below f0 and follows the force far above it
+    EXPECT_LT(lra.acceleration(1), 1e-3);
+    EXPECT_NEAR(lra.acceleration(15000), 1, 1e-3);
+}
+
+TEST(LraModelTest, isValid_rejectsMissingCalibration) {
+    EXPECT_TRUE(LraModel(150, 10).isValid());
+    EXPECT_FALSE(LraModel(0, 10).isValid());
+    EXPECT_FALSE(LraModel(150, 0).isValid());
+    EXPECT_FALSE(LraModel(NAN, 10).isValid());
+}
+
+TEST(LraModelTest, bandwidthAmplitudeMap_isNormalizedToThePeak) {
+    LraModel lra(150, 10);
+
+    auto map = lra.bandwidthAmplitudeMap(1, 1, 1000);
+
+    ASSERT_EQ(map.size(), 1000);
+    auto peak = std::max_element(map.begin(), map.end());
+    EXPECT_EQ(*peak, 1);
+    EXPECT_EQ(peak - map.begin(), 150 - 1);
+    for (auto amplitude : map) {
+        EXPECT_GE(amplitude, 0);
+        EXPECT_LE(amplitude, 1);
+    }
+    EXPECT_NEAR(map[50 - 1], lra.acceleration(50) / lra.acceleration(150), 1e-6);
+    // a higher Q narrows the bandwidth
+    EXPECT_LT(LraModel(150, 30).bandwidthAmplitudeMap(1, 1, 1000)[200 - 1], map[200 - 1]);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
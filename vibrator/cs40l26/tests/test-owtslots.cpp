@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "OwtSlots.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+TEST(OwtSlotsTest, find_returnsInsertedId) {
+    OwtSlots slots(4, 8);
+
+    EXPECT_EQ(slots.find("click"), -1);
+    slots.insert("click", 13);
+    EXPECT_EQ(slots.find("click"), 13);
+    EXPECT_EQ(slots.find("thud"), -1);
+    EXPECT_EQ(slots.size(), 1);
+    EXPECT_EQ(slots.bytes(), 5);
+    EXPECT_EQ(slots.hits(), 1);
+    EXPECT_EQ(slots.misses(), 2);
+}
+
+TEST(OwtSlotsTest, waveform_looksUpById) {
+    OwtSlots slots(4, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+    EXPECT_EQ(slots.waveform(13), "click");
+    EXPECT_EQ(slots.waveform(14), "thud");
+    EXPECT_EQ(slots.waveform(15), "");
+    EXPECT_EQ(slots.hits(), 0);
+}
+
+TEST(OwtSlotsTest, insert_skipsOversizedWaveform) {
+    OwtSlots slots(4, 8);
+
+    slots.insert("clickclick", 13);
+    EXPECT_EQ(slots.size(), 0);
+    EXPECT_EQ(slots.find("clickclick"), -1);
+}
+
+TEST(OwtSlotsTest, evict_reusesBuffer) {
+    OwtSlots slots(1, 8);
+
+    slots.insert("click", 13);
+    EXPECT_EQ(slots.evict(), 13);
+    slots.insert("thud", 14);
+    EXPECT_EQ(slots.waveform(14), "thud");
+    EXPECT_EQ(slots.find("click"), -1);
+    EXPECT_EQ(slots.find("thud"), 14);
+}
+
+TEST(OwtSlotsTest, evict_removesLeastRecentlyUsed) {
+    OwtSlots slots(2, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+    EXPECT_TRUE(slots.full());
+    EXPECT_EQ(slots.find("click"), 13);
+
+    EXPECT_EQ(slots.evict(), 14);
+    EXPECT_FALSE(slots.full());
+    EXPECT_EQ(slots.find("thud"), -1);
+    EXPECT_EQ(slots.evict(), 13);
+    EXPECT_EQ(slots.evict(), -1);
+    EXPECT_EQ(slots.bytes(), 0);
+    EXPECT_EQ(slots.evictions(), 2);
+}
+
+TEST(OwtSlotsTest, evict_skipsKeptEffect) {
+    OwtSlots slots(2, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+
+    EXPECT_EQ(slots.evict(13), 14);
+    EXPECT_EQ(slots.evict(13), -1);
+    EXPECT_EQ(slots.find("click"), 13);
+}
+
+TEST(OwtSlotsTest, evict_skipsPinnedWaveform) {
+    OwtSlots slots(2, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+    EXPECT_EQ(slots.pin("spin"), 0);
+    uint64_t first = slots.pin("click");
+    uint64_t second = slots.pin("click");
+    EXPECT_NE(first, 0);
+
+    EXPECT_EQ(slots.evict(), 14);
+    EXPECT_EQ(slots.evict(), -1);
+    slots.unpin(first);
+    EXPECT_EQ(slots.evict(), -1);
+    slots.unpin(second);
+    EXPECT_EQ(slots.evict(), 13);
+}
+
+TEST(OwtSlotsTest, unpin_ignoresWaveformInsertedAgain) {
+    OwtSlots slots(2, 8);
+
+    slots.insert("click", 13);
+    uint64_t stale = slots.pin("click");
+    slots.erase(13);
+    slots.insert("click", 13);
+    uint64_t pin = slots.pin("click");
+
+    slots.unpin(stale);
+    EXPECT_EQ(slots.evict(), -1);
+    slots.unpin(pin);
+    EXPECT_EQ(slots.evict(), 13);
+}
+
+TEST(OwtSlotsTest, erase_keepsOtherWaveforms) {
+    OwtSlots slots(3, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+    slots.insert("spin", 15);
+    slots.erase(14);
+
+    EXPECT_EQ(slots.size(), 2);
+    EXPECT_EQ(slots.bytes(), 9);
+    EXPECT_EQ(slots.find("thud"), -1);
+    EXPECT_EQ(slots.find("click"), 13);
+    EXPECT_EQ(slots.find("spin"), 15);
+    EXPECT_EQ(slots.evictions(), 0);
+}
+
+TEST(OwtSlotsTest, clear_forgetsAll) {
+    OwtSlots slots(2, 8);
+
+    slots.insert("click", 13);
+    slots.insert("thud", 14);
+    slots.clear();
+
+    EXPECT_EQ(slots.size(), 0);
+    EXPECT_EQ(slots.bytes(), 0);
+    EXPECT_EQ(slots.find("click"), -1);
+    EXPECT_EQ(slots.evict(), -1);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "PlaybackState.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using Phase = PlaybackState::Phase;
+
+TEST(PlaybackStateTest, transition_movesFromTheStateRead) {
+    PlaybackState playback;
+    PlaybackState::State state = playback.load();
+
+    EXPECT_EQ(state.phase, Phase::IDLE);
+    ASSERT_TRUE(playback.transition(&state, Phase::UPLOADING, -1, state.playback + 1));
+    ASSERT_TRUE(playback.transition(&state, Phase::ARMED, 3, state.playback));
+    ASSERT_TRUE(playback.transition(&state, Phase::PLAYING));
+
+    state = playback.load();
+    EXPECT_EQ(state.phase, Phase::PLAYING);
+    EXPECT_EQ(state.effectIndex, 3);
+    EXPECT_EQ(state.playback, 1);
+    EXPECT_EQ(playback.duration(Phase::IDLE).count(), 1);
+    EXPECT_EQ(playback.duration(Phase::UPLOADING).count(), 1);
+    EXPECT_EQ(playback.duration(Phase::ARMED).count(), 1);
+    EXPECT_EQ(playback.duration(Phase::PLAYING).count(), 0);
+}
+
+TEST(PlaybackStateTest, transition_failsOnceTheStateMoved) {
+    PlaybackState playback;
+    PlaybackState::State stale = playback.load();
+    PlaybackState::State state = stale;
+
+    ASSERT_TRUE(playback.transition(&state, Phase::UPLOADING, -1, state.playback + 1));
+    // cancelled, as off() would
+    ASSERT_TRUE(playback.transition(&state, Phase::IDLE));
+
+    EXPECT_FALSE(playback.transition(&stale, Phase::UPLOADING, -1, stale.playback + 1));
+    EXPECT_EQ(stale.phase, Phase::IDLE);
+    EXPECT_EQ(stale.playback, 1);
+    EXPECT_EQ(playback.duration(Phase::UPLOADING).count(), 1);
+}
+
+TEST(PlaybackStateTest, waitFor_wakesOnTransition) {
+    PlaybackState playback;
+    PlaybackState::State state = playback.load();
+    ASSERT_TRUE(playback.transition(&state, Phase::UPLOADING, -1, state.playback + 1));
+
+    std::thread cancel([&playback, state]() mutable {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        playback.transition(&state, Phase::IDLE);
+    });
+    EXPECT_TRUE(playback.waitFor([](auto &s) { return s.phase == Phase::IDLE; },
+                                 std::chrono::seconds(5), &state));
+    cancel.join();
+
+    EXPECT_EQ(state.phase, Phase::IDLE);
+    EXPECT_FALSE(playback.waitFor([](auto &s) { return s.phase == Phase::PLAYING; },
+                                  std::chrono::milliseconds(1), &state));
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
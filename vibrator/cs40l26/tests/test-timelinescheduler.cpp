@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "TimelineScheduler.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr int64_t MS = 1000000;
+
+TEST(TimelineSchedulerTest, schedule_firesEntriesAtTheirStartTime) {
+    TimelineScheduler scheduler;
+    std::vector<int64_t> firedNs;
+    std::promise<void> promise;
+    const int64_t startNs = Histogram::now() + 5 * MS;
+
+    ASSERT_EQ(scheduler.schedule({
+                      {startNs, [&] { firedNs.push_back(Histogram::now()); }},
+                      {startNs + 10 * MS, [&] { firedNs.push_back(Histogram::now()); }},
+                      {startNs + 10 * MS,
+                       [&] {
+                           firedNs.push_back(Histogram::now());
+                           promise.set_value();
+                       }},
+              }),
+              0);
+
+    ASSERT_EQ(promise.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    ASSERT_EQ(firedNs.size(), 3);
+    EXPECT_GE(firedNs[0], startNs);
+    EXPECT_GE(firedNs[1], startNs + 10 * MS);
+    EXPECT_GE(firedNs[2], firedNs[1]);
+    EXPECT_EQ(scheduler.pending(), 0);
+    EXPECT_EQ(scheduler.error().count(), 3);
+}
+
+TEST(TimelineSchedulerTest, schedule_firesPastEntriesRightAway) {
+    TimelineScheduler scheduler;
+    std::promise<void> promise;
+
+    ASSERT_EQ(scheduler.schedule({{0, [&] { promise.set_value(); }}}), 0);
+
+    EXPECT_EQ(promise.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+}
+
+TEST(TimelineSchedulerTest, schedule_replacesQueuedEntries) {
+    TimelineScheduler scheduler;
+    bool replaced = false;
+    std::promise<void> promise;
+    auto dropped = std::make_shared<int>();
+
+    ASSERT_EQ(scheduler.schedule({{Histogram::now() + 10 * MS, [&, dropped] { replaced = true; }}}),
+              0);
+    ASSERT_EQ(scheduler.schedule({{Histogram::now() + 20 * MS, [&] { promise.set_value(); }}}), 0);
+
+    // the replaced entry let go of what it captured
+    EXPECT_EQ(dropped.use_count(), 1);
+    ASSERT_EQ(promise.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_FALSE(replaced);
+}
+
+TEST(TimelineSchedulerTest, cancel_dropsQueuedEntries) {
+    bool fired = false;
+
+    {
+        TimelineScheduler scheduler;
+        ASSERT_EQ(scheduler.schedule({{Histogram::now() + 10 * MS, [&] { fired = true; }}}), 0);
+        ASSERT_EQ(scheduler.cancel(), 0);
+        EXPECT_EQ(scheduler.pending(), 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    EXPECT_FALSE(fired);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
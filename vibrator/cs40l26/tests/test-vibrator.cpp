@@ -15,13 +15,19 @@
  */
 
 #include <aidl/android/hardware/vibrator/BnVibratorCallback.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <linux/input.h>
 #include <linux/uinput.h>
 
+#include <condition_variable>
+#include <fstream>
 #include <future>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include "Vibrator.h"
 #include "mocks.h"
@@ -36,6 +42,7 @@ namespace vibrator {
 using ::testing::_;
 using ::testing::AnyNumber;
 using ::testing::Assign;
+using ::testing::ByMove;
 using ::testing::AtLeast;
 using ::testing::AtMost;
 using ::testing::Combine;
@@ -45,8 +52,10 @@ using ::testing::Exactly;
 using ::testing::Expectation;
 using ::testing::ExpectationSet;
 using ::testing::Ge;
+using ::testing::Invoke;
 using ::testing::Mock;
 using ::testing::MockFunction;
+using ::testing::NiceMock;
 using ::testing::Range;
 using ::testing::Return;
 using ::testing::Sequence;
@@ -88,6 +97,9 @@ static constexpr uint32_t MIN_ON_OFF_INTERVAL_US = 8500;
 static constexpr uint8_t VOLTAGE_SCALE_MAX = 100;
 static constexpr int8_t MAX_COLD_START_LATENCY_MS = 6;  // I2C Transaction + DSP Return-From-Standby
 static constexpr auto POLLING_TIMEOUT = 20;
+static constexpr int32_t STOP_TIMEOUT_MS = 20;
+static constexpr size_t COMPOSE_SIZE_MAX = 254;
+static constexpr uint16_t GPIO_TRIGGER_CONFIG = 0x9100;
 enum WaveformIndex : uint16_t {
     /* Physical waveform */
     WAVEFORM_LONG_VIBRATION_EFFECT_INDEX = 0,
@@ -227,9 +239,10 @@ class VibratorTest : public Test {
         ON_CALL(*mMockApi, setFFGain(_, _)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, setFFEffect(_, _, _)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, setFFPlay(_, _, _)).WillByDefault(Return(true));
-        ON_CALL(*mMockApi, pollVibeState(_, _)).WillByDefault(Return(true));
+        ON_CALL(*mMockApi, pollVibeState(_, _, _)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, eraseOwtEffect(_, _, _)).WillByDefault(Return(true));
+        ON_CALL(*mMockApi, flushOwtEffects(_, _)).WillByDefault(Return(true));
 
         ON_CALL(*mMockApi, getOwtFreeSpace(_))
                 .WillByDefault(DoAll(SetArgPointee<0>(11504), Return(true)));
@@ -258,8 +271,10 @@ class VibratorTest : public Test {
         }
         // TODO(b/261415845): Need to add dual parameters to test the vibrator HAL's code in haptics
         // mock test
-        mVibrator = ndk::SharedRefBase::make<Vibrator>(std::move(mockapi), std::move(mockcal),
-                                                       nullptr, nullptr, std::move(mockgpio));
+        auto vibrator = ndk::SharedRefBase::make<Vibrator>(
+                std::move(mockapi), std::move(mockcal), nullptr, nullptr, std::move(mockgpio));
+        vibrator->init();
+        mVibrator = vibrator;
         if (relaxed) {
             relaxMock(false);
         }
@@ -288,7 +303,7 @@ class VibratorTest : public Test {
         EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(times);
         EXPECT_CALL(*mMockApi, setF0CompEnable(_)).Times(times);
         EXPECT_CALL(*mMockApi, setRedcCompEnable(_)).Times(times);
-        EXPECT_CALL(*mMockApi, pollVibeState(_, _)).Times(times);
+        EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(times);
         EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(times);
         EXPECT_CALL(*mMockApi, setFFEffect(_, _, _)).Times(times);
         EXPECT_CALL(*mMockApi, setFFPlay(_, _, _)).Times(times);
@@ -309,6 +324,7 @@ class VibratorTest : public Test {
         EXPECT_CALL(*mMockCal, getLongFrequencyShift(_)).Times(times);
         EXPECT_CALL(*mMockCal, isF0CompEnabled()).Times(times);
         EXPECT_CALL(*mMockCal, isRedcCompEnabled()).Times(times);
+        EXPECT_CALL(*mMockCal, isPreemptionEnabled()).Times(times);
         EXPECT_CALL(*mMockCal, debug(_)).Times(times);
     }
 
@@ -368,6 +384,7 @@ TEST_F(VibratorTest, Constructor) {
     EXPECT_CALL(*mMockApi, setF0CompEnable(true)).WillOnce(Return(true));
     EXPECT_CALL(*mMockCal, isRedcCompEnabled()).WillOnce(Return(true));
     EXPECT_CALL(*mMockApi, setRedcCompEnable(true)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockCal, isPreemptionEnabled()).WillOnce(Return(true));
 
     EXPECT_CALL(*mMockCal, isChirpEnabled()).WillOnce(Return(true));
     EXPECT_CALL(*mMockCal, getSupportedPrimitives(_))
@@ -398,6 +415,366 @@ TEST_F(VibratorTest, off) {
     EXPECT_TRUE(mVibrator->off().isOk());
 }
 
+TEST_F(VibratorTest, on_preemptsPlayingEffect) {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto cal = std::make_unique<NiceMock<MockCal>>();
+    auto first = ndk::SharedRefBase::make<MockVibratorCallback>();
+    auto second = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> stop;
+    std::shared_future<void> stopped{stop.get_future()};
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFEffect(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, pollVibeState(1, _, _)).WillByDefault(Return(true));
+    // the first effect plays until the test lets it stop
+    ON_CALL(*api, pollVibeState(0, _, _))
+            .WillByDefault(Invoke([stopped](uint32_t, int32_t, const std::function<bool()> &) {
+                stopped.wait();
+                return true;
+            }));
+    EXPECT_CALL(*api, setFFPlay(_, _, true)).Times(2);
+    EXPECT_CALL(*api, setFFPlay(_, ON_EFFECT_INDEX, false)).WillOnce(Return(true));
+    ON_CALL(*cal, isPreemptionEnabled()).WillByDefault(Return(true));
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api), std::move(cal), nullptr,
+                                                       nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+
+    EXPECT_TRUE(vibrator->on(1000, first).isOk());
+    // the preempted effect completes as cancelled before the next one starts
+    EXPECT_CALL(*first, onComplete()).WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+    EXPECT_TRUE(vibrator->on(1000, second).isOk());
+    Mock::VerifyAndClearExpectations(first.get());
+
+    EXPECT_CALL(*second, onComplete()).WillOnce([&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    });
+    stop.set_value();
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+}
+
+TEST_F(VibratorTest, on_doesNotWaitForStopOfPreemptedEffect) {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto cal = std::make_unique<NiceMock<MockCal>>();
+    auto first = ndk::SharedRefBase::make<NiceMock<MockVibratorCallback>>();
+    auto second = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::mutex mutex;
+    std::condition_variable woken;
+    bool stopped = false;
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFEffect(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, pollVibeState(1, _, _)).WillByDefault(Return(true));
+    // the first effect's stop is missed; its wait only ends once it is
+    // cancelled
+    ON_CALL(*api, pollVibeState(0, -1, _))
+            .WillByDefault(Invoke([&](uint32_t, int32_t, const std::function<bool()> &cancel) {
+                std::unique_lock lock{mutex};
+                woken.wait(lock, [&] { return stopped || (cancel && cancel()); });
+                errno = stopped ? 0 : ECANCELED;
+                return stopped;
+            }));
+    ON_CALL(*api, wakePolls()).WillByDefault(Invoke([&] {
+        std::scoped_lock lock{mutex};
+        woken.notify_all();
+    }));
+    ON_CALL(*cal, isPreemptionEnabled()).WillByDefault(Return(true));
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api), std::move(cal), nullptr,
+                                                       nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+
+    EXPECT_TRUE(vibrator->on(1000, first).isOk());
+    EXPECT_TRUE(vibrator->on(1000, second).isOk());
+
+    // the retired completion gives way to the one of the second effect
+    EXPECT_CALL(*second, onComplete()).WillOnce([&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    });
+    {
+        std::scoped_lock lock{mutex};
+        stopped = true;
+        woken.notify_all();
+    }
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+}
+
+TEST_F(VibratorTest, compose_preemptsWithoutErasingEffectStillPlaying) {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto cal = std::make_unique<NiceMock<MockCal>>();
+    auto first = ndk::SharedRefBase::make<NiceMock<MockVibratorCallback>>();
+    std::vector<CompositeEffect> click{{0, CompositePrimitive::CLICK, 1.0f}};
+    std::vector<CompositeEffect> thud{{0, CompositePrimitive::THUD, 1.0f}};
+    std::mutex mutex;
+    std::condition_variable woken;
+
+    // the chip is full once the click is resident
+    EXPECT_CALL(*api, getOwtFreeSpace(_))
+            .WillOnce(DoAll(SetArgPointee<0>(11504), Return(true)))
+            .WillRepeatedly(DoAll(SetArgPointee<0>(0), Return(true)));
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+    ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*api, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(DoAll(SetArgPointee<4>(WAVEFORM_MAX_PHYSICAL_INDEX), Return(true)));
+    ON_CALL(*api, pollVibeState(1, _, _)).WillByDefault(Return(true));
+    // the click never stops, its completion only ends once it is retired
+    ON_CALL(*api, pollVibeState(0, -1, _))
+            .WillByDefault(Invoke([&](uint32_t, int32_t, const std::function<bool()> &cancel) {
+                std::unique_lock lock{mutex};
+                woken.wait(lock, [&] { return cancel && cancel(); });
+                errno = ECANCELED;
+                return false;
+            }));
+    ON_CALL(*api, pollVibeState(0, STOP_TIMEOUT_MS, _))
+            .WillByDefault(Invoke([](uint32_t, int32_t, const std::function<bool()> &) {
+                errno = ETIMEDOUT;
+                return false;
+            }));
+    ON_CALL(*api, wakePolls()).WillByDefault(Invoke([&] {
+        std::scoped_lock lock{mutex};
+        woken.notify_all();
+    }));
+    EXPECT_CALL(*api, uploadOwtEffect(_, _, _, _, _, _)).Times(1);
+    EXPECT_CALL(*api, eraseOwtEffect(_, _, _)).Times(0);
+    EXPECT_CALL(*api, flushOwtEffects(_, _)).Times(0);
+    ON_CALL(*cal, isPreemptionEnabled()).WillByDefault(Return(true));
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api), std::move(cal), nullptr,
+                                                       nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+
+    EXPECT_EQ(EX_NONE, vibrator->compose(click, first).getExceptionCode());
+    // preempting gives up on the thud rather than erase the click mid-playback
+    EXPECT_EQ(EX_ILLEGAL_STATE, vibrator->compose(thud, nullptr).getExceptionCode());
+}
+
+TEST_F(VibratorTest, off_cancelsEffectBeingUploaded) {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::atomic<bool> armed{false};
+    std::promise<void> enter;
+    std::future<void> entered{enter.get_future()};
+    std::promise<void> release;
+    std::shared_future<void> released{release.get_future()};
+
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+    // editing the effect's duration blocks until the test lets it through
+    ON_CALL(*api, setFFEffect(_, _, _))
+            .WillByDefault(Invoke([&armed, &enter, released](int, ff_effect *, uint16_t) {
+                if (armed.exchange(false)) {
+                    enter.set_value();
+                    released.wait();
+                }
+                return true;
+            }));
+    EXPECT_CALL(*api, setFFPlay(_, _, true)).Times(0);
+    EXPECT_CALL(*callback, onComplete()).WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api),
+                                                       std::make_unique<NiceMock<MockCal>>(),
+                                                       nullptr, nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+    armed = true;
+
+    std::thread starting([&vibrator, &callback] {
+        EXPECT_TRUE(vibrator->on(1000, callback).isOk());
+    });
+    ASSERT_EQ(entered.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    // off() cancels the upload in flight; only resetting the gain waits for it
+    auto stopping = std::async(std::launch::async, [&vibrator] { return vibrator->off().isOk(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    release.set_value();
+    starting.join();
+    EXPECT_TRUE(stopping.get());
+}
+
+TEST_F(VibratorTest, off_doesNotResetGainOfEffectStarting) {
+    auto api = std::make_unique<NiceMock<MockApi>>();
+    auto cal = std::make_unique<NiceMock<MockCal>>();
+    std::mutex mutex;
+    uint16_t gain = 0;
+    std::vector<uint16_t> playedGains;
+
+    ON_CALL(*api, setFFGain(_, _)).WillByDefault(Invoke([&](int, uint16_t value) {
+        {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            gain = value;
+        }
+        // widen the window between an effect's gain and its trigger
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return true;
+    }));
+    ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Invoke([&](int, int8_t, bool value) {
+        const std::scoped_lock<std::mutex> lock(mutex);
+        if (value) {
+            playedGains.push_back(gain);
+        }
+        return true;
+    }));
+    ON_CALL(*api, pollVibeState(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(*cal, getClickVolLevels(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(std::array<uint32_t, 2>{1, 50}), Return(true)));
+    ON_CALL(*cal, isPreemptionEnabled()).WillByDefault(Return(true));
+
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(std::move(api), std::move(cal), nullptr,
+                                                       nullptr,
+                                                       std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+    int32_t lengthMs;
+
+    EXPECT_TRUE(
+            vibrator->perform(Effect::CLICK, EffectStrength::STRONG, nullptr, &lengthMs).isOk());
+    ASSERT_EQ(playedGains.size(), 1);
+    const uint16_t clickGain = playedGains.front();
+    EXPECT_TRUE(vibrator->off().isOk());
+
+    std::atomic<bool> done{false};
+    std::thread stopping([&] {
+        while (!done) {
+            vibrator->off();
+        }
+    });
+    for (int i = 0; i < 100; i++) {
+        vibrator->perform(Effect::CLICK, EffectStrength::STRONG, nullptr, &lengthMs);
+    }
+    done = true;
+    stopping.join();
+
+    // every effect triggered plays at its own gain
+    const std::scoped_lock<std::mutex> lock(mutex);
+    for (uint16_t played : playedGains) {
+        EXPECT_EQ(played, clickGain);
+    }
+}
+
+TEST_F(VibratorTest, scheduleEffects_completesCallbackWhenCancelled) {
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(
+            std::make_unique<NiceMock<MockApi>>(), std::make_unique<NiceMock<MockCal>>(), nullptr,
+            nullptr, std::make_unique<NiceMock<MockGPIO>>());
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    const int64_t startNs = Histogram::now() + 3600 * 1000000000LL;  // an hour out
+    vibrator->init();
+
+    // effects must be in start order
+    EXPECT_EQ(vibrator
+                      ->scheduleEffects({{startNs, Effect::CLICK, EffectStrength::LIGHT},
+                                         {startNs - 1, Effect::TICK, EffectStrength::LIGHT}},
+                                        callback)
+                      .getExceptionCode(),
+              EX_ILLEGAL_ARGUMENT);
+    EXPECT_TRUE(vibrator
+                        ->scheduleEffects({{startNs, Effect::CLICK, EffectStrength::LIGHT},
+                                           {startNs + 1, Effect::TICK, EffectStrength::LIGHT}},
+                                          callback)
+                        .isOk());
+    Mock::VerifyAndClearExpectations(callback.get());
+
+    // dropping the effects completes the callback of the last one
+    EXPECT_CALL(*callback, onComplete()).WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+    EXPECT_TRUE(vibrator->cancelScheduledEffects().isOk());
+}
+
+TEST_F(VibratorTest, scheduleEffects_pinsUploadUntilCancelled) {
+    std::vector<CompositeEffect> click{{0, CompositePrimitive::CLICK, 1.0f}};
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+    const int64_t startNs = Histogram::now() + 3600 * 1000000000LL;  // an hour out
+    // the chip holds one waveform
+    std::set<uint32_t> ids;
+
+    ON_CALL(*mMockApi, getOwtFreeSpace(_)).WillByDefault(Invoke([&](uint32_t *value) {
+        *value = ids.empty() ? 11504 : 0;
+        return true;
+    }));
+    ON_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([&](int, const uint8_t *, uint32_t, ff_effect *,
+                                      uint32_t *outEffectIndex, int *) {
+                ids.insert(WAVEFORM_MAX_PHYSICAL_INDEX);
+                *outEffectIndex = WAVEFORM_MAX_PHYSICAL_INDEX;
+                return true;
+            }));
+    ON_CALL(*mMockApi, eraseOwtEffect(_, _, _))
+            .WillByDefault(Invoke([&](int, int8_t effectIndex, std::vector<ff_effect> *) {
+                ids.erase(effectIndex);
+                return true;
+            }));
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).Times(2);
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, WAVEFORM_MAX_PHYSICAL_INDEX, _)).Times(1);
+    EXPECT_CALL(*mMockApi, flushOwtEffects(_, _)).Times(0);
+
+    // the double click is uploaded ahead of time, and held until it fires
+    EXPECT_TRUE(mVibrator
+                        ->scheduleEffects({{startNs, Effect::DOUBLE_CLICK, EffectStrength::LIGHT}},
+                                          nullptr)
+                        .isOk());
+    EXPECT_EQ(EX_ILLEGAL_STATE, mVibrator->compose(click, nullptr).getExceptionCode());
+
+    // dropping it lets it go
+    EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    });
+    EXPECT_TRUE(mVibrator->cancelScheduledEffects().isOk());
+    EXPECT_EQ(EX_NONE, mVibrator->compose(click, callback).getExceptionCode());
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+}
+
+TEST_F(VibratorTest, dump_reportsStartup) {
+    TemporaryFile dump;
+    std::string output;
+
+    EXPECT_CALL(*mMockApi, debug(dump.fd));
+    EXPECT_CALL(*mMockCal, debug(dump.fd));
+    EXPECT_EQ(mVibrator->dump(dump.fd, nullptr, 0), STATUS_OK);
+
+    std::ifstream file{dump.path};
+    output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    EXPECT_NE(std::string::npos, output.find("  Startup (ms):\n    registration: "));
+    EXPECT_NE(std::string::npos, output.find("    total: "));
+}
+
+TEST_F(VibratorTest, init_bringsUpBothActuators) {
+    auto apiDef = std::make_unique<NiceMock<MockApi>>();
+    auto calDef = std::make_unique<NiceMock<MockCal>>();
+    auto apiDual = std::make_unique<NiceMock<MockApi>>();
+    auto calDual = std::make_unique<NiceMock<MockCal>>();
+    std::string f0Val = std::to_string(std::rand());
+    std::string f0ValDual = std::to_string(std::rand());
+
+    EXPECT_CALL(*calDef, getF0(_)).WillOnce(DoAll(SetArgReferee<0>(f0Val), Return(true)));
+    EXPECT_CALL(*apiDef, setF0(f0Val)).WillOnce(Return(true));
+    EXPECT_CALL(*apiDef, setMinOnOffInterval(MIN_ON_OFF_INTERVAL_US)).WillOnce(Return(true));
+    EXPECT_CALL(*calDual, getF0(_)).WillOnce(DoAll(SetArgReferee<0>(f0ValDual), Return(true)));
+    EXPECT_CALL(*apiDual, setF0(f0ValDual)).WillOnce(Return(true));
+    EXPECT_CALL(*apiDual, setMinOnOffInterval(MIN_ON_OFF_INTERVAL_US)).WillOnce(Return(true));
+
+    setenv("INPUT_EVENT_NAME_DUAL", "CS40L26TestSuite", true);
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(
+            std::move(apiDef), std::move(calDef), std::move(apiDual), std::move(calDual),
+            std::make_unique<NiceMock<MockGPIO>>());
+    vibrator->init();
+    unsetenv("INPUT_EVENT_NAME_DUAL");
+}
+
 TEST_F(VibratorTest, supportsAmplitudeControl_supported) {
     int32_t capabilities;
     EXPECT_CALL(*mMockApi, hasOwtFreeSpace()).WillOnce(Return(true));
@@ -504,7 +881,7 @@ TEST_P(EffectsTest, perform) {
     bool composeEffect;
 
     ExpectationSet eSetup;
-    Expectation eActivate, ePollHaptics, ePollStop, eEraseDone;
+    Expectation eActivate, ePollHaptics, ePollStop;
 
     if (scale != EFFECT_SCALE.end()) {
         EffectIndex index = EFFECT_INDEX.at(effect);
@@ -533,20 +910,17 @@ TEST_P(EffectsTest, perform) {
     }
 
     if (duration) {
-        ePollHaptics = EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT))
+        ePollHaptics = EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
                                .After(eActivate)
                                .WillOnce(DoDefault());
-        ePollStop = EXPECT_CALL(*mMockApi, pollVibeState(0, -1))
+        ePollStop = EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _))
                             .After(ePollHaptics)
                             .WillOnce(DoDefault());
         if (composeEffect) {
-            eEraseDone = EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _))
-                                 .After(ePollStop)
-                                 .WillOnce(DoDefault());
-            EXPECT_CALL(*callback, onComplete()).After(eEraseDone).WillOnce(complete);
-        } else {
-            EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
+            // the effect stays resident for replay
+            EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _)).Times(0);
         }
+        EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
     }
 
     int32_t lengthMs;
@@ -606,12 +980,191 @@ INSTANTIATE_TEST_CASE_P(VibratorTests, PrimitiveTest,
                         ValuesIn(kPrimitiveParams.begin(), kPrimitiveParams.end()),
                         PrimitiveTest::PrintParam);
 
+TEST_F(VibratorTest, compose_foldsRepeats) {
+    auto callback = ndk::SharedRefBase::make<NiceMock<MockVibratorCallback>>();
+    // both longer than an OWT waveform holds unrolled
+    std::vector<CompositeEffect> train(COMPOSE_SIZE_MAX * 4, {20, CompositePrimitive::CLICK, 0.5f});
+    std::vector<CompositeEffect> pattern;
+    for (int i = 0; i < COMPOSE_SIZE_MAX * 2; i++) {
+        pattern.push_back({0, CompositePrimitive::CLICK, 1.0f});
+        pattern.push_back({0, CompositePrimitive::THUD, 1.0f});
+    }
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_COMPOSE, true)).Times(2);
+    // the leading delay, runs of at most 256 clicks and the last click without a delay
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, 4 + 8 * 6, _, _, _)).Times(1);
+    // the shortest period repeating no more than 256 times
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, 4 + 8 * 4, _, _, _)).Times(1);
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(train, callback).getExceptionCode());
+    EXPECT_EQ(EX_NONE, mVibrator->compose(pattern, callback).getExceptionCode());
+}
+
 struct ComposeParam {
     std::string name;
     std::vector<CompositeEffect> composite;
     EffectQueue queue;
 };
 
+TEST_F(VibratorTest, compose_remapsGpioTriggerOfResidentEffects) {
+    auto apiDef = std::make_unique<NiceMock<MockApi>>();
+    auto apiDual = std::make_unique<NiceMock<MockApi>>();
+    auto gpio = std::make_unique<NiceMock<MockGPIO>>();
+    std::vector<CompositeEffect> first{{0, CompositePrimitive::CLICK, 1.0f}};
+    std::vector<CompositeEffect> second{{0, CompositePrimitive::THUD, 0.5f}};
+    std::vector<uint16_t> buttons;
+    uint32_t nextId = WAVEFORM_MAX_PHYSICAL_INDEX;
+
+    for (auto *api : {apiDef.get(), apiDual.get()}) {
+        ON_CALL(*api, setFFGain(_, _)).WillByDefault(Return(true));
+        ON_CALL(*api, setFFPlay(_, _, _)).WillByDefault(Return(true));
+        ON_CALL(*api, pollVibeState(_, _, _)).WillByDefault(Return(true));
+        ON_CALL(*api, eraseOwtEffect(_, _, _)).WillByDefault(Return(true));
+        ON_CALL(*api, getOwtFreeSpace(_))
+                .WillByDefault(DoAll(SetArgPointee<0>(11504), Return(true)));
+    }
+    // both actuators hand out the same ids, the base one first
+    ON_CALL(*apiDef, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([&](int, const uint8_t *, uint32_t, ff_effect *effect,
+                                      uint32_t *outEffectIndex, int *) {
+                buttons.push_back(effect->trigger.button);
+                *outEffectIndex = nextId;
+                return true;
+            }));
+    ON_CALL(*apiDual, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([&](int, const uint8_t *, uint32_t, ff_effect *effect,
+                                      uint32_t *outEffectIndex, int *) {
+                buttons.push_back(effect->trigger.button);
+                *outEffectIndex = nextId++;
+                return true;
+            }));
+    ON_CALL(*gpio, getGPIO()).WillByDefault(Return(true));
+    ON_CALL(*gpio, initGPIO()).WillByDefault(Return(true));
+    ON_CALL(*gpio, setGPIOOutput(_)).WillByDefault(Return(true));
+
+    // the first effect is uploaded again once the second took the trigger,
+    // but the second replays as long as it holds it
+    EXPECT_CALL(*apiDef, uploadOwtEffect(_, _, _, _, _, _)).Times(3);
+    EXPECT_CALL(*apiDual, uploadOwtEffect(_, _, _, _, _, _)).Times(3);
+    EXPECT_CALL(*apiDef, eraseOwtEffect(_, WAVEFORM_MAX_PHYSICAL_INDEX, _)).Times(1);
+    EXPECT_CALL(*apiDual, eraseOwtEffect(_, WAVEFORM_MAX_PHYSICAL_INDEX, _)).Times(1);
+    EXPECT_CALL(*gpio, setGPIOOutput(false)).Times(AnyNumber());
+    EXPECT_CALL(*gpio, setGPIOOutput(true)).Times(4);
+
+    setenv("INPUT_EVENT_NAME_DUAL", "CS40L26TestSuite", true);
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(
+            std::move(apiDef), std::make_unique<NiceMock<MockCal>>(), std::move(apiDual),
+            std::make_unique<NiceMock<MockCal>>(), std::move(gpio));
+    vibrator->init();
+    unsetenv("INPUT_EVENT_NAME_DUAL");
+
+    for (auto *composite : {&first, &second, &second, &first}) {
+        auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+        std::promise<void> promise;
+        std::future<void> future{promise.get_future()};
+
+        EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+            promise.set_value();
+            return ndk::ScopedAStatus::ok();
+        });
+        EXPECT_EQ(EX_NONE, vibrator->compose(*composite, callback).getExceptionCode());
+        EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    }
+
+    EXPECT_EQ(buttons, std::vector<uint16_t>(6, GPIO_TRIGGER_CONFIG | WAVEFORM_COMPOSE));
+}
+
+TEST_F(VibratorTest, compose_evictsOneResidentEffect) {
+    std::vector<CompositeEffect> composites[] = {
+            {{0, CompositePrimitive::CLICK, 1.0f}},
+            {{0, CompositePrimitive::THUD, 1.0f}},
+            {{0, CompositePrimitive::SPIN, 1.0f}},
+            {{0, CompositePrimitive::QUICK_RISE, 1.0f}},
+    };
+    // ff-core hands out the lowest free id; the chip holds three waveforms
+    std::set<uint32_t> ids;
+    static constexpr uint32_t THIRD_ID = WAVEFORM_MAX_INDEX;
+
+    ON_CALL(*mMockApi, getOwtFreeSpace(_)).WillByDefault(Invoke([&](uint32_t *value) {
+        *value = ids.size() < 3 ? 11504 : 0;
+        return true;
+    }));
+    ON_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([&](int, const uint8_t *, uint32_t, ff_effect *,
+                                      uint32_t *outEffectIndex, int *) {
+                uint32_t id = WAVEFORM_MAX_PHYSICAL_INDEX;
+                while (ids.count(id)) {
+                    id++;
+                }
+                ids.insert(id);
+                *outEffectIndex = id;
+                return true;
+            }));
+    ON_CALL(*mMockApi, eraseOwtEffect(_, _, _))
+            .WillByDefault(Invoke([&](int, int8_t effectIndex, std::vector<ff_effect> *) {
+                ids.erase(effectIndex);
+                return true;
+            }));
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, _, false)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).Times(4);
+    // only the least recently used waveform goes, the others keep replaying
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, THIRD_ID, _)).Times(1);
+    EXPECT_CALL(*mMockApi, flushOwtEffects(_, _)).Times(0);
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_MAX_PHYSICAL_INDEX, true)).Times(3);
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_MAX_PHYSICAL_INDEX + 1, true)).Times(3);
+    EXPECT_CALL(*mMockApi, setFFPlay(_, THIRD_ID, true)).Times(2);
+
+    for (int i : {0, 1, 2, 0, 1, 3, 0, 1}) {
+        auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+        std::promise<void> promise;
+        std::future<void> future{promise.get_future()};
+
+        EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+            promise.set_value();
+            return ndk::ScopedAStatus::ok();
+        });
+        EXPECT_EQ(EX_NONE, mVibrator->compose(composites[i], callback).getExceptionCode());
+        EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    }
+
+    EXPECT_EQ(ids, (std::set<uint32_t>{WAVEFORM_MAX_PHYSICAL_INDEX,
+                                       WAVEFORM_MAX_PHYSICAL_INDEX + 1, THIRD_ID}));
+}
+
+TEST_F(VibratorTest, compose_keepsResidentEffectsWithoutFreeSpace) {
+    std::vector<CompositeEffect> click{{0, CompositePrimitive::CLICK, 1.0f}};
+    std::vector<CompositeEffect> thud{{0, CompositePrimitive::THUD, 1.0f}};
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).Times(1);
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _)).Times(0);
+    EXPECT_CALL(*mMockApi, flushOwtEffects(_, _)).Times(0);
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_))
+            .WillOnce(DoAll(SetArgPointee<0>(11504), Return(true)))
+            .WillRepeatedly(DoAll(SetArgPointee<0>(0), Return(false)));
+    EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    });
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(click, callback).getExceptionCode());
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    // an unreadable free space must not cost the resident click its slot
+    EXPECT_EQ(EX_ILLEGAL_STATE, mVibrator->compose(thud, nullptr).getExceptionCode());
+}
+
 class ComposeTest : public VibratorTest, public WithParamInterface<ComposeParam> {
   public:
     static auto PrintParam(const TestParamInfo<ParamType> &info) { return info.param.name; }
@@ -622,7 +1175,7 @@ TEST_P(ComposeTest, compose) {
     auto composite = param.composite;
     auto queue = std::get<0>(param.queue);
     ExpectationSet eSetup;
-    Expectation eActivate, ePollHaptics, ePollStop, eEraseDone;
+    Expectation eActivate, ePollHaptics, ePollStop;
     auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
     std::promise<void> promise;
     std::future<void> future{promise.get_future()};
@@ -642,20 +1195,172 @@ TEST_P(ComposeTest, compose) {
                         .After(eSetup)
                         .WillOnce(DoDefault());
 
-    ePollHaptics = EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT))
+    ePollHaptics = EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
                            .After(eActivate)
                            .WillOnce(DoDefault());
-    ePollStop =
-            EXPECT_CALL(*mMockApi, pollVibeState(0, -1)).After(ePollHaptics).WillOnce(DoDefault());
-    eEraseDone =
-            EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _)).After(ePollStop).WillOnce(DoDefault());
-    EXPECT_CALL(*callback, onComplete()).After(eEraseDone).WillOnce(complete);
+    ePollStop = EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _))
+                        .After(ePollHaptics)
+                        .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _)).Times(0);
+    EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
 
     EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
 
     EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
 }
 
+TEST_P(ComposeTest, compose_replaysResidentEffect) {
+    auto composite = GetParam().composite;
+    auto callback = ndk::SharedRefBase::make<NiceMock<MockVibratorCallback>>();
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).Times(1);
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_COMPOSE, true)).Times(2);
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _, _)).Times(0);
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+}
+
+TEST_P(ComposeTest, compose_streamsLongComposition) {
+    std::vector<CompositeEffect> composite;
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+    auto complete = [&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    };
+    Sequence s;
+
+    // more sections than an OWT waveform holds, none repeating
+    while (composite.size() <= COMPOSE_SIZE_MAX + 1) {
+        for (auto e : GetParam().composite) {
+            e.delayMs = composite.size() + 1;
+            composite.push_back(e);
+        }
+    }
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    // the second segment is uploaded while the first one plays
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_COMPOSE, true))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_COMPOSE, true))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*callback, onComplete()).InSequence(s).WillOnce(complete);
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+}
+
+TEST_P(ComposeTest, compose_streamEvictsOnlyOnceStopped) {
+    std::vector<CompositeEffect> composite;
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+    auto complete = [&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    };
+    // the chip holds one segment at a time
+    std::set<uint32_t> ids;
+    Sequence s;
+
+    while (composite.size() <= COMPOSE_SIZE_MAX + 1) {
+        for (auto e : GetParam().composite) {
+            e.delayMs = composite.size() + 1;
+            composite.push_back(e);
+        }
+    }
+
+    ON_CALL(*mMockApi, getOwtFreeSpace(_)).WillByDefault(Invoke([&](uint32_t *value) {
+        *value = ids.empty() ? 11504 : 0;
+        return true;
+    }));
+    ON_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _))
+            .WillByDefault(Invoke([&](int, const uint8_t *, uint32_t, ff_effect *,
+                                      uint32_t *outEffectIndex, int *) {
+                *outEffectIndex = WAVEFORM_MAX_PHYSICAL_INDEX;
+                ids.insert(*outEffectIndex);
+                return true;
+            }));
+    ON_CALL(*mMockApi, eraseOwtEffect(_, _, _))
+            .WillByDefault(Invoke([&](int, int8_t effectIndex, std::vector<ff_effect> *) {
+                ids.erase(effectIndex);
+                return true;
+            }));
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_MAX_PHYSICAL_INDEX, true))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    // the first segment is only erased once it stopped
+    EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(0, STOP_TIMEOUT_MS, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, WAVEFORM_MAX_PHYSICAL_INDEX, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, WAVEFORM_MAX_PHYSICAL_INDEX, true))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(1, POLLING_TIMEOUT, _))
+            .InSequence(s)
+            .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, pollVibeState(0, -1, _)).InSequence(s).WillOnce(DoDefault());
+    EXPECT_CALL(*callback, onComplete()).InSequence(s).WillOnce(complete);
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+}
+
+TEST_P(ComposeTest, compose_flushesAfterDriverReset) {
+    auto composite = GetParam().composite;
+    auto callback = ndk::SharedRefBase::make<NiceMock<MockVibratorCallback>>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+
+    EXPECT_CALL(*mMockApi, setFFGain(_, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*mMockApi, setFFPlay(_, _, _)).Times(AnyNumber());
+    // the driver lost the uploaded effect
+    ON_CALL(*mMockApi, getEffectCount(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(WAVEFORM_MAX_PHYSICAL_INDEX), Return(true)));
+    EXPECT_CALL(*mMockApi, flushOwtEffects(_, _))
+            .WillOnce(DoAll(Invoke([&promise] { promise.set_value(); }), Return(true)))
+            .WillRepeatedly(Return(true));
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _, _)).Times(2);
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+}
+
 const std::vector<ComposeParam> kComposeParams = {
         {"click",
          {{0, CompositePrimitive::CLICK, 1.0f}},